@@ -13,6 +13,7 @@
 #include <exception>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
 #ifndef _MSC_VER
 #include <unistd.h>
 #include <arpa/inet.h>
@@ -28,6 +29,7 @@
 #endif
 #ifndef ARDUCOM_DISABLE_TCPIP
 #include "ArducomMasterTCPIP.h"
+#include "ArducomMasterUDP.h"
 #endif
 
 #ifdef _MSC_VER
@@ -430,6 +432,7 @@ void ArducomBaseParameters::evaluateArgument(std::vector<std::string>& args, siz
 														else {
 															try {
 																retries = std::stoi(args.at(*i));
+																retriesSetManually = true;
 															}
 															catch (std::exception&) {
 																throw std::invalid_argument("Expected number after argument -x");
@@ -456,7 +459,15 @@ void ArducomBaseParameters::evaluateArgument(std::vector<std::string>& args, siz
 #endif
 														}
 														else
-															throw std::invalid_argument("Unknown argument: " + args.at(*i));
+															if (args.at(*i) == "--tags") {
+																useTags = true;
+															}
+															else
+																if (args.at(*i) == "--clock-stretching") {
+																	clockStretching = true;
+																}
+																else
+																	throw std::invalid_argument("Unknown argument: " + args.at(*i));
 }
 
 ArducomMasterTransport* ArducomBaseParameters::validate() {
@@ -495,6 +506,9 @@ ArducomMasterTransport* ArducomBaseParameters::validate() {
 			}
 	}
 
+	if (clockStretching && (transportType != "i2c"))
+		throw std::invalid_argument("Clock stretching is only supported for I2C (argument --clock-stretching)");
+
 	ArducomMasterTransport* transport;
 
 	if (transportType == "i2c") {
@@ -535,14 +549,34 @@ ArducomMasterTransport* ArducomBaseParameters::validate() {
 #endif // ARDUCOM_DISABLE_TCPIP
 			}
 			else
-				if (transportType != "")
-					throw std::invalid_argument("Transport type unsupported (argument -t), use 'i2c', 'serial', or 'tcpip'");
-				else {
-					if (device != "")
-						throw std::invalid_argument("Transport type could not be determined, use 'i2c', 'serial', or 'tcpip' (argument -t)");
-					else
-						throw std::invalid_argument("Expected a device name (argument -d)");
+				if (transportType == "udp") {
+#ifdef ARDUCOM_DISABLE_TCPIP
+					throw std::invalid_argument("Sorry, UDP is not supported in this build");
+#else
+					if (device == "")
+						throw std::invalid_argument("Expected UDP host name or IP (argument -d)");
+
+					if ((deviceAddress < 0) || (deviceAddress > 65535))
+						throw std::invalid_argument("UDP port number must be within 0 (default) and 65535");
+
+					if (deviceAddress == 0)
+						deviceAddress = ARDUCOM_UDP_DEFAULT_PORT;
+
+					// replies are matched to commands by their tags
+					useTags = true;
+
+					transport = new ArducomMasterTransportUDP();
+#endif // ARDUCOM_DISABLE_TCPIP
 				}
+				else
+					if (transportType != "")
+						throw std::invalid_argument("Transport type unsupported (argument -t), use 'i2c', 'serial', 'tcpip', or 'udp'");
+					else {
+						if (device != "")
+							throw std::invalid_argument("Transport type could not be determined, use 'i2c', 'serial', 'tcpip', or 'udp' (argument -t)");
+						else
+							throw std::invalid_argument("Expected a device name (argument -d)");
+					}
 
 	try {
 		transport->init(this);
@@ -583,6 +617,11 @@ std::string ArducomBaseParameters::toString() {
 	result << " ms; ";
 	result << "Use checksum: ";
 	result << (this->useChecksum ? "yes" : "no");
+	result << "; ";
+	result << "Use tags: ";
+	result << (this->useTags ? "yes" : "no");
+	if (this->clockStretching)
+		result << "; Clock stretching: yes";
 
 	return result.str();
 }
@@ -597,16 +636,26 @@ std::string ArducomBaseParameters::getHelp() {
 	result.append("  -d <device>: Specifies the target device. Required.\n");
 	result.append("    For serial, the name of a serial device.\n");
 	result.append("    For I2C, the name of an I2C bus device.\n");
-	result.append("    For TCP/IP, a host name or IP address.\n");
+	result.append("    For TCP/IP and UDP, a host name or IP address.\n");
 	result.append("  -t <transport>: Specifies the transport type.\n");
-	result.append("    One of 'serial', 'i2c', or 'tcpip'.\n");
+	result.append("    One of 'serial', 'i2c', 'tcpip', or 'udp'.\n");
 	result.append("    Only required if it can't be guessed from the device.\n");
 	result.append("  -a <address>: Specifies the device address.\n");
 	result.append("    For I2C, the slave address number (2 - 127). Required for I2C.\n");
 	result.append("    For TCP/IP, the destination port number. Optional; default: " ARDUCOM_QUOTE(ARDUCOM_TCP_DEFAULT_PORT) ".\n");
+	result.append("    For UDP, the destination port number. Optional; default: " ARDUCOM_QUOTE(ARDUCOM_UDP_DEFAULT_PORT) ".\n");
 	result.append("    Not used for serial transport.\n");
 	result.append("  -b <baudrate>: Specifies the baud rate (serial only). Default: " ARDUCOM_QUOTE(ARDUCOM_TRANSPORT_DEFAULT_BAUDRATE) ".\n");
 	result.append("  -n: Do not use checksums. Not recommended.\n");
+	result.append("  --tags: Send tagged frames. Retries re-send the command with the same tag;\n");
+	result.append("    the slave answers repeated commands from its reply cache instead of\n");
+	result.append("    executing them again. Allows short timeouts (-u) with several retries (-x).\n");
+	result.append("    Requires a slave that supports tagged frames. Always on for UDP.\n");
+	result.append("  --clock-stretching: I2C only. The slave holds the clock line low until\n");
+	result.append("    its reply is ready, so the default delay (-l) is 0 instead of a fixed wait.\n");
+	result.append("    Requires clock stretching on the slave (I2C_SLAVE_CLOCK_STRETCHING or\n");
+	result.append("    ARDUCOM_TWI_CLOCK_STRETCHING). The master's I2C driver must allow for the\n");
+	result.append("    slave's processing time in its clock stretching timeout.\n");
 	result.append("  --initDelay <value>: Delay in milliseconds after transport init.\n");
 	result.append("    Only relevant for serial transport (e. g. for Arduino resets).\n");
 	result.append("    Default: " ARDUCOM_QUOTE(ARDUCOM_DEFAULT_INIT_DELAY_MS) ".\n");
@@ -615,6 +664,8 @@ std::string ArducomBaseParameters::getHelp() {
 	result.append("    Optional; default: " ARDUCOM_QUOTE(ARDUCOM_DEFAULT_DELAY_MS) ". Gives the device time to process.\n");
 	result.append("  -x <value>: Number of retries should sending or retrieving fail.\n");
 	result.append("    Optional; default: 0. A sensible value would be about 3.\n");
+	result.append("    For UDP, each attempt waits at most " ARDUCOM_QUOTE(ARDUCOM_UDP_ATTEMPT_TIMEOUT_MS) " ms; the default is as many\n");
+	result.append("    retries as fit into the timeout (-u).\n");
 #ifndef	__CYGWIN__
 	result.append("  -k <value>: The semaphore key used to synchronize between different\n");
 	result.append("    processes. A value of 0 disables semaphore synchronization.\n");
@@ -635,6 +686,9 @@ void ArducomBaseParameters::showHelp(void) {
 ArducomMaster::ArducomMaster(ArducomMasterTransport* transport) {
 	this->transport = transport;
 	this->lastCommand = 255;	// set to invalid command
+	this->lastTag = -1;
+	// start with a varying tag so that commands of consecutive program runs do not share tags
+	this->nextTag = (uint8_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
 	this->lastError = 0;
 	this->semkey = 0;
 	this->semid = 0;
@@ -704,13 +758,19 @@ void ArducomMaster::execute(ArducomBaseParameters& parameters, uint8_t command,
 		this->lock(parameters.debug, parameters.timeoutMs);
 
 		// send the command and payload to the slave
-		// The command is sent only once. If the caller requires the command to be re-sent in case
+		// Untagged commands are sent only once. If the caller requires the command to be re-sent in case
 		// of failure, it should handle this case by itself.
-		send(command, parameters.useChecksum, buffer, *size, parameters.retries, parameters.verbose);
+		// Tagged commands are re-sent with the same tag if the reply is missing or corrupted. The slave
+		// recognizes the tag and returns the cached reply instead of executing the command again.
+		int tag = (parameters.useTags ? this->nextTag++ : -1);
+		uint8_t sendSize = *size;
+		send(command, parameters.useChecksum, buffer, sendSize, parameters.retries, parameters.verbose, tag);
 
 		// receive response
 		uint8_t errInfo;
 		int retries = parameters.retries;
+		// the total time spent waiting for a slave that is busy or not ready is limited by the timeout
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(parameters.timeoutMs);
 
 		// retry loop
 		// The logic tries to retrieve the response several times in case there is
@@ -738,6 +798,65 @@ void ArducomMaster::execute(ArducomBaseParameters& parameters, uint8_t command,
 				break;
 			}
 
+			// reply not yet available (premature request)? wait for the estimated time and request it again
+			// the command is not sent again; this does not consume a retry; the total waiting time is limited by the timeout
+			if ((result == ARDUCOM_NOT_READY) && (std::chrono::steady_clock::now() < deadline)) {
+				// do not flood the slave if it sends no estimate
+				long waitMs = (errInfo > 0 ? errInfo * 10 : ARDUCOM_MIN_WAIT_MS);
+				if (parameters.verbose) {
+					std::cout << "Reply not ready, waiting " << waitMs << " ms" << std::endl;
+				}
+#ifdef WIN32
+				Sleep(waitMs);
+#else
+				timespec readytime;
+				readytime.tv_sec = waitMs / 1000;
+				readytime.tv_nsec = (waitMs % 1000) * 1000000L;
+				nanosleep(&readytime, nullptr);
+#endif
+				continue;
+			}
+
+			// tagged command still being processed by the slave? wait for the estimated time and ask again
+			// this does not consume a retry; the total waiting time is limited by the timeout
+			if ((result == ARDUCOM_BUSY) && (tag >= 0) && (std::chrono::steady_clock::now() < deadline)) {
+				// do not flood the slave with repeated commands if it sends no estimate
+				long waitMs = (errInfo > 0 ? errInfo * 10 : ARDUCOM_MIN_WAIT_MS);
+				if (parameters.verbose) {
+					std::cout << "Slave is busy, waiting " << waitMs << " ms" << std::endl;
+				}
+#ifdef WIN32
+				Sleep(waitMs);
+#else
+				timespec busytime;
+				busytime.tv_sec = waitMs / 1000;
+				busytime.tv_nsec = (waitMs % 1000) * 1000000L;
+				nanosleep(&busytime, nullptr);
+#endif
+				send(command, parameters.useChecksum, buffer, sendSize, parameters.retries, parameters.verbose, tag);
+				continue;
+			}
+
+			// a reply to an earlier attempt of a tagged command? discard it and read again
+			if ((result == ARDUCOM_TAG_MISMATCH) && (retries > 0)) {
+				retries--;
+				if (parameters.verbose) {
+					std::cout << "Discarding reply with outdated tag, " << retries << " retries left" << std::endl;
+				}
+				continue;
+			}
+
+			// tagged command timed out or reply corrupted? it is safe to send the command again
+			if ((tag >= 0) && (retries > 0) && (((result == ARDUCOM_NO_DATA) && (this->lastError == ARDUCOM_TIMEOUT))
+				|| (result == ARDUCOM_CHECKSUM_ERROR))) {
+				retries--;
+				if (parameters.verbose) {
+					std::cout << "Re-sending tagged command, " << retries << " retries left" << std::endl;
+				}
+				send(command, parameters.useChecksum, buffer, sendSize, parameters.retries, parameters.verbose, tag);
+				continue;
+			}
+
 			// special case: if NO_DATA has been received, give the slave more time to react
 			if ((result == ARDUCOM_NO_DATA) && (retries > 0)) {
 				retries--;
@@ -748,66 +867,85 @@ void ArducomMaster::execute(ArducomBaseParameters& parameters, uint8_t command,
 			}
 
 			// retries exceeded or another error occurred
+			this->throwError(result, errInfo, errorInfo);
+		}	// while (retries)
 
-			// convert result code to string
-			char resultStr[21];
-			sprintf(resultStr, "%d", result);
-
-			// convert info code to string
-			char errInfoStr[21];
-			sprintf(errInfoStr, "%d", errInfo);
-
-			switch (result) {
-
-			case ARDUCOM_NO_DATA:
-				throw std::runtime_error("ARDUCOM_NO_DATA (not enough data sent or command not yet processed, try to increase --initDelay, delay -l or number of retries -x)");
+	}
+	catch (const std::exception&) {
+		// cleanup after the transaction
+		done(parameters.debug);
+		char commandStr[21];
+		sprintf(commandStr, "%d", command);
+		std::throw_with_nested(std::runtime_error((std::string("Error executing command ") + commandStr).c_str()));
+	}
 
-			case ARDUCOM_COMMAND_UNKNOWN:
-				throw std::runtime_error((std::string("ARDUCOM_COMMAND_UNKNOWN (") + resultStr + "): " + errInfoStr).c_str());
+	if (close)
+		// cleanup after the transaction
+		this->close(parameters.debug);
+}
 
-			case ARDUCOM_TOO_MUCH_DATA:
-				throw std::runtime_error((std::string("ARDUCOM_TOO_MUCH_DATA (") + resultStr + "); expected bytes: " + errInfoStr).c_str());
+void ArducomMaster::receiveNext(ArducomBaseParameters& parameters, uint8_t expected, uint8_t* destBuffer, uint8_t* size,
+	uint8_t* errorInfo, bool close) {
 
-			case ARDUCOM_PARAMETER_MISMATCH:
-				// sporadic I2C dropouts cause this error (receiver problems?)
-				// seem to be unrelated to baud rate...
-				throw std::runtime_error((std::string("ARDUCOM_PARAMETER_MISMATCH (") + resultStr + "); expected bytes: " + errInfoStr).c_str());
+	// Receives a further reply frame to the last command without sending it again.
+	// The slave sends the frame as soon as the previous one has been passed on, so there is
+	// no initial delay; the delay only applies to retries if the frame is not yet available.
 
-			case ARDUCOM_BUFFER_OVERRUN:
-				throw std::runtime_error((std::string("ARDUCOM_BUFFER_OVERRUN (") + resultStr + "); buffer size is: " + errInfoStr).c_str());
+	try {
+		uint8_t errInfo;
+		int retries = parameters.retries;
+		// the total time spent waiting for a frame that is not ready is limited by the timeout
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(parameters.timeoutMs);
 
-			case ARDUCOM_CHECKSUM_ERROR:
-				throw std::runtime_error((std::string("ARDUCOM_CHECKSUM_ERROR (") + resultStr + "); calculated checksum: " + errInfoStr).c_str());
+		while (true) {
+			if (errorInfo != nullptr)
+				*errorInfo = 0;
+			*size = 0;
+			uint8_t result = receive(expected, parameters.useChecksum, destBuffer, size, &errInfo, parameters.verbose);
 
-			case ARDUCOM_LIMIT_EXCEEDED:
-				throw std::runtime_error((std::string("ARDUCOM_LIMIT_EXCEEDED (") + resultStr + "); limit is: " + errInfoStr).c_str());
+			if (result == ARDUCOM_OK)
+				break;
 
-			case ARDUCOM_FUNCTION_ERROR: {
-				// set errorInfo and throw an exception to signal the caller that a function error occurred
-				if (errorInfo != nullptr)
-					*errorInfo = errInfo;
-				throw Arducom::FunctionError((std::string("ARDUCOM_FUNCTION_ERROR ") + resultStr + ": info code: " + errInfoStr).c_str());
+			// frame not yet available (premature request on I2C)? wait for the estimated time
+			if ((result == ARDUCOM_NOT_READY) && (std::chrono::steady_clock::now() < deadline)) {
+				long waitMs = (errInfo > 0 ? errInfo * 10 : ARDUCOM_MIN_WAIT_MS);
+#ifdef WIN32
+				Sleep(waitMs);
+#else
+				timespec readytime;
+				readytime.tv_sec = waitMs / 1000;
+				readytime.tv_nsec = (waitMs % 1000) * 1000000L;
+				nanosleep(&readytime, nullptr);
+#endif
+				continue;
 			}
 
-			case ARDUCOM_NOT_IMPLEMENTED:
-				throw std::runtime_error("ARDUCOM_NOT_IMPLEMENTED: This function is not implemented on the slave device");
-
-			case ARDUCOM_INVALID_CONFIG:
-				throw std::runtime_error("ARDUCOM_INVALID_CONFIG: The configuration of the slave device is not valid for this function");
-
-			default:
-				// handle unknown errors
-				throw std::runtime_error((std::string("Device error ") + resultStr + "; info code: " + errInfoStr).c_str());
+			// a frame of an earlier command, or no frame yet? read again after the delay
+			if (((result == ARDUCOM_TAG_MISMATCH) || (result == ARDUCOM_NO_DATA)) && (retries > 0)) {
+				retries--;
+				if (parameters.verbose) {
+					std::cout << "Retrying to receive the next frame, " << retries << " retries left" << std::endl;
+				}
+#ifdef WIN32
+				Sleep(parameters.delayMs);
+#else
+				timespec sleeptime;
+				sleeptime.tv_sec = parameters.delayMs / 1000;
+				sleeptime.tv_nsec = (parameters.delayMs % 1000) * 1000000L;
+				nanosleep(&sleeptime, nullptr);
+#endif
+				continue;
 			}
-		}	// while (retries)
 
+			this->throwError(result, errInfo, errorInfo);
+		}
 	}
 	catch (const std::exception&) {
 		// cleanup after the transaction
 		done(parameters.debug);
 		char commandStr[21];
-		sprintf(commandStr, "%d", command);
-		std::throw_with_nested(std::runtime_error((std::string("Error executing command ") + commandStr).c_str()));
+		sprintf(commandStr, "%d", this->lastCommand);
+		std::throw_with_nested(std::runtime_error((std::string("Error receiving reply frame to command ") + commandStr).c_str()));
 	}
 
 	if (close)
@@ -815,6 +953,68 @@ void ArducomMaster::execute(ArducomBaseParameters& parameters, uint8_t command,
 		this->close(parameters.debug);
 }
 
+void ArducomMaster::throwError(uint8_t result, uint8_t errInfo, uint8_t* errorInfo) {
+	// convert result code to string
+	char resultStr[21];
+	sprintf(resultStr, "%d", result);
+
+	// convert info code to string
+	char errInfoStr[21];
+	sprintf(errInfoStr, "%d", errInfo);
+
+	switch (result) {
+
+	case ARDUCOM_NO_DATA:
+		throw std::runtime_error("ARDUCOM_NO_DATA (not enough data sent or command not yet processed, try to increase --initDelay, delay -l or number of retries -x)");
+
+	case ARDUCOM_COMMAND_UNKNOWN:
+		throw std::runtime_error((std::string("ARDUCOM_COMMAND_UNKNOWN (") + resultStr + "): " + errInfoStr).c_str());
+
+	case ARDUCOM_TOO_MUCH_DATA:
+		throw std::runtime_error((std::string("ARDUCOM_TOO_MUCH_DATA (") + resultStr + "); expected bytes: " + errInfoStr).c_str());
+
+	case ARDUCOM_PARAMETER_MISMATCH:
+		// sporadic I2C dropouts cause this error (receiver problems?)
+		// seem to be unrelated to baud rate...
+		throw std::runtime_error((std::string("ARDUCOM_PARAMETER_MISMATCH (") + resultStr + "); expected bytes: " + errInfoStr).c_str());
+
+	case ARDUCOM_BUFFER_OVERRUN:
+		throw std::runtime_error((std::string("ARDUCOM_BUFFER_OVERRUN (") + resultStr + "); buffer size is: " + errInfoStr).c_str());
+
+	case ARDUCOM_CHECKSUM_ERROR:
+		throw std::runtime_error((std::string("ARDUCOM_CHECKSUM_ERROR (") + resultStr + "); calculated checksum: " + errInfoStr).c_str());
+
+	case ARDUCOM_LIMIT_EXCEEDED:
+		throw std::runtime_error((std::string("ARDUCOM_LIMIT_EXCEEDED (") + resultStr + "); limit is: " + errInfoStr).c_str());
+
+	case ARDUCOM_FUNCTION_ERROR: {
+		// set errorInfo and throw an exception to signal the caller that a function error occurred
+		if (errorInfo != nullptr)
+			*errorInfo = errInfo;
+		throw Arducom::FunctionError((std::string("ARDUCOM_FUNCTION_ERROR ") + resultStr + ": info code: " + errInfoStr).c_str());
+	}
+
+	case ARDUCOM_NOT_IMPLEMENTED:
+		throw std::runtime_error("ARDUCOM_NOT_IMPLEMENTED: This function is not implemented on the slave device");
+
+	case ARDUCOM_INVALID_CONFIG:
+		throw std::runtime_error("ARDUCOM_INVALID_CONFIG: The configuration of the slave device is not valid for this function");
+
+	case ARDUCOM_TAG_MISMATCH:
+		throw std::runtime_error("ARDUCOM_TAG_MISMATCH: Did not receive a reply with the expected tag");
+
+	case ARDUCOM_BUSY:
+		throw std::runtime_error((std::string("ARDUCOM_BUSY (") + resultStr + "): The slave is still processing a command (use --tags to wait for slow commands); estimated time: " + std::to_string(errInfo * 10) + " ms").c_str());
+
+	case ARDUCOM_NOT_READY:
+		throw std::runtime_error((std::string("ARDUCOM_NOT_READY (") + resultStr + "): The slave did not finish processing the command within the timeout; estimated time: " + std::to_string(errInfo * 10) + " ms").c_str());
+
+	default:
+		// handle unknown errors
+		throw std::runtime_error((std::string("Device error ") + resultStr + "; info code: " + errInfoStr).c_str());
+	}
+}
+
 void ArducomMaster::close(bool verbose) {
 	done(verbose);
 }
@@ -897,33 +1097,39 @@ void ArducomMaster::unlock(bool verbose) {
 	this->hasLock = false;
 }
 
-void ArducomMaster::send(uint8_t command, bool checksum, uint8_t* buffer, uint8_t size, int retries, bool verbose) {
+void ArducomMaster::send(uint8_t command, bool checksum, uint8_t* buffer, uint8_t size, int retries, bool verbose, int tag) {
 	this->lastError = ARDUCOM_OK;
+	uint8_t code = size | (checksum ? ARDUCOM_CHECKSUM_FLAG : 0) | (tag >= 0 ? ARDUCOM_TAG_FLAG : 0);
+	uint8_t headerSize = ARDUCOM_HEADER_SIZE(code);
 #if defined(WIN32) && !defined(__MINGW32__)
 	uint8_t data[ARDUCOM_BUFFERSIZE];
 #else
-	uint8_t data[size + (checksum ? 3 : 2)];
+	uint8_t data[size + headerSize];
 #endif
 	data[0] = command;
-	data[1] = size | (checksum ? 0x80 : 0);
+	data[1] = code;
+	if (tag >= 0)
+		data[headerSize - 1] = (uint8_t)tag;
 	for (uint8_t i = 0; i < size; i++) {
-		data[i + (checksum ? 3 : 2)] = buffer[i];
+		data[i + headerSize] = buffer[i];
 	}
+	// the checksum covers the tag byte and the payload
 	if (checksum)
-		data[2] = calculateChecksum(data[0], data[1], &data[3], size);
+		data[2] = calculateChecksum(data[0], data[1], &data[3], size + (tag >= 0 ? 1 : 0));
 	if (verbose) {
 		std::cout << "Sending bytes: ";
-		this->printBuffer(data, size + (checksum ? 3 : 2));
+		this->printBuffer(data, size + headerSize);
 		std::cout << std::endl;
 	}
 	try {
-		this->transport->sendBytes(data, size + (checksum ? 3 : 2), retries);
+		this->transport->sendBytes(data, size + headerSize, retries);
 	}
 	catch (const std::exception&) {
 		this->lastError = ARDUCOM_TRANSPORT_ERROR;
 		std::throw_with_nested(std::runtime_error("Error sending data"));
 	}
 	this->lastCommand = command;
+	this->lastTag = tag;
 }
 
 uint8_t ArducomMaster::receive(uint8_t expected, bool useChecksum, uint8_t* destBuffer, uint8_t* size, uint8_t* errorInfo, bool verbose) {
@@ -989,6 +1195,23 @@ uint8_t ArducomMaster::receive(uint8_t expected, bool useChecksum, uint8_t* dest
 			this->printBuffer(errorInfo, 1);
 			std::cout << std::endl;
 		}
+		// error replies to tagged commands contain the tag
+		if (this->lastTag >= 0) {
+			uint8_t tag;
+			try {
+				tag = this->transport->readByte();
+			}
+			catch (const std::exception&) {
+				this->lastError = ARDUCOM_TRANSPORT_ERROR;
+				std::throw_with_nested(std::runtime_error("Error reading data"));
+			}
+			if (tag != this->lastTag) {
+				if (verbose)
+					std::cout << "Error reply tag mismatch" << std::endl;
+				this->lastError = ARDUCOM_TAG_MISMATCH;
+				return ARDUCOM_TAG_MISMATCH;
+			}
+		}
 		this->lastError = resultCode;
 		return resultCode;
 	}
@@ -1018,10 +1241,13 @@ uint8_t ArducomMaster::receive(uint8_t expected, bool useChecksum, uint8_t* dest
 		std::throw_with_nested(std::runtime_error("Error reading data"));
 	}
 
-	uint8_t length = (code & 0b00111111);
-	bool checksum = (code & 0x80) == 0x80;
+	uint8_t length = (code & ARDUCOM_LENGTH_MASK);
+	bool checksum = (code & ARDUCOM_CHECKSUM_FLAG) == ARDUCOM_CHECKSUM_FLAG;
 	if (checksum != useChecksum)
 		throw std::runtime_error("Checksum flag mismatch");
+	bool tagged = (code & ARDUCOM_TAG_FLAG) == ARDUCOM_TAG_FLAG;
+	if (tagged != (this->lastTag >= 0))
+		throw std::runtime_error("Tag flag mismatch");
 	if (verbose) {
 		std::cout << "Code byte: ";
 		this->printBuffer(&code, 1);
@@ -1046,6 +1272,17 @@ uint8_t ArducomMaster::receive(uint8_t expected, bool useChecksum, uint8_t* dest
 		std::throw_with_nested(std::runtime_error("Error reading data"));
 	}
 
+	// tag expected?
+	uint8_t tag = 0;
+	if (tagged)
+		try {
+		tag = this->transport->readByte();
+	}
+	catch (const std::exception&) {
+		this->lastError = ARDUCOM_TRANSPORT_ERROR;
+		std::throw_with_nested(std::runtime_error("Error reading data"));
+	}
+
 	*size = 0;
 	// read payload into the buffer; up to expected bytes or returned bytes, whatever is lower
 	for (uint8_t i = 0; (i < expected) && (i < length); i++) {
@@ -1064,13 +1301,27 @@ uint8_t ArducomMaster::receive(uint8_t expected, bool useChecksum, uint8_t* dest
 		std::cout << std::endl;
 	}
 	if (checksum) {
-		uint8_t ckbyte = calculateChecksum(resultCode, code, destBuffer, *size);
+		uint8_t ckbyte;
+		if (tagged) {
+			// the checksum covers the tag byte and the payload
+			uint8_t ckdata[ARDUCOM_BUFFERSIZE + 1];
+			ckdata[0] = tag;
+			memcpy(&ckdata[1], destBuffer, *size);
+			ckbyte = calculateChecksum(resultCode, code, ckdata, *size + 1);
+		} else
+			ckbyte = calculateChecksum(resultCode, code, destBuffer, *size);
 		if (ckbyte != checkbyte) {
 			*errorInfo = ckbyte;
 			this->lastError = ARDUCOM_CHECKSUM_ERROR;
 			return ARDUCOM_CHECKSUM_ERROR;
 		}
 	}
+	if (tagged && (tag != this->lastTag)) {
+		if (verbose)
+			std::cout << "Reply tag mismatch" << std::endl;
+		this->lastError = ARDUCOM_TAG_MISMATCH;
+		return ARDUCOM_TAG_MISMATCH;
+	}
 	return ARDUCOM_OK;
 }
 
@@ -32,6 +32,14 @@
 #undef ARDUCOM_DEFAULT_TIMEOUT_MS
 #define ARDUCOM_DEFAULT_TIMEOUT_MS		5000
 
+// Minimum time to wait before asking a slave again whose reply is not ready yet
+// (in case the slave sends no estimate of the remaining time).
+#define ARDUCOM_MIN_WAIT_MS				10
+
+// Maximum time to wait for the reply to one UDP datagram. A lost datagram is sent again
+// after this time; the timeout (-u) limits the total time.
+#define ARDUCOM_UDP_ATTEMPT_TIMEOUT_MS	200
+
 #define ARDUCOM_TRANSPORT_DEFAULT_BAUDRATE		ARDUCOM_DEFAULT_BAUDRATE
 
 // The init delay is only relevant for serial transports in case an Arduino is being reset
@@ -138,7 +146,10 @@ public:
 	bool delaySetManually;
 	long timeoutMs;
 	int retries;
+	bool retriesSetManually;
 	bool useChecksum;
+	bool useTags;	// send tagged frames that allow the slave to detect repeated commands
+	bool clockStretching;	// I2C only: the slave holds SCL low until the reply is ready
 	int semkey;		// semaphore key; usually determined from transport but can be specified in case of conflict
 
 	/** Standard constructor. Applies the default values. */
@@ -153,7 +164,10 @@ public:
 		delaySetManually = false;
 		timeoutMs = ARDUCOM_DEFAULT_TIMEOUT_MS;
 		retries = 0;
+		retriesSetManually = false;
 		useChecksum = true;
+		useTags = false;
+		clockStretching = false;
 		semkey = -1;
 	}
 
@@ -226,6 +240,12 @@ public:
 	virtual void execute(ArducomBaseParameters& parameters, uint8_t command, uint8_t* buffer, uint8_t* size,
                       uint8_t expected, uint8_t* destBuffer, uint8_t *errorInfo, bool close = true);
 
+	/** Receives a further reply frame to the last command for commands that reply with a run of frames.
+	* The command must have been executed with the close flag set to false. Parameters and exceptions are
+	* the same as for execute(). If the close flag is false the connection is kept open for the next frame. */
+	virtual void receiveNext(ArducomBaseParameters& parameters, uint8_t expected, uint8_t* destBuffer, uint8_t* size,
+                      uint8_t *errorInfo, bool close = true);
+
     /** If the last command has been executed without closing, the communication must be closed by
     * invoking this method when done. This method is also called when destroying the object. */
     virtual void close(bool verbose);
@@ -234,6 +254,10 @@ protected:
 
 	ArducomMasterTransport *transport;
 	uint8_t lastCommand;
+	// tag of the last command sent; -1 if the command was not tagged
+	int lastTag;
+	// tag to use for the next tagged command
+	uint8_t nextTag;
 
 	// semaphore for mutually exclusive access
 	int semkey;
@@ -246,16 +270,22 @@ protected:
 	/** If the transport specifies a semaphore key, releases the semaphore. */
 	virtual void unlock(bool verbose);
 
-	/** Sends the specified command and the content of the buffer to the slave. */
-	virtual void send(uint8_t command, bool checksum, uint8_t* buffer, uint8_t size, int retries, bool verbose);
+	/** Sends the specified command and the content of the buffer to the slave.
+	* If tag is >= 0 a tagged frame is sent. The slave returns the tag with its reply. */
+	virtual void send(uint8_t command, bool checksum, uint8_t* buffer, uint8_t size, int retries, bool verbose, int tag = -1);
 
 	/** Places up to the number of expected bytes in the destBuffer if expected is >= 0.
 	* size indicates the number of received payload bytes.
 	* The return code 0 indicates success. Other values mean that an error occurred.
 	* In these cases, errorInfo contains the info byte as transferred from
-	* the slave, if available. May throw exceptions. */
+	* the slave, if available. Returns ARDUCOM_TAG_MISMATCH if the reply belongs
+	* to an earlier tagged command. May throw exceptions. */
 	virtual uint8_t receive(uint8_t expected, bool useChecksum, uint8_t* destBuffer, uint8_t* size, uint8_t *errorInfo, bool verbose);
 
+	/** Throws the exception that corresponds to an error code returned by receive(). In case of an
+	* ARDUCOM_FUNCTION_ERROR, errorInfo (if not null) is set to the info byte. */
+	virtual void throwError(uint8_t result, uint8_t errInfo, uint8_t* errorInfo);
+
 	/** Must be called when the transaction is complete. */
 	virtual void done(bool verbose);
 
@@ -46,8 +46,9 @@ void ArducomMasterTransportI2C::init(ArducomBaseParameters* parameters) {
 #endif
 	// Special case for devices that use I2C:
 	// Set the command delay if it has not been set manually.
+	// With clock stretching the slave delays the reply itself.
 	if (!parameters->delaySetManually) {
-		parameters->delayMs = 10;
+		parameters->delayMs = (parameters->clockStretching ? 0 : 10);
 	}
 }
 
@@ -120,15 +121,14 @@ void ArducomMasterTransportI2C::request(uint8_t expectedBytes) {
 	uint8_t resultCode = this->buffer[0];
 	// error?
 	if (resultCode == ARDUCOM_ERROR_CODE) {
-		// expect two bytes more (error code plus error info)
-		if (bytesRead < 3)
+		// expect two bytes more (error code plus error info), plus the tag for tagged commands
+		if (bytesRead < (this->parameters->useTags ? 4 : 3))
 			throw Arducom::TimeoutException("Not enough data");
 	} else {
 		// read code byte
 		uint8_t code = this->buffer[1];
-		uint8_t length = (code & 0b00111111);
-		bool checksum = (code & 0x80) == 0x80;
-		if ((bytesRead < length + (checksum ? 3 : 2))) {
+		uint8_t length = (code & ARDUCOM_LENGTH_MASK);
+		if ((bytesRead < length + ARDUCOM_HEADER_SIZE(code))) {
 			throw Arducom::TimeoutException("Not enough data");
 		}
 	}
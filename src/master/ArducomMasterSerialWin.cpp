@@ -234,15 +234,17 @@ void ArducomMasterTransportSerial::request(uint8_t expectedBytes) {
 			this->readByteInternal(&this->buffer[pos++]);
 			if (expectedBytes > 2)
 				this->readByteInternal(&this->buffer[pos++]);
+			// error replies to tagged commands contain the tag
+			if ((expectedBytes > 3) && this->parameters->useTags)
+				this->readByteInternal(&this->buffer[pos++]);
 		} else {
 			// read code byte
 			uint8_t code = this->readByteInternal(&this->buffer[pos++]);
-			uint8_t length = (code & 0b00111111);
+			uint8_t length = (code & ARDUCOM_LENGTH_MASK);
 
 //			std::cout << "Expecting: " << (int)length << " bytes" << std::endl;
-			// read payload into the buffer; up to expected bytes or returned bytes, whatever is lower
-			bool checksum = (code & 0x80) == 0x80;
-			while ((pos < expectedBytes) && (pos < length + (checksum ? 3 : 2))) {
+			// read header and payload into the buffer; up to expected bytes or returned bytes, whatever is lower
+			while ((pos < expectedBytes) && (pos < length + ARDUCOM_HEADER_SIZE(code))) {
 				this->readByteInternal(&this->buffer[pos++]);
 			if (pos > SERIAL_BLOCKSIZE_LIMIT)
 				throw std::runtime_error("Error: number of received bytes exceeds serial block size limit");
@@ -0,0 +1,203 @@
+// Arducom master implementation
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+#include "ArducomMasterUDP.h"
+
+#include <exception>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <sys/types.h>
+
+#include "../slave/lib/Arducom/Arducom.h"
+
+#ifdef _MSC_VER
+#define SOCKERR_FUNC WSAGetLastError()
+#else
+#define SOCKERR_FUNC errno
+#endif
+
+ArducomMasterTransportUDP::ArducomMasterTransportUDP() {
+	this->pos = -1;
+	this->sockfd = -1;
+	this->parameters = nullptr;
+	this->port = ARDUCOM_UDP_DEFAULT_PORT;
+	this->attemptTimeoutMs = 0;
+}
+
+ArducomMasterTransportUDP::~ArducomMasterTransportUDP() {
+	if (this->sockfd >= 0) {
+#ifdef _MSC_VER
+		closesocket(this->sockfd);
+#else
+		close(this->sockfd);
+#endif
+	}
+}
+
+void ArducomMasterTransportUDP::init(ArducomBaseParameters* parameters) {
+	this->parameters = parameters;
+	this->host = parameters->device;
+	this->port = parameters->deviceAddress;
+#ifndef _MSC_VER
+	// calculate SHA1 hash of host:port
+	// (same key as TCP/IP because the slave has only one reply cache)
+	std::stringstream fullNameSS;
+	fullNameSS << this->host << ":" << this->port;
+	std::string fullName = fullNameSS.str();
+
+#ifndef ARDUCOM__NO_LOCK_MECHANISM
+	unsigned char hash[SHA_DIGEST_LENGTH];
+	SHA1((const unsigned char*)fullName.c_str(), fullName.size(), hash);
+
+	// IPC semaphore key is the first four bytes of the hash
+	this->semkey = *(int*)&hash;
+#endif	
+#else
+	// initialize socket subsystem
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		throw_system_error("Windows socket subsystem failure", nullptr, SOCKERR_FUNC);
+	}
+#endif
+	// the reply is received as soon as it arrives; no delay required
+	if (!parameters->delaySetManually) {
+		parameters->delayMs = 0;
+	}
+	// a lost datagram should not cost the full timeout; each attempt waits only briefly
+	// and the command is sent again, so that the timeout limits the total time
+	if (parameters->timeoutMs > 0) {
+		this->attemptTimeoutMs = (parameters->timeoutMs < ARDUCOM_UDP_ATTEMPT_TIMEOUT_MS ? parameters->timeoutMs : ARDUCOM_UDP_ATTEMPT_TIMEOUT_MS);
+		if (!parameters->retriesSetManually)
+			parameters->retries = (int)(parameters->timeoutMs / this->attemptTimeoutMs) - 1;
+	}
+}
+
+void ArducomMasterTransportUDP::sendBytes(uint8_t* buffer, uint8_t size, int retries) {
+	if (size > UDP_BLOCKSIZE_LIMIT)
+		throw std::runtime_error("Error: number of bytes to send exceeds UDP block size limit");
+
+	// socket not yet open?
+	// The socket stays open for subsequent commands.
+	if (this->sockfd < 0) {
+		struct sockaddr_in serv_addr;
+		struct hostent *server;
+
+		server = gethostbyname(this->host.c_str());
+		if (server == NULL)
+			throw std::runtime_error(std::string("Host not found: " + this->host
+				+ std::string(" (") + std::to_string(SOCKERR_FUNC) + std::string(")")
+			).c_str());
+
+		this->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (this->sockfd < 0)
+			throw_system_error("Failed to open UDP socket", nullptr, SOCKERR_FUNC);
+
+		if (this->attemptTimeoutMs > 0) {
+#ifdef _MSC_VER
+			DWORD timeout = this->attemptTimeoutMs;
+#else
+			struct timeval timeout;
+			timeout.tv_sec = this->attemptTimeoutMs / 1000;
+			timeout.tv_usec = (this->attemptTimeoutMs % 1000) * 1000;
+#endif
+			if (setsockopt(this->sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout)) < 0)
+				throw_system_error("Error setting UDP receive timeout", nullptr, SOCKERR_FUNC);
+		}
+
+		memset((char*)&serv_addr, 0, sizeof(serv_addr));
+		serv_addr.sin_family = AF_INET;
+		memcpy((char*)&serv_addr.sin_addr.s_addr, (char*)server->h_addr, server->h_length);
+		serv_addr.sin_port = htons(this->port);
+
+		// a connected datagram socket only receives datagrams from this peer
+		if (connect(this->sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0)
+			throw_system_error("Could not connect to host", this->host.c_str(), SOCKERR_FUNC);
+	}
+
+	int my_retries = retries;
+	repeat:
+	if (send(this->sockfd, (const char*)&buffer[0], size, 0) != size) {
+		if (my_retries <= 0) {
+			throw_system_error("Error sending data via UDP", nullptr, SOCKERR_FUNC);
+		} else {
+			my_retries--;
+			goto repeat;
+		}
+	}
+}
+
+void ArducomMasterTransportUDP::request(uint8_t expectedBytes) {
+	if (expectedBytes > UDP_BLOCKSIZE_LIMIT)
+		throw std::runtime_error("Error: number of bytes to receive exceeds UDP block size limit");
+	if (this->sockfd < 0)
+		throw std::runtime_error("Can't receive: Data must be sent first");
+	memset(&this->buffer, 0, UDP_BLOCKSIZE_LIMIT);
+
+	// the reply is one datagram; longer datagrams are truncated
+	int bytesRead = recv(this->sockfd, (char*)this->buffer, UDP_BLOCKSIZE_LIMIT, 0);
+	if (bytesRead < 0) {
+#ifdef _MSC_VER
+		if (SOCKERR_FUNC == WSAETIMEDOUT)
+#else
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+#endif
+			throw Arducom::TimeoutException("Timeout");
+		throw_system_error("Unable to read from network", nullptr, SOCKERR_FUNC);
+	}
+	if (bytesRead == 0)
+		throw Arducom::TimeoutException("Timeout");
+	this->pos = 0;
+}
+
+uint8_t ArducomMasterTransportUDP::readByte(void) {
+	if (this->pos < 0)
+		throw std::runtime_error("Can't read: Data must be requested first");
+	if (pos >= UDP_BLOCKSIZE_LIMIT)
+		throw std::runtime_error("Can't read: Too many bytes requested");
+	return this->buffer[this->pos++];
+}
+
+void ArducomMasterTransportUDP::done() {
+	if (this->sockfd < 0)
+		return;
+	// discard late replies to earlier attempts
+	uint8_t discard[UDP_BLOCKSIZE_LIMIT];
+#ifdef _MSC_VER
+	u_long available = 0;
+	while ((ioctlsocket(this->sockfd, FIONREAD, &available) == 0) && (available > 0))
+		recv(this->sockfd, (char*)discard, UDP_BLOCKSIZE_LIMIT, 0);
+#else
+	while (recv(this->sockfd, discard, UDP_BLOCKSIZE_LIMIT, MSG_DONTWAIT) >= 0) {}
+#endif
+	this->pos = -1;
+}
+
+uint8_t ArducomMasterTransportUDP::getMaximumCommandSize(void) {
+	return UDP_BLOCKSIZE_LIMIT;
+}
+
+uint8_t ArducomMasterTransportUDP::getDefaultExpectedBytes(void) {
+	return UDP_BLOCKSIZE_LIMIT;
+}
+
+int ArducomMasterTransportUDP::getSemkey(void) {
+#ifdef ARDUCOM__NO_LOCK_MECHANISM
+	return 0;
+#else
+	return this->semkey;
+#endif
+}
+
+void ArducomMasterTransportUDP::printBuffer(void) {
+	ArducomMaster::printBuffer(this->buffer, UDP_BLOCKSIZE_LIMIT);
+}
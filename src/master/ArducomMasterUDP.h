@@ -0,0 +1,78 @@
+// Arducom master implementation
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+#ifndef _MSC_VER
+#include <openssl/sha.h>		// requires libssl-devel
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#else
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#endif
+
+#include <string>
+
+#include "ArducomMaster.h"
+
+#define UDP_BLOCKSIZE_LIMIT		32
+
+/** This transport sends each command as one UDP datagram and expects the reply
+ * in one datagram. There is no connection setup. Lost datagrams are detected by
+ * a short receive timeout per attempt; the command is then sent again with the same tag,
+ * so that the slave replies from its reply cache if it has already executed the command.
+ * Tags are therefore always used with this transport. Unless the number of retries is
+ * specified, it is set so that the attempts fill the timeout.
+ */
+class ArducomMasterTransportUDP: public ArducomMasterTransport {
+public:
+
+	ArducomMasterTransportUDP();
+
+	virtual ~ArducomMasterTransportUDP();
+
+	virtual void init(ArducomBaseParameters* parameters) override;
+
+	virtual void sendBytes(uint8_t* buffer, uint8_t size, int retries = 0) override;
+
+	virtual void request(uint8_t expectedBytes) override;
+
+	virtual uint8_t readByte(void) override;
+
+	virtual void done(void) override;
+
+	virtual uint8_t getMaximumCommandSize(void) override;
+
+	virtual uint8_t getDefaultExpectedBytes(void) override;
+
+	virtual int getSemkey(void) override;
+
+	virtual void printBuffer(void) override;
+
+protected:
+	std::string host;
+	int port;
+	ArducomBaseParameters* parameters;
+	
+#ifndef ARDUCOM__NO_LOCK_MECHANISM
+	// semaphore key
+	key_t semkey;
+#endif
+
+	int sockfd;
+	// receive timeout per attempt (0 = wait indefinitely)
+	long attemptTimeoutMs;
+
+	uint8_t buffer[UDP_BLOCKSIZE_LIMIT];
+	int8_t pos;
+};
@@ -0,0 +1,499 @@
+// arducom-bench
+// Arducom master benchmark
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+// This tool measures the performance of ArducomMaster::execute and the master
+// transports against a slave. Use arducom-sim as a local stand-in slave (see
+// bench-sim.sh) or any device running the hello-world sketch.
+// For each test it reports round-trip latency percentiles, commands per second,
+// payload bytes per second, and the number of read/write system calls, memory
+// allocations and context switches per command. With --csv the results are
+// printed as comma separated values for tracking them over time.
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <exception>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifndef _MSC_VER
+#include <sys/resource.h>
+#endif
+
+#include "../slave/lib/Arducom/Arducom.h"
+
+#include "ArducomMaster.h"
+#include "ArducomMasterSerial.h"
+#ifndef ARDUCOM_NO_I2C
+#include "ArducomMasterI2C.h"
+#endif
+
+#define BENCH_DEFAULT_ITERATIONS		100
+#define BENCH_DEFAULT_WARMUP			5
+#define BENCH_DEFAULT_SIZES				"1,8,16,24"
+#define BENCH_DEFAULT_READ_COMMAND		9		// hello-world: read EEPROM block
+#define BENCH_DEFAULT_WRITE_COMMAND		10		// hello-world: write EEPROM block
+
+// maximum frame header size: command, code, checksum and tag byte
+#define BENCH_MAX_HEADER_SIZE			4
+
+/********************************************************************************/
+/* Allocation counter                                                           */
+/********************************************************************************/
+
+static std::atomic<unsigned long> allocationCount(0);
+
+void* operator new(size_t size) {
+	allocationCount++;
+	void* p = malloc(size == 0 ? 1 : size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+/********************************************************************************/
+
+/* Process counters that are sampled before and after each test */
+struct Counters {
+	long readCalls;			// -1 if not available
+	long writeCalls;		// -1 if not available
+	long contextSwitches;	// -1 if not available
+	unsigned long allocations;
+
+	void sample(void) {
+		readCalls = -1;
+		writeCalls = -1;
+		contextSwitches = -1;
+		// read and write system call counters (Linux only)
+		FILE* f = fopen("/proc/self/io", "r");
+		if (f != NULL) {
+			char line[64];
+			while (fgets(line, sizeof(line), f) != NULL) {
+				sscanf(line, "syscr: %ld", &readCalls);
+				sscanf(line, "syscw: %ld", &writeCalls);
+			}
+			fclose(f);
+		}
+#ifndef _MSC_VER
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+			contextSwitches = usage.ru_nvcsw + usage.ru_nivcsw;
+#endif
+		allocations = allocationCount;
+	}
+};
+
+/* Result of a benchmark test */
+struct BenchResult {
+	std::string test;
+	int size;
+	int iterations;
+	int errors;
+	std::string lastError;
+	std::vector<double> latencies;	// microseconds, successful commands only
+	double seconds;
+	unsigned long bytes;			// payload bytes sent and received by successful commands
+	Counters before;
+	Counters after;
+
+	double percentile(double p) {
+		if (latencies.empty())
+			return 0;
+		// nearest rank
+		size_t rank = (size_t)(p / 100.0 * latencies.size() + 0.999999);
+		if (rank < 1)
+			rank = 1;
+		return latencies.at(rank - 1);
+	}
+
+	double mean(void) {
+		if (latencies.empty())
+			return 0;
+		double sum = 0;
+		for (size_t i = 0; i < latencies.size(); i++)
+			sum += latencies.at(i);
+		return sum / latencies.size();
+	}
+
+	/* Returns the difference of a counter per command, or -1 if the counter is not available */
+	double perCommand(long before, long after) {
+		if ((before < 0) || (after < 0) || (iterations == 0))
+			return -1;
+		return (double)(after - before) / iterations;
+	}
+};
+
+/* Specialized parameters class */
+class ArducomBenchParameters : public ArducomBaseParameters {
+
+public:
+	int iterations;
+	int warmup;
+	std::vector<int> sizes;
+	std::vector<std::string> tests;
+	int readCommand;
+	int writeCommand;
+	int address;
+	bool csv;
+	bool header;
+	std::string label;
+
+	ArducomBenchParameters() : ArducomBaseParameters() {
+		iterations = BENCH_DEFAULT_ITERATIONS;
+		warmup = BENCH_DEFAULT_WARMUP;
+		parseSizes(BENCH_DEFAULT_SIZES);
+		tests.push_back("version");
+		tests.push_back("read");
+		tests.push_back("write");
+		readCommand = BENCH_DEFAULT_READ_COMMAND;
+		writeCommand = BENCH_DEFAULT_WRITE_COMMAND;
+		address = 0;
+		csv = false;
+		header = true;
+	}
+
+	void evaluateArgument(std::vector<std::string>& args, size_t* i) override {
+		if (args.at(*i) == "--iterations") {
+			iterations = nextNumber(args, i, 1, 1000000);
+		} else
+		if (args.at(*i) == "--warmup") {
+			warmup = nextNumber(args, i, 0, 1000000);
+		} else
+		if (args.at(*i) == "--sizes") {
+			(*i)++;
+			if (args.size() == *i)
+				throw std::invalid_argument("Expected comma separated list of sizes after argument --sizes");
+			parseSizes(args.at(*i));
+		} else
+		if (args.at(*i) == "--tests") {
+			(*i)++;
+			if (args.size() == *i)
+				throw std::invalid_argument("Expected comma separated list of tests after argument --tests");
+			tests.clear();
+			std::stringstream ss(args.at(*i));
+			std::string item;
+			while (std::getline(ss, item, ',')) {
+				if ((item != "version") && (item != "read") && (item != "write"))
+					throw std::invalid_argument("Unknown test (expected version, read or write): " + item);
+				tests.push_back(item);
+			}
+		} else
+		if (args.at(*i) == "--read-command") {
+			readCommand = nextNumber(args, i, 0, ARDUCOM_MAX_COMMANDCODE);
+		} else
+		if (args.at(*i) == "--write-command") {
+			writeCommand = nextNumber(args, i, 0, ARDUCOM_MAX_COMMANDCODE);
+		} else
+		if (args.at(*i) == "--address") {
+			address = nextNumber(args, i, 0, 65535);
+		} else
+		if (args.at(*i) == "--csv") {
+			csv = true;
+		} else
+		if (args.at(*i) == "--no-header") {
+			header = false;
+		} else
+		if (args.at(*i) == "--label") {
+			(*i)++;
+			if (args.size() == *i)
+				throw std::invalid_argument("Expected label after argument --label");
+			label = args.at(*i);
+		} else
+			ArducomBaseParameters::evaluateArgument(args, i);
+	};
+
+	ArducomMasterTransport* validate() {
+		ArducomMasterTransport* transport = ArducomBaseParameters::validate();
+		return transport;
+	};
+
+	void showVersion(void) override {
+		std::cout << this->getVersion();
+		exit(0);
+	};
+
+	void showHelp(void) override {
+		std::cout << this->getHelp();
+		exit(0);
+	};
+
+	/** Returns the parameter help for this object. */
+	virtual std::string getHelp(void) override {
+		std::string result;
+		result.append(this->getVersion());
+
+		result.append("\n");
+		result.append(ArducomBaseParameters::getHelp());
+
+		result.append("\n");
+		result.append("Benchmark parameters:\n");
+		result.append("  --iterations <n>: Number of measured commands per test. Default: " ARDUCOM_QUOTE(BENCH_DEFAULT_ITERATIONS) ".\n");
+		result.append("  --warmup <n>: Number of unmeasured commands before each test. Default: " ARDUCOM_QUOTE(BENCH_DEFAULT_WARMUP) ".\n");
+		result.append("  --tests <list>: Comma separated list of tests. Default: version,read,write.\n");
+		result.append("    version: command 0 without payload.\n");
+		result.append("    read: read blocks of each size (reply size).\n");
+		result.append("    write: write blocks of each size (command size). The block is read first\n");
+		result.append("      and written back unchanged.\n");
+		result.append("  --sizes <list>: Comma separated list of block sizes. Default: " BENCH_DEFAULT_SIZES ".\n");
+		result.append("  --read-command <n>: Read block command. Default: " ARDUCOM_QUOTE(BENCH_DEFAULT_READ_COMMAND) ".\n");
+		result.append("  --write-command <n>: Write block command. Default: " ARDUCOM_QUOTE(BENCH_DEFAULT_WRITE_COMMAND) ".\n");
+		result.append("    Both commands expect a two byte address (LSB first); the read command\n");
+		result.append("    also expects a length byte (as the hello-world EEPROM commands).\n");
+		result.append("  --address <n>: Block address. Default: 0.\n");
+		result.append("  --csv: Output comma separated values with a header line.\n");
+		result.append("  --no-header: Omit the header line (to append to previous output).\n");
+		result.append("  --label <text>: Label for the first CSV column (e. g. a version).\n");
+		result.append("\n");
+		result.append("Examples:\n");
+		result.append("\n");
+		result.append("./arducom-bench -d /dev/ttyUSB0 -b 115200 --initDelay 3000\n");
+		result.append("  Runs all tests against the hello-world sketch at /dev/ttyUSB0.\n");
+		result.append("\n");
+		result.append("./arducom-bench -t tcpip -d localhost --csv --label $(git rev-parse --short HEAD)\n");
+		result.append("  Runs all tests against arducom-sim -t tcpip and outputs CSV.\n");
+
+		return result;
+	}
+
+	virtual std::string getVersion(void) {
+		std::string result;
+		result.append("Arducom benchmark tool v1.0\n");
+		result.append("https://github.com/leomeyer/Arducom\n");
+		result.append("Build: " __DATE__ " " __TIME__ "\n");
+		return result;
+	}
+
+protected:
+	int nextNumber(std::vector<std::string>& args, size_t* i, int min, int max) {
+		std::string arg = args.at(*i);
+		(*i)++;
+		if (args.size() == *i)
+			throw std::invalid_argument("Expected number after argument " + arg);
+		int result;
+		try {
+			result = std::stoi(args.at(*i));
+		} catch (std::exception&) {
+			throw std::invalid_argument("Expected number after argument " + arg);
+		}
+		if ((result < min) || (result > max))
+			throw std::invalid_argument("Number out of range after argument " + arg + ": " + args.at(*i));
+		return result;
+	}
+
+	void parseSizes(const std::string& list) {
+		sizes.clear();
+		std::stringstream ss(list);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			int size;
+			try {
+				size = std::stoi(item);
+			} catch (std::exception&) {
+				throw std::invalid_argument("Expected numeric size in argument --sizes: " + item);
+			}
+			if ((size < 1) || (size > 64))
+				throw std::invalid_argument("Sizes must be within range 1..64 (argument --sizes)");
+			sizes.push_back(size);
+		}
+	}
+};
+
+/********************************************************************************/
+
+ArducomBenchParameters parameters;
+
+/* Executes a command repeatedly and measures it */
+BenchResult runTest(ArducomMaster& master, ArducomMasterTransport* transport, const std::string& test, int size, uint8_t command, std::vector<uint8_t>& payload) {
+	BenchResult result;
+	result.test = test;
+	result.size = size;
+	result.iterations = parameters.iterations;
+	result.errors = 0;
+	result.bytes = 0;
+	result.latencies.reserve(parameters.iterations);
+
+	uint8_t buffer[255];
+	uint8_t errorInfo;
+	// the transports expect the maximum frame size
+	uint8_t expected = transport->getDefaultExpectedBytes();
+
+	for (int i = 0; i < parameters.warmup; i++) {
+		uint8_t replySize = (uint8_t)payload.size();
+		try {
+			master.execute(parameters, command, payload.data(), &replySize, expected, buffer, &errorInfo);
+		} catch (std::exception&) {
+			// errors are counted in the measured part only
+		}
+	}
+
+	result.before.sample();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < parameters.iterations; i++) {
+		uint8_t replySize = (uint8_t)payload.size();
+		std::chrono::steady_clock::time_point cmdStart = std::chrono::steady_clock::now();
+		try {
+			master.execute(parameters, command, payload.data(), &replySize, expected, buffer, &errorInfo);
+			std::chrono::steady_clock::time_point cmdEnd = std::chrono::steady_clock::now();
+			result.latencies.push_back(std::chrono::duration<double, std::micro>(cmdEnd - cmdStart).count());
+			result.bytes += payload.size() + replySize;
+		} catch (std::exception& e) {
+			result.errors++;
+			result.lastError = master.getExceptionMessage(e);
+		}
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	result.after.sample();
+	result.seconds = std::chrono::duration<double>(end - start).count();
+
+	std::sort(result.latencies.begin(), result.latencies.end());
+	return result;
+}
+
+void printHeader(void) {
+	if (parameters.csv) {
+		std::cout << "label,timestamp,transport,device,test,size,iterations,errors,"
+			<< "min_us,p50_us,p90_us,p99_us,max_us,mean_us,commands_per_s,bytes_per_s,"
+			<< "read_syscalls,write_syscalls,allocations,context_switches" << std::endl;
+	} else {
+		std::cout << "Transport Test     Size  Errors     Min us     p50 us     p90 us     p99 us     Max us   Cmds/s  Bytes/s  Reads  Writes  Allocs  CSwitch" << std::endl;
+		std::cout << "                                                                                                        (per command)" << std::endl;
+	}
+}
+
+/* Prints a per command counter; -1 means that the counter is not available */
+std::string formatCounter(double value) {
+	if (value < 0)
+		return parameters.csv ? "" : "-";
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(1) << value;
+	return s.str();
+}
+
+void printResult(BenchResult& result) {
+	int successful = result.iterations - result.errors;
+	double commandsPerSecond = (result.seconds > 0 ? successful / result.seconds : 0);
+	double bytesPerSecond = (result.seconds > 0 ? result.bytes / result.seconds : 0);
+	double reads = result.perCommand(result.before.readCalls, result.after.readCalls);
+	double writes = result.perCommand(result.before.writeCalls, result.after.writeCalls);
+	double allocations = result.perCommand(result.before.allocations, result.after.allocations);
+	double contextSwitches = result.perCommand(result.before.contextSwitches, result.after.contextSwitches);
+
+	if (parameters.csv) {
+		std::cout << parameters.label << "," << time(NULL) << "," << parameters.transportType << "," << parameters.device << ","
+			<< result.test << "," << result.size << "," << result.iterations << "," << result.errors << ","
+			<< std::fixed << std::setprecision(0)
+			<< result.percentile(0) << "," << result.percentile(50) << "," << result.percentile(90) << ","
+			<< result.percentile(99) << "," << result.percentile(100) << "," << result.mean() << ","
+			<< std::setprecision(1) << commandsPerSecond << "," << bytesPerSecond << ","
+			<< formatCounter(reads) << "," << formatCounter(writes) << ","
+			<< formatCounter(allocations) << "," << formatCounter(contextSwitches) << std::endl;
+	} else {
+		std::cout << std::left << std::setw(10) << parameters.transportType << std::setw(7) << result.test << std::right << std::setw(6) << result.size
+			<< std::setw(8) << result.errors
+			<< std::fixed << std::setprecision(0)
+			<< std::setw(11) << result.percentile(0) << std::setw(11) << result.percentile(50)
+			<< std::setw(11) << result.percentile(90) << std::setw(11) << result.percentile(99)
+			<< std::setw(11) << result.percentile(100)
+			<< std::setw(9) << commandsPerSecond << std::setw(9) << bytesPerSecond
+			<< std::setw(7) << formatCounter(reads) << std::setw(8) << formatCounter(writes)
+			<< std::setw(8) << formatCounter(allocations) << std::setw(9) << formatCounter(contextSwitches) << std::endl;
+	}
+	if (result.errors > 0)
+		std::cerr << "Test " << result.test << " size " << result.size << ": " << result.errors
+			<< " error(s), last error: " << result.lastError << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+	std::vector<std::string> args;
+	ArducomBaseParameters::convertCmdLineArgs(argc, argv, args);
+
+	try {
+		parameters.setFromArguments(args);
+
+		ArducomMasterTransport* transport = parameters.validate();
+
+		// initialize protocol
+		ArducomMaster master(transport);
+
+		if (parameters.header)
+			printHeader();
+
+		for (size_t t = 0; t < parameters.tests.size(); t++) {
+			std::string test = parameters.tests.at(t);
+			std::vector<uint8_t> payload;
+
+			if (test == "version") {
+				BenchResult result = runTest(master, transport, test, 0, ARDUCOM_VERSION_COMMAND, payload);
+				printResult(result);
+				continue;
+			}
+
+			for (size_t s = 0; s < parameters.sizes.size(); s++) {
+				int size = parameters.sizes.at(s);
+				// read block: address and length
+				payload.clear();
+				payload.push_back(parameters.address & 0xFF);
+				payload.push_back(parameters.address >> 8);
+				payload.push_back(size);
+
+				if (size + BENCH_MAX_HEADER_SIZE > transport->getDefaultExpectedBytes()) {
+					std::cerr << "Skipping test " << test << " size " << size << ": reply exceeds the transport's block size" << std::endl;
+					continue;
+				}
+
+				if (test == "read") {
+					BenchResult result = runTest(master, transport, test, size, parameters.readCommand, payload);
+					printResult(result);
+				} else
+				if (test == "write") {
+					if (2 + size + BENCH_MAX_HEADER_SIZE > transport->getMaximumCommandSize()) {
+						std::cerr << "Skipping test " << test << " size " << size << ": exceeds the transport's maximum command size" << std::endl;
+						continue;
+					}
+					// read the current content so that the write does not change anything
+					uint8_t buffer[255];
+					uint8_t replySize = (uint8_t)payload.size();
+					uint8_t errorInfo;
+					try {
+						master.execute(parameters, parameters.readCommand, payload.data(), &replySize, transport->getDefaultExpectedBytes(), buffer, &errorInfo);
+					} catch (std::exception& e) {
+						std::cerr << "Skipping test " << test << " size " << size << ": unable to read the block: " << master.getExceptionMessage(e) << std::endl;
+						continue;
+					}
+					if (replySize != size) {
+						std::cerr << "Skipping test " << test << " size " << size << ": unable to read the block (unexpected reply size)" << std::endl;
+						continue;
+					}
+					payload.pop_back();
+					payload.insert(payload.end(), buffer, buffer + size);
+					BenchResult result = runTest(master, transport, test, size, parameters.writeCommand, payload);
+					printResult(result);
+				}
+			}
+		}
+	} catch (const std::exception& e) {
+		print_what(e);
+		exit(1);
+	}
+
+	return 0;
+}
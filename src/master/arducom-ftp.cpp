@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <time.h>
 #include <bitset>
+#include <chrono>
 
 #include "../slave/lib/Arducom/Arducom.h"
 #include "../slave/lib/Arducom/ArducomFTP.h"
@@ -40,8 +41,21 @@
 
 #ifdef _MSC_VER
 #include <io.h>
+#include <direct.h>
+#include <sys/utime.h>
+#define timegm _mkgmtime
+#define mkdir(path, mode) _mkdir(path)
+static int truncate(const char* path, size_t length) {
+	int fd = _open(path, _O_WRONLY | _O_BINARY);
+	if (fd < 0)
+		return -1;
+	int result = _chsize_s(fd, length);
+	_close(fd);
+	return (result == 0 ? 0 : -1);
+}
 #else
 #include <unistd.h>
+#include <utime.h>
 #endif
 
 // missing defines on MSC
@@ -103,12 +117,17 @@ class ArducomFTPParameters : public ArducomBaseParameters {
 public:
 	uint8_t commandBase;
 	bool continueFile;
+	bool verifyFile;
 	bool allowDelete;
+	// maximum number of frames per READBLOCKS request; 0 means one READFILE request per frame
+	uint8_t blockFrames;
 
 	ArducomFTPParameters() : ArducomBaseParameters() {
 		commandBase = ARDUCOM_FTP_DEFAULT_COMMANDBASE;
 		continueFile = true;
+		verifyFile = true;
 		allowDelete = false;
+		blockFrames = 32;
 		// increase the default command delay because SD card operations may be slow
 		delayMs = 25;
 		// set default number of retries
@@ -119,6 +138,9 @@ public:
 		if (args.at(*i) == "--no-continue") {
 			continueFile = false;
 		} else
+		if (args.at(*i) == "--no-verify") {
+			verifyFile = false;
+		} else
 		if (args.at(*i) == "--allow-delete") {
 			allowDelete = true;
 		} else
@@ -151,6 +173,7 @@ public:
 		result.append("\n");
 		result.append("FTP tool parameters:\n");
  		result.append("  --no-continue: Always overwrite existing files.\n");
+ 		result.append("  --no-verify: Do not compare existing files with the device before continuing.\n");
  		result.append("  --allow-delete: Allow the (experimental) deletion of files.\n");
 		result.append("\n");
 		result.append("Examples:\n");
@@ -187,8 +210,53 @@ std::vector<std::string> pathComponents;
 bool needEndl = false;		// flag: cout << endl before printing messages
 bool interactive;			// if false (piping input) errors cause immediate exit
 
+// directory listing data structure
+PACK(struct FileInfo {
+	char name[13];
+	uint8_t isDir;
+	uint8_t size1;	// size is little-endian
+	uint8_t size2;
+	uint8_t size3;
+	uint8_t size4;
+	uint8_t lastWriteDate1;
+	uint8_t lastWriteDate2;
+	uint8_t lastWriteTime1;
+	uint8_t lastWriteTime2;
+});
+
+std::vector<FileInfo> dirCache;	// listing of the current directory on the slave
+bool dirCacheValid = false;		// cleared by commands that change the directory or its content
+bool useListDir = true;			// cleared if the slave does not support listing with one request
+bool useReadBlocks = true;		// cleared if the slave does not support consecutive reads
+bool useCRC = true;				// cleared if the slave does not support CRC calculation
+
+// granularity of the search for the first difference between a local file and the device's file
+#define VERIFY_BLOCK_SIZE		512
+
 /********************************************************************************/
 
+/** Throws the exception for an FTP function error code as returned by the slave. */
+void throwFTPError(uint8_t errorInfo) {
+	// convert info code to string
+	char errorInfoStr[21];
+	sprintf(errorInfoStr, "%d", errorInfo);
+	
+	switch (errorInfo) {
+	case ARDUCOM_FTP_SDCARD_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": SD card unavailable").c_str());
+	case ARDUCOM_FTP_SDCARD_TYPE_UNKNOWN: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": SD card type unknown").c_str());
+	case ARDUCOM_FTP_FILESYSTEM_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": SD card file system error").c_str());
+	case ARDUCOM_FTP_NOT_INITIALIZED: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": FTP system not initialized").c_str());
+	case ARDUCOM_FTP_MISSING_FILENAME: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Required file name is missing").c_str());
+	case ARDUCOM_FTP_NOT_A_DIRECTORY: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Not a directory").c_str());
+	case ARDUCOM_FTP_FILE_OPEN_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Error opening file").c_str());
+	case ARDUCOM_FTP_READ_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Read error").c_str());
+	case ARDUCOM_FTP_FILE_NOT_OPEN: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": File not open").c_str());
+	case ARDUCOM_FTP_POSITION_INVALID: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": File seek position invalid").c_str());
+	case ARDUCOM_FTP_CANNOT_DELETE: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Cannot delete this file or folder (long file name?)").c_str());
+	default: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Unknown error").c_str());
+	}
+}
+
 void execute(ArducomMaster& master, uint8_t command, std::vector<uint8_t>& payload, uint8_t expectedBytes, std::vector<uint8_t>& result, bool canRetry = false) {
 
 	int8_t retries = parameters.retries;
@@ -214,24 +282,7 @@ void execute(ArducomMaster& master, uint8_t command, std::vector<uint8_t>& paylo
 			
 			// function error (errorInfo > 0)?
 			if (errorInfo > 0) {
-				// convert info code to string
-				char errorInfoStr[21];
-				sprintf(errorInfoStr, "%d", errorInfo);
-				
-				switch (errorInfo) {
-				case ARDUCOM_FTP_SDCARD_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": SD card unavailable").c_str());
-				case ARDUCOM_FTP_SDCARD_TYPE_UNKNOWN: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": SD card type unknown").c_str());
-				case ARDUCOM_FTP_FILESYSTEM_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": SD card file system error").c_str());
-				case ARDUCOM_FTP_NOT_INITIALIZED: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": FTP system not initialized").c_str());
-				case ARDUCOM_FTP_MISSING_FILENAME: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Required file name is missing").c_str());
-				case ARDUCOM_FTP_NOT_A_DIRECTORY: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Not a directory").c_str());
-				case ARDUCOM_FTP_FILE_OPEN_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Error opening file").c_str());
-				case ARDUCOM_FTP_READ_ERROR: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Read error").c_str());
-				case ARDUCOM_FTP_FILE_NOT_OPEN: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": File not open").c_str());
-				case ARDUCOM_FTP_POSITION_INVALID: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": File seek position invalid").c_str());
-				case ARDUCOM_FTP_CANNOT_DELETE: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Cannot delete this file or folder (long file name?)").c_str());
-				default: throw std::runtime_error((std::string("FTP error ") + errorInfoStr + ": Unknown error").c_str());
-				}
+				throwFTPError(errorInfo);
 			} else {
 				if (master.lastError == ARDUCOM_COMMAND_UNKNOWN) {
 					throw std::runtime_error("FTP is not supported by the slave");
@@ -298,6 +349,7 @@ void initSlaveFAT(ArducomMaster& master, ArducomMasterTransport* transport) {
 
 	// root path component
 	pathComponents.clear();
+	dirCacheValid = false;
 	pathComponents.push_back("/");
 }
 
@@ -318,6 +370,547 @@ void printProgress(size_t total, size_t current, uint8_t width) {
 	needEndl = true;
 }
 
+/** Requests a run of consecutive file sections starting at position and writes them to the local file
+* as they arrive. position is advanced with each frame, so it is valid even if the run breaks off.
+* Throws an exception in case of errors. */
+void readBlocks(ArducomMaster& master, uint8_t expectedBytes, uint8_t frames, size_t& position, size_t totalSize, int fd, const std::string& filename) {
+	std::vector<uint8_t> payload;
+	payload.push_back((uint8_t)position);
+	payload.push_back((uint8_t)(position >> 8));
+	payload.push_back((uint8_t)(position >> 16));
+	payload.push_back((uint8_t)(position >> 24));
+	payload.push_back(frames);
+
+	uint8_t buffer[255];
+	uint8_t size = (uint8_t)payload.size();
+	uint8_t errorInfo = 0;
+	try {
+		// keep the connection open for the following frames
+		master.execute(parameters, parameters.commandBase + ARDUCOM_FTP_COMMAND_READBLOCKS, payload.data(), &size, expectedBytes, buffer, &errorInfo, false);
+		// the first byte of each frame is the number of frames that follow
+		int following = frames;
+		bool first = true;
+		while (true) {
+			bool valid = (size >= 1);
+			if (valid && first)
+				// the slave only ends a run early if the first frame holds the rest of the file; any other count
+				// belongs to a stale frame of an earlier run that was started by the same (re-sent) request
+				valid = (buffer[0] == following - 1) || ((buffer[0] == 0) && ((size_t)(size - 1) >= totalSize - position));
+			else
+			if (valid)
+				// a lost frame must not go unnoticed; its data would be missing from the file
+				valid = (buffer[0] == following - 1);
+			if (!valid) {
+				master.close(parameters.debug);
+				throw std::runtime_error("Invalid frame sequence");
+			}
+			following = buffer[0];
+			first = false;
+			if (write(fd, &buffer[1], size - 1) < 0) {
+				master.close(parameters.debug);
+				throw_system_error((std::string("Unable to write output file: ") + filename).c_str());
+			}
+			position += size - 1;
+
+			// show "progress bar" only in interactive mode
+			if (interactive)
+				printProgress(totalSize, position, 50);
+
+			if (following == 0)
+				break;
+			master.receiveNext(parameters, expectedBytes, buffer, &size, &errorInfo, false);
+		}
+		master.close(parameters.debug);
+	} catch (const std::exception&) {
+		// function error (errorInfo > 0)?
+		if (errorInfo > 0)
+			throwFTPError(errorInfo);
+		throw;
+	}
+}
+
+/** Returns the entries of the current directory on the slave. The listing is retrieved once
+* and kept until a command changes the directory or its content. */
+std::vector<FileInfo>& listDirectory(ArducomMaster& master, ArducomMasterTransport* transport) {
+	if (dirCacheValid)
+		return dirCache;
+
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> result;
+	FileInfo fileInfo;
+	dirCache.clear();
+
+	if (useListDir) {
+		uint8_t buffer[255];
+		uint8_t size = 0;
+		uint8_t errorInfo = 0;
+		try {
+			// the slave sends all entries in a run of frames
+			master.execute(parameters, parameters.commandBase + ARDUCOM_FTP_COMMAND_LISTDIR, payload.data(), &size, transport->getDefaultExpectedBytes(), buffer, &errorInfo, false);
+			while (true) {
+				if (size < 1) {
+					master.close(parameters.debug);
+					throw std::runtime_error("Invalid directory listing frame");
+				}
+				// the frame contains as many entries as fit after the continuation marker
+				for (size_t pos = 1; pos + sizeof(fileInfo) <= size; pos += sizeof(fileInfo)) {
+					memcpy(&fileInfo, &buffer[pos], sizeof(fileInfo));
+					dirCache.push_back(fileInfo);
+				}
+				if (buffer[0] == 0)
+					break;
+				master.receiveNext(parameters, transport->getDefaultExpectedBytes(), buffer, &size, &errorInfo, false);
+			}
+			master.close(parameters.debug);
+			dirCacheValid = true;
+			return dirCache;
+		} catch (const std::exception&) {
+			if (master.lastError != ARDUCOM_COMMAND_UNKNOWN) {
+				if (errorInfo > 0)
+					throwFTPError(errorInfo);
+				throw;
+			}
+			if (parameters.verbose)
+				std::cout << "Device does not support listing with one request, reading single entries" << std::endl;
+			useListDir = false;
+			dirCache.clear();
+		}
+	}
+
+	// rewind directory
+	execute(master, ARDUCOM_FTP_COMMAND_REWIND, payload, transport->getDefaultExpectedBytes(), result, true);
+
+	while (true) {
+		// list next file
+		execute(master, ARDUCOM_FTP_COMMAND_LISTFILES, payload, transport->getDefaultExpectedBytes(), result);
+
+		// record received?
+		if (result.size() > 0) {
+			memcpy(&fileInfo, result.data(), sizeof(fileInfo));
+			dirCache.push_back(fileInfo);
+		} else
+			// no data - end of list
+			break;
+	}
+	dirCacheValid = true;
+	return dirCache;
+}
+
+/** Changes the current directory on the slave. dir may be a directory name, "/", ".." or ".". */
+void changeDirectory(ArducomMaster& master, ArducomMasterTransport* transport, const std::string& dir) {
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> result;
+
+	// the listing of the new directory must be retrieved
+	dirCacheValid = false;
+	bool exec = true;
+	// cd into root?
+	if (dir[0] == '/') {
+		pathComponents.clear();
+	} else
+	// cd up?
+	if (dir == "..") {
+		exec = false;
+		// only if we're at least one level down
+		if (pathComponents.size() > 1) {
+			// start at root, cd into sub directories
+			std::vector<std::string> pathComps = pathComponents;
+			pathComponents.clear();
+			for (size_t p = 0; p < pathComps.size() - 1; p++) {
+				payload.clear();
+				// send command to change directory
+				for (size_t i = 0; i < pathComps.at(p).length(); i++)
+					payload.push_back(pathComps.at(p)[i]);
+				execute(master, ARDUCOM_FTP_COMMAND_CHDIR, payload, transport->getDefaultExpectedBytes(), result);
+				pathComponents.push_back(pathComps.at(p));
+			}
+		}
+	} else
+	// cd to local directory?
+	if (dir == ".") {
+		// no need to execute
+		exec = false;
+	}
+
+	if (exec) {
+		payload.clear();
+		// send command to change directory
+		for (size_t i = 0; i < dir.length(); i++)
+			payload.push_back(dir[i]);
+		execute(master, ARDUCOM_FTP_COMMAND_CHDIR, payload, transport->getDefaultExpectedBytes(), result);
+		// store current directory name
+		pathComponents.push_back(dir);
+	}
+}
+
+/** Downloads the open file on the slave from position up to totalSize and writes the data to fd.
+* Uses consecutive reads if the slave supports them. Throws an exception in case of errors. */
+void transferFile(ArducomMaster& master, ArducomMasterTransport* transport, int fd, size_t position, size_t totalSize, const std::string& filename) {
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> result;
+	int retries = parameters.retries;
+	// number of frames per run; halved when runs break, 0 means single frames
+	uint8_t frames = parameters.blockFrames;
+
+	// file read loop
+	while (position < totalSize) {
+		if (useReadBlocks && (frames > 0)) {
+			// the frames of a run are received without sending further requests
+			size_t startPosition = position;
+			try {
+				readBlocks(master, transport->getDefaultExpectedBytes(), frames, position, totalSize, fd, filename);
+				if (position == startPosition)
+					throw std::runtime_error("Device reached the end of the file before the expected size");
+				// the run has made progress, start counting retries anew
+				retries = parameters.retries;
+				// the connection has recovered, return to longer runs
+				if (frames < parameters.blockFrames)
+					frames = (frames * 2 < parameters.blockFrames ? frames * 2 : parameters.blockFrames);
+			} catch (const std::exception& e) {
+				if (master.lastError == ARDUCOM_COMMAND_UNKNOWN) {
+					if (parameters.verbose)
+						std::cout << "Device does not support consecutive reads, reading single frames" << std::endl;
+					useReadBlocks = false;
+					continue;
+				}
+				// frames received before the error count as progress
+				if (position > startPosition)
+					retries = parameters.retries;
+				// shorter runs break less often on a bad connection; below two frames read single frames
+				frames /= 2;
+				if (parameters.verbose)
+					std::cout << "Run broken off, " << (frames > 1 ? "reducing to " + std::to_string(frames) + " frames per run" : "reading single frames") << std::endl;
+				if (frames < 2)
+					frames = 0;
+				// continue from the current position if possible
+				if (retries > 0) {
+					retries--;
+					if (parameters.verbose) {
+						print_what(e);
+						std::cout << "Retrying, " << retries << " " << (retries == 1 ? "retry" : "retries") << " left..." << std::endl;
+					}
+					continue;
+				}
+				std::throw_with_nested(std::runtime_error("Error during FTP operation"));
+			}
+		} else {
+			// send current seek position
+			payload.clear();
+			payload.push_back((uint8_t)position);
+			payload.push_back((uint8_t)(position >> 8));
+			payload.push_back((uint8_t)(position >> 16));
+			payload.push_back((uint8_t)(position >> 24));
+
+			// this command can be resent in case of errors (idempotent)
+			execute(master, ARDUCOM_FTP_COMMAND_READFILE, payload, transport->getDefaultExpectedBytes(), result, true);
+			if (result.size() == 0)
+				throw std::runtime_error("Device reached the end of the file before the expected size");
+
+			position += result.size();
+
+			// write data to local file
+			if (write(fd, result.data(), (unsigned int)result.size()) < 0) {
+				throw_system_error((std::string("Unable to write output file: ") + filename).c_str());
+			}
+
+			// show "progress bar" only in interactive mode
+			if (interactive)
+				printProgress(totalSize, position, 50);
+		}
+	}
+}
+
+/** Continues the CRC32 (as used by zlib) crc over the data. */
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+	static uint32_t table[256];
+	static bool tableValid = false;
+	if (!tableValid) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1);
+			table[i] = c;
+		}
+		tableValid = true;
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+/** Calculates the CRC of a section of the open file on the slave. Returns false if the slave
+* does not support this. Throws an exception if the file ends before the section does. */
+bool remoteCRC(ArducomMaster& master, ArducomMasterTransport* transport, size_t position, size_t length, uint32_t& crc) {
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> result;
+
+	crc = 0;
+	// the slave may process less than requested; continue with the intermediate CRC
+	while (length > 0) {
+		payload.clear();
+		for (int i = 0; i < 32; i += 8)
+			payload.push_back((uint8_t)(position >> i));
+		for (int i = 0; i < 32; i += 8)
+			payload.push_back((uint8_t)(length >> i));
+		for (int i = 0; i < 32; i += 8)
+			payload.push_back((uint8_t)(crc >> i));
+		try {
+			// this command can be resent in case of errors (idempotent)
+			execute(master, ARDUCOM_FTP_COMMAND_CRC, payload, transport->getDefaultExpectedBytes(), result, true);
+		} catch (const std::exception&) {
+			if (master.lastError == ARDUCOM_COMMAND_UNKNOWN) {
+				useCRC = false;
+				return false;
+			}
+			throw;
+		}
+		if (result.size() < 8)
+			throw std::runtime_error("Device did not send a proper CRC");
+		crc = (result[0] + (result[1] << 8) + (result[2] << 16) + ((uint32_t)result[3] << 24));
+		size_t processed = (result[4] + (result[5] << 8) + (result[6] << 16) + ((uint32_t)result[7] << 24));
+		if ((processed == 0) || (processed > length))
+			throw std::runtime_error("Device reached the end of the file before the expected size");
+		position += processed;
+		length -= processed;
+	}
+	return true;
+}
+
+/** Calculates the CRC of a section of the local file. */
+uint32_t localCRC(int fd, size_t position, size_t length, const std::string& filename) {
+	uint8_t buffer[4096];
+	uint32_t crc = 0;
+
+	if (lseek(fd, position, SEEK_SET) < 0)
+		throw_system_error((std::string("Unable to read file: ") + filename).c_str());
+	while (length > 0) {
+		int readBytes = read(fd, buffer, (unsigned int)(length > sizeof(buffer) ? sizeof(buffer) : length));
+		if (readBytes <= 0)
+			throw_system_error((std::string("Unable to read file: ") + filename).c_str());
+		crc = crc32(crc, buffer, readBytes);
+		length -= readBytes;
+	}
+	return crc;
+}
+
+/** Compares the first localSize bytes of the local file with the open file on the slave.
+* Returns the number of leading bytes that match, which is localSize if the files are equal.
+* Otherwise the first difference is searched by bisection to a block of VERIFY_BLOCK_SIZE.
+* If the slave does not support CRC calculation, returns localSize. */
+size_t verifyFile(ArducomMaster& master, ArducomMasterTransport* transport, const std::string& filename, size_t localSize) {
+	if (!useCRC || (localSize == 0))
+		return localSize;
+
+	int fd = open(filename.c_str(), O_RDONLY | O_BINARY);
+	if (fd < 0)
+		throw_system_error((std::string("Unable to read file: ") + filename).c_str());
+
+	size_t good = localSize;
+	try {
+		uint32_t crc;
+		if (!remoteCRC(master, transport, 0, localSize, crc)) {
+			if (parameters.verbose)
+				std::cout << "Device does not support CRC calculation, cannot verify " << filename << std::endl;
+		} else
+		if (crc != localCRC(fd, 0, localSize, filename)) {
+			// the first difference is in [good, bad)
+			good = 0;
+			size_t bad = localSize;
+			while (bad - good > VERIFY_BLOCK_SIZE) {
+				size_t middle = good + (bad - good) / 2;
+				// if the block cannot be verified only the data up to good is known to match
+				if (!remoteCRC(master, transport, good, middle - good, crc))
+					break;
+				if (crc == localCRC(fd, good, middle - good, filename))
+					good = middle;
+				else
+					bad = middle;
+			}
+		}
+	} catch (const std::exception&) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+	return good;
+}
+
+/** Converts a FAT date and time to a timestamp. The FAT fields are interpreted as UTC. */
+time_t fatToTime(int fatDate, int fatTime) {
+	struct tm fat_tm;
+	memset(&fat_tm, 0, sizeof(fat_tm));
+	fat_tm.tm_year = 80 + (fatDate >> 9);
+	fat_tm.tm_mon = ((fatDate >> 5) & 0XF) - 1;
+	fat_tm.tm_mday = fatDate & 0X1F;
+	fat_tm.tm_hour = fatTime >> 11;
+	fat_tm.tm_min = (fatTime >> 5) & 0X3F;
+	fat_tm.tm_sec = 2*(fatTime & 0X1F);
+	return timegm(&fat_tm);
+}
+
+/** Downloads the file from the current directory on the slave to localPath. If position is greater
+* than 0 the data from there on is appended to the local file. If report is true the file size and
+* the remaining bytes are printed. Returns the number of bytes transferred. */
+size_t fetchFile(ArducomMaster& master, ArducomMasterTransport* transport, const std::string& name, const std::string& localPath, size_t position, bool report = false) {
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> result;
+
+	// send command to open the file
+	for (size_t i = 0; i < name.length(); i++)
+		payload.push_back(name[i]);
+	execute(master, ARDUCOM_FTP_COMMAND_OPENREAD, payload, transport->getDefaultExpectedBytes(), result, true);
+	// the result is the file size
+	if (result.size() < 4)
+		throw std::runtime_error("Device did not send a proper file size");
+	size_t totalSize = (result[0] + (result[1] << 8) + (result[2] << 16) + (result[3] << 24));
+	if (report)
+		std::cout << "File size: " << totalSize << " bytes" << std::endl;
+	// the file has become shorter in the meantime?
+	if (position > totalSize)
+		position = 0;
+	// continue only after the data that matches the device's file
+	if ((position > 0) && parameters.verifyFile) {
+		size_t verified = verifyFile(master, transport, localPath, position);
+		if (verified < position) {
+			std::cout << localPath << ": differs from the device's file after " << verified << " bytes" << std::endl;
+			if (truncate(localPath.c_str(), verified) != 0)
+				throw_system_error((std::string("Unable to truncate file: ") + localPath).c_str());
+			position = verified;
+		}
+	}
+	if (report) {
+		if ((position > 0) && (position < totalSize))
+			std::cout << "Appending data to existing file (to overwrite, use 'set continue off')" << std::endl;
+		std::cout << "Remaining: " << totalSize - position << " bytes" << std::endl;
+	}
+
+	int fd;
+	if (position > 0)
+		fd = open(localPath.c_str(), O_APPEND | O_WRONLY | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	else
+		fd = open(localPath.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+		throw_system_error((std::string("Unable to create output file: ") + localPath).c_str());
+
+	try {
+		transferFile(master, transport, fd, position, totalSize, localPath);
+	} catch (const std::exception&) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+
+	// send command to close the file
+	payload.clear();
+	execute(master, ARDUCOM_FTP_COMMAND_CLOSEFILE, payload, transport->getDefaultExpectedBytes(), result, true);
+
+	return totalSize - position;
+}
+
+/** Changes to the directory given by the path components on the slave. */
+void restoreDirectory(ArducomMaster& master, ArducomMasterTransport* transport, const std::vector<std::string>& path) {
+	changeDirectory(master, transport, "/");
+	for (size_t i = 0; i < path.size(); i++)
+		if (path.at(i) != "/")
+			changeDirectory(master, transport, path.at(i));
+}
+
+/** Copies new and changed files from the directory remoteDir on the slave to localDir.
+* Files whose size and timestamp match are skipped; files that have grown are continued.
+* Subdirectories are not copied. */
+void mirror(ArducomMaster& master, ArducomMasterTransport* transport, const std::string& remoteDir, const std::string& localDir) {
+	struct stat st;
+	if (stat(localDir.c_str(), &st) != 0) {
+		if (mkdir(localDir.c_str(), 0755) != 0)
+			throw_system_error((std::string("Unable to create local directory: ") + localDir).c_str());
+	} else
+	if ((st.st_mode & S_IFDIR) == 0)
+		throw std::runtime_error((std::string("Not a directory: ") + localDir).c_str());
+
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// change to the remote directory; return to the current one afterwards
+	std::vector<std::string> previousPath = pathComponents;
+	if (remoteDir[0] == '/')
+		changeDirectory(master, transport, "/");
+	std::vector<std::string> remoteComponents;
+	split(remoteDir, '/', remoteComponents);
+	for (size_t i = 0; i < remoteComponents.size(); i++)
+		if (!remoteComponents.at(i).empty())
+			changeDirectory(master, transport, remoteComponents.at(i));
+
+	size_t newFiles = 0;
+	size_t appendedFiles = 0;
+	size_t replacedFiles = 0;
+	size_t unchangedFiles = 0;
+	size_t totalBytes = 0;
+	try {
+		// sizes of growing files must be current
+		dirCacheValid = false;
+		std::vector<FileInfo> fileInfos = listDirectory(master, transport);
+
+		for (size_t f = 0; f < fileInfos.size(); f++) {
+			FileInfo fileInfo = fileInfos.at(f);
+			if (fileInfo.isDir)
+				continue;
+			fileInfo.name[12] = '\0';	// make sure there's no garbage
+			std::string name(fileInfo.name);
+			size_t remoteSize = (fileInfo.size1 + (fileInfo.size2 << 8) + (fileInfo.size3 << 16) + (fileInfo.size4 << 24));
+			time_t remoteTime = fatToTime(fileInfo.lastWriteDate1 + (fileInfo.lastWriteDate2 << 8), fileInfo.lastWriteTime1 + (fileInfo.lastWriteTime2 << 8));
+			std::string localPath = localDir + "/" + name;
+
+			size_t position = 0;
+			bool exists = (stat(localPath.c_str(), &st) == 0);
+			if (exists) {
+				// FAT timestamps have a resolution of two seconds
+				if (((size_t)st.st_size == remoteSize) && (labs((long)(st.st_mtime - remoteTime)) < 2)) {
+					unchangedFiles++;
+					continue;
+				}
+				// continue a file that has grown
+				if ((size_t)st.st_size < remoteSize)
+					position = st.st_size;
+			}
+
+			std::cout << name << ": " << (position > 0 ? "appending " : "fetching ") << (remoteSize - position) << " bytes" << std::endl;
+			totalBytes += fetchFile(master, transport, name, localPath, position);
+			if (interactive) {
+				std::cout << std::endl;
+				needEndl = false;
+			}
+			// remember the timestamp of the slave's file for the next comparison
+			struct utimbuf times;
+			times.actime = remoteTime;
+			times.modtime = remoteTime;
+			utime(localPath.c_str(), &times);
+
+			if (position > 0)
+				appendedFiles++;
+			else
+			if (exists)
+				replacedFiles++;
+			else
+				newFiles++;
+		}
+	} catch (const std::exception&) {
+		// try to return to the previous directory
+		try {
+			restoreDirectory(master, transport, previousPath);
+		} catch (const std::exception&) {
+			pathComponents = previousPath;
+		}
+		throw;
+	}
+
+	restoreDirectory(master, transport, previousPath);
+
+	long elapsedMs = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::cout << "Mirror complete: " << newFiles << " new, " << appendedFiles << " appended, " << replacedFiles << " replaced, "
+		<< unchangedFiles << " unchanged; " << totalBytes << " bytes in " << elapsedMs << " ms" << std::endl;
+}
+
 void setParameter(std::vector<std::string> parts, bool print = true) {
 	bool printOnly = false;
 	if (parts.size() < 2) {
@@ -397,6 +990,20 @@ void setParameter(std::vector<std::string> parts, bool print = true) {
 			std::cout << "set continue " << (parameters.continueFile ? "on" : "off") << std::endl;
 		found = true;
 	}
+	if (parts.at(1) == "verify" || printOnly) {
+		if (parts.size() > 2) {
+			if (parts.at(2) == "on")
+				parameters.verifyFile = true;
+			else
+			if (parts.at(2) == "off")
+				parameters.verifyFile = false;
+			else
+				throw std::invalid_argument("Expected 'on' or 'off'");
+		}
+		if (print)
+			std::cout << "set verify " << (parameters.verifyFile ? "on" : "off") << std::endl;
+		found = true;
+	}
 	if (parts.at(1) == "retries" || printOnly) {
 		if (parts.size() > 2) {
 			try {
@@ -427,6 +1034,21 @@ void setParameter(std::vector<std::string> parts, bool print = true) {
 			std::cout << "set delay " << parameters.delayMs << std::endl;
 		found = true;
 	}
+	if (parts.at(1) == "blocks" || printOnly) {
+		if (parts.size() > 2) {
+			try {
+				int m_blocks = std::stoi(parts.at(2));
+				if ((m_blocks < 0) || (m_blocks > 255))
+					throw std::invalid_argument("");
+				parameters.blockFrames = m_blocks;
+			} catch (std::exception&) {
+				throw std::invalid_argument("Expected number of frames between 0 and 255");
+			}
+		}
+		if (print)
+			std::cout << "set blocks " << (int)parameters.blockFrames << std::endl;
+		found = true;
+	}
 
 	if (!found)
 		throw std::invalid_argument("Parameter name unknown: " + parts.at(1));
@@ -442,8 +1064,12 @@ void printUsageHelp() {
 	result.append("  'help' or '?': Displays tool command help.\n");
 	result.append("  'reset': Resets the FTP system on the device.\n");
 	result.append("  'dir' or 'ls': Retrieves a list of files from the device.\n");
+	result.append("    The list is kept until 'cd', 'rm' or 'reset'; use 'reset' to see new files.\n");
 	result.append("  'cd <DIR>': Changes the directory. <DIR> may also be .. or /.\n");
 	result.append("  'get <FILE>': Retrieves the file <FILE> from the device.\n");
+	result.append("  'mirror <REMOTEDIR> <LOCALDIR>': Copies new files from the device directory <REMOTEDIR>\n");
+	result.append("    to the local directory <LOCALDIR>. Files that have grown are continued, files with\n");
+	result.append("    a different size or timestamp are replaced. Subdirectories are not copied.\n");
 	result.append("  'rm <FILE>' or 'del <FILE>': Deletes the file <FILE> from the device.\n");
 	result.append("    File deletion is experimental and may corrupt the file system on the device.\n");
 	result.append("  'set': Displays a list of variables and their values.\n");
@@ -455,9 +1081,13 @@ void printUsageHelp() {
 	result.append("  'debug': Output technical information. Corresponds to command setting -vv.\n");
 	result.append("  'retries': Number of retries on error. Corresponds to command setting -x.\n");
 	result.append("  'delay': Command delay in milliseconds. Corresponds to command setting -l.\n");
+	result.append("  'blocks': Maximum number of frames the device sends for one read request\n");
+	result.append("     during 'get'. If 0, each frame is requested separately.\n");
 	result.append("  'allowdelete': If 'on', allows the experimental deletion of files.\n");
 	result.append("  'continue': If 'on', appends content to partially downloaded files.\n");
 	result.append("     If 'off', files are always overwritten completely.\n");
+	result.append("  'verify': If 'on', compares partially downloaded files with the device before\n");
+	result.append("     appending and downloads from the first difference. Corresponds to --no-verify.\n");
 	result.append("  'interactive': Specifies program behavior for batch or interactive mode.\n");
 	result.append("     This flag is set to 'on' if the program is started from a TTY, and to 'off'\n");
 	result.append("     if input is being piped to the program. Normally you should not change this.\n");
@@ -516,38 +1146,8 @@ int main(int argc, char *argv[]) {
 					initSlaveFAT(master, transport);
 				} else
 				if ((parts.at(0) == "ls") || (parts.at(0) == "dir")) {
-					// directory listing data structure
-					PACK(struct FileInfo {
-						char name[13];
-						uint8_t isDir;
-						uint8_t size1;	// size is little-endian
-						uint8_t size2;
-						uint8_t size3;
-						uint8_t size4;
-						uint8_t lastWriteDate1;
-						uint8_t lastWriteDate2;
-						uint8_t lastWriteTime1;
-						uint8_t lastWriteTime2;
-					}) fileInfo;
-
-					std::vector<FileInfo> fileInfos;
-					payload.clear();	// no payload
-
-					// rewind directory
-					execute(master, ARDUCOM_FTP_COMMAND_REWIND, payload, transport->getDefaultExpectedBytes(), result, true);
-
-					while (true) {
-						// list next file
-						execute(master, ARDUCOM_FTP_COMMAND_LISTFILES, payload, transport->getDefaultExpectedBytes(), result);
-
-						// record received?
-						if (result.size() > 0) {
-							memcpy(&fileInfo, result.data(), sizeof(fileInfo));
-							fileInfos.push_back(fileInfo);
-						} else
-							// no data - end of list
-							break;
-					}
+					FileInfo fileInfo;
+					std::vector<FileInfo>& fileInfos = listDirectory(master, transport);
 
 					std::cout << std::endl;
 
@@ -631,53 +1231,7 @@ int main(int argc, char *argv[]) {
 					} else if (parts.size() > 2) {
 						std::cout << "Invalid input: cd expects only one argument" << std::endl;
 					} else {
-						bool exec = true;
-						// cd into root?
-						if (parts.at(1)[0] == '/') {
-							pathComponents.clear();
-						} else
-						// cd up?
-						if (parts.at(1) == "..") {
-							exec = false;
-							// only if we're at least one level down
-							if (pathComponents.size() > 1) {
-								// start at root, cd into sub directories
-								std::vector<std::string> pathComps = pathComponents;
-								pathComponents.clear();
-								for (size_t p = 0; p < pathComps.size() - 1; p++) {
-									payload.clear();
-									// send command to change directory
-									for (size_t i = 0; i < pathComps.at(p).length(); i++)
-										payload.push_back(pathComps.at(p)[i]);
-									execute(master, ARDUCOM_FTP_COMMAND_CHDIR, payload, transport->getDefaultExpectedBytes(), result);
-									pathComponents.push_back(pathComps.at(p));
-								}
-							}
-						} else
-						// cd to local directory?
-						if (parts.at(1) == ".") {
-							// no need to execute
-							exec = false;
-						}
-
-						if (exec) {
-							payload.clear();
-							// send command to change directory
-							for (size_t i = 0; i < parts.at(1).length(); i++)
-								payload.push_back(parts.at(1)[i]);
-							execute(master, ARDUCOM_FTP_COMMAND_CHDIR, payload, transport->getDefaultExpectedBytes(), result);
-	/*
-							char dirname[13];
-							size_t dirlen = result.size();
-							if (dirlen > 12)
-								dirlen = 12;
-							std::cout << dirlen << std::endl;
-							memcpy(dirname, result.data(), dirlen);
-							dirname[dirlen] = '\0';
-	*/
-							// store current directory name
-							pathComponents.push_back(parts.at(1));
-						}
+						changeDirectory(master, transport, parts.at(1));
 					}
 				} else
 				if (parts.at(0) == "get") {
@@ -686,132 +1240,46 @@ int main(int argc, char *argv[]) {
 					} else if (parts.size() > 2) {
 						std::cout << "Invalid input: get expects only one argument" << std::endl;
 					} else {
-						payload.clear();
-						// send command to open the file
-						for (size_t i = 0; i < parts.at(1).length(); i++)
-							payload.push_back(parts.at(1)[i]);
-						execute(master, ARDUCOM_FTP_COMMAND_OPENREAD, payload, transport->getDefaultExpectedBytes(), result, true);
-
-						// the result is the file size
-						if (result.size() < 4) {
-							std::cout << "Error: device did not send a proper file size" << std::endl;
-						} else {
-							PACK(struct FileSize {
-								uint8_t size1;	// size is little-endian
-								uint8_t size2;
-								uint8_t size3;
-								uint8_t size4;
-							}) fileSize;
-							memcpy(&fileSize, result.data(), sizeof(fileSize));
-							size_t totalSize = (fileSize.size1 + (fileSize.size2 << 8) + (fileSize.size3 << 16) + (fileSize.size4 << 24));
-							std::cout << "File size: " << totalSize << " bytes" << std::endl;
-							if (totalSize < 0)  {
-								std::cout << "File size is negative, cannot download" << std::endl;
-								continue;	// next command
-							}
-							int fd;
-							size_t position = -1;
-							bool fileExists = false;
-							// check whether the file already exists on the master
-							if (access(parts.at(1).c_str(), F_OK) != -1) {
-								fileExists = true;
-								// open local file for reading
-								fd = open(parts.at(1).c_str(), O_RDONLY);
-								if (fd < 0) {
-									throw_system_error((std::string("Unable to read output file: ") + parts.at(1)).c_str());
-								}
-
-								// get file size; this is the position to continue reading from
-								struct stat st;
-
-								if (stat(parts.at(1).c_str(), &st) == 0)
-									position = st.st_size;
-								else {
-									throw_system_error((std::string("Unable to get file size: ") + parts.at(1)).c_str());
-								}
-
-								close(fd);
-							}
-
-							// overwrite or continue?
-							if (parameters.continueFile && (position >= 0) && (position < totalSize)) {
-								std::cout << "Appending data to existing file (to overwrite, use 'set continue off')" << std::endl;
-								// open local file for appending
-								fd = open(parts.at(1).c_str(), O_APPEND | O_WRONLY | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-								if (fd < 0) {
-									throw_system_error((std::string("Unable to create output file: ") + parts.at(1)).c_str());
-								}
+						size_t position = 0;
+						// check whether the file already exists on the master
+						struct stat st;
+						if (stat(parts.at(1).c_str(), &st) == 0) {
+							// continue or overwrite?
+							if (parameters.continueFile) {
+								// this is the position to continue reading from
+								position = st.st_size;
+							} else
+							if (!interactive) {
+								std::cout << "Cannot overwrite in non-interactive mode; cancelling" << std::endl;
+								continue;
 							} else {
-								if (fileExists) {
-									if (!interactive) {
-										std::cout << "Cannot overwrite in non-interactive mode; cancelling" << std::endl;
-										continue;
-									} else {
-										// interactive
-										std::cout << "Overwrite existing file y/N (to append data, use 'set continue on')? ";
-										std::string input;
-										getline(std::cin, input);
-										if (input != "y") {
-											std::cout << "Download cancelled" << std::endl;
-											continue;
-										}
-									}
+								// interactive
+								std::cout << "Overwrite existing file y/N (to append data, use 'set continue on')? ";
+								std::string input;
+								getline(std::cin, input);
+								if (input != "y") {
+									std::cout << "Download cancelled" << std::endl;
+									continue;
 								}
-								// open local file for writing; create from scratch
-								fd = open(parts.at(1).c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-								if (fd < 0) {
-									throw_system_error((std::string("Unable to create output file: ") + parts.at(1)).c_str());
-								}
-								// start downloading from beginning
-								position = 0;
-							}
-
-							std::cout << "Remaining: " << totalSize - position << " bytes" << std::endl;
-							if (totalSize - position == 0)  {
-								std::cout << "File seems to be complete" << std::endl;
-								continue;	// next command
 							}
+						}
 
-							// file read loop
-							while (true) {
-								// send current seek position
-								payload.clear();
-								payload.push_back((uint8_t)position);
-								payload.push_back((uint8_t)(position >> 8));
-								payload.push_back((uint8_t)(position >> 16));
-								payload.push_back((uint8_t)(position >> 24));
-
-								// this command can be resent in case of errors (idempotent)
-								execute(master, ARDUCOM_FTP_COMMAND_READFILE, payload, transport->getDefaultExpectedBytes(), result, true);
-
-								position += result.size();
-
-								// write data to local file
-								if (write(fd, result.data(), (unsigned int)result.size()) < 0) {
-									throw_system_error((std::string("Unable to write output file: ") + parts.at(1)).c_str());
-								}
-
-								// show "progress bar" only in interactive mode
-								if (interactive)
-									printProgress(totalSize, position, 50);
-
-								if (position >= totalSize)
-									break;
-							}
-
-							std::cout << std::endl;
-							needEndl = false;
-
-							// send command to close the file
-							payload.clear();
-							execute(master, ARDUCOM_FTP_COMMAND_CLOSEFILE, payload, transport->getDefaultExpectedBytes(), result, true);
-
-							// close local file
-							close(fd);
-							std::cout << "Download complete." << std::endl;
+						// the existing part of the file is verified and the rest is appended
+						if (fetchFile(master, transport, parts.at(1), parts.at(1), position, true) == 0) {
+							std::cout << "File seems to be complete" << std::endl;
+							continue;	// next command
 						}
+						std::cout << std::endl;
+						needEndl = false;
+						std::cout << "Download complete." << std::endl;
 					}
 				} else
+				if (parts.at(0) == "mirror") {
+					if (parts.size() != 3) {
+						std::cout << "Invalid input: mirror expects a remote and a local directory as arguments" << std::endl;
+					} else
+						mirror(master, transport, parts.at(1), parts.at(2));
+				} else
 				if ((parts.at(0) == "rm") || (parts.at(0) == "del")) {
 					if (parts.size() == 1) {
 						std::cout << "Invalid input: rm and del expect a file name as argument" << std::endl;
@@ -826,6 +1294,7 @@ int main(int argc, char *argv[]) {
 							// send command to delete the file
 							for (size_t i = 0; i < parts.at(1).length(); i++)
 								payload.push_back(parts.at(1)[i]);
+							dirCacheValid = false;
 							execute(master, ARDUCOM_FTP_COMMAND_DELETE, payload, transport->getDefaultExpectedBytes(), result);
 						}
 					}
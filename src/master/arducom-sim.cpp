@@ -0,0 +1,758 @@
+// arducom-sim
+// Arducom slave simulator
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+// This program runs the Arducom slave library on the host. It serves a pseudo
+// terminal (for the serial transport of the master tools), a TCP port or a UDP port
+// and can emulate a slow or unreliable device by delaying command processing,
+// limiting the link bandwidth and dropping or corrupting bytes.
+// The EEPROM is emulated in memory and can be backed by a file; the SD card
+// used by the FTP commands is emulated by a host directory.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <exception>
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <SdFat.h>
+
+#include "../slave/lib/Arducom/Arducom.h"
+#include "../slave/lib/Arducom/ArducomFTP.h"
+
+#define SIM_DEFAULT_EEPROM_SIZE		1024
+#define SIM_TEST_BLOCK_SIZE			10
+
+#define SIM_Q(str)					#str
+#define SIM_QUOTE(str)				SIM_Q(str)
+
+// the link does not buffer more than this number of bytes in advance
+#define SIM_RX_BUFFER_SIZE			256
+
+/** This class implements a Stream over a non-blocking file descriptor and simulates
+*   the properties of the physical link: bandwidth, processing delay and transmission errors.
+*/
+class SimulatedLink: public Stream {
+public:
+	unsigned long bandwidth;	// bytes per second, 0 for unlimited
+	unsigned long delayMs;		// delay between receiving a command and sending the reply
+	double dropRate;			// probability that a received byte is lost
+	double corruptRate;			// probability that a sent byte has one bit flipped
+	bool verbose;
+
+	SimulatedLink(unsigned int seed) : random(seed) {
+		this->fd = -1;
+		this->bandwidth = 0;
+		this->delayMs = 0;
+		this->dropRate = 0;
+		this->corruptRate = 0;
+		this->verbose = false;
+		this->reset();
+	}
+
+	/** Attaches the link to a new file descriptor and discards all buffered data. */
+	void attach(int fd) {
+		this->fd = fd;
+		this->reset();
+	}
+
+	/** Returns false if the peer has closed the connection. */
+	bool isConnected(void) {
+		return this->connected;
+	}
+
+	virtual int available(void) {
+		this->fill();
+		int result = this->rxCount - this->rxPos;
+		if (this->bandwidth > 0) {
+			int tokens = (int)this->refill(this->rxTokens, this->rxLast);
+			if (result > tokens)
+				result = tokens;
+		}
+		return result;
+	}
+
+	virtual int read(void) {
+		if (this->available() <= 0)
+			return -1;
+		if (this->bandwidth > 0)
+			this->rxTokens -= 1;
+		// input received; the reply is delayed by the processing time
+		this->replyTime = micros() + this->delayMs * 1000;
+		uint8_t c = this->rxBuffer[this->rxPos++];
+		if (this->verbose)
+			fprintf(stderr, "Recv: %02X\n", c);
+		return c;
+	}
+
+	virtual int peek(void) {
+		if (this->available() <= 0)
+			return -1;
+		return this->rxBuffer[this->rxPos];
+	}
+
+	virtual int availableForWrite(void) {
+		// hold back the reply during the simulated processing time
+		if ((this->delayMs > 0) && ((long)(micros() - this->replyTime) < 0))
+			return 0;
+		if (this->bandwidth > 0)
+			return (int)this->refill(this->txTokens, this->txLast);
+		return ARDUCOM_BUFFERSIZE;
+	}
+
+	virtual size_t write(uint8_t c) {
+		return this->write(&c, 1);
+	}
+
+	virtual size_t write(const uint8_t* buffer, size_t size) {
+		if (this->fd < 0)
+			return 0;
+		int allowed = this->availableForWrite();
+		if (allowed <= 0)
+			return 0;
+		if (size > (size_t)allowed)
+			size = allowed;
+		uint8_t out[SIM_RX_BUFFER_SIZE];
+		if (size > sizeof(out))
+			size = sizeof(out);
+		for (size_t i = 0; i < size; i++) {
+			out[i] = buffer[i];
+			if ((this->corruptRate > 0) && (this->chance(this->corruptRate))) {
+				out[i] ^= (1 << (this->random() % 8));
+				if (this->verbose)
+					fprintf(stderr, "Corrupted sent byte %02X to %02X\n", buffer[i], out[i]);
+			}
+		}
+		ssize_t written = ::write(this->fd, out, size);
+		if (written < 0) {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EIO))
+				this->connected = false;
+			return 0;
+		}
+		if (this->bandwidth > 0)
+			this->txTokens -= written;
+		if (this->verbose) {
+			fprintf(stderr, "Send:");
+			for (ssize_t i = 0; i < written; i++)
+				fprintf(stderr, " %02X", out[i]);
+			fprintf(stderr, "\n");
+		}
+		return written;
+	}
+
+protected:
+	int fd;
+	bool connected;
+	std::mt19937 random;
+	uint8_t rxBuffer[SIM_RX_BUFFER_SIZE];
+	int rxPos;
+	int rxCount;
+	double rxTokens;
+	double txTokens;
+	unsigned long rxLast;
+	unsigned long txLast;
+	unsigned long replyTime;
+
+	void reset(void) {
+		this->connected = true;
+		this->rxPos = 0;
+		this->rxCount = 0;
+		this->rxTokens = 0;
+		this->txTokens = 0;
+		this->rxLast = micros();
+		this->txLast = micros();
+		this->replyTime = micros();
+	}
+
+	bool chance(double probability) {
+		return std::uniform_real_distribution<double>(0.0, 1.0)(this->random) < probability;
+	}
+
+	/** Adds the tokens for the time elapsed since the last call. At most one millisecond worth
+	*   of data (and at least one byte) may accumulate. Returns the number of whole tokens. */
+	double refill(double& tokens, unsigned long& last) {
+		unsigned long now = micros();
+		tokens += (double)(now - last) * this->bandwidth / 1000000.0;
+		last = now;
+		double maxTokens = this->bandwidth / 1000.0;
+		if (maxTokens < 1)
+			maxTokens = 1;
+		if (tokens > maxTokens)
+			tokens = maxTokens;
+		return (tokens < 0 ? 0 : (unsigned long)tokens);
+	}
+
+	/** Reads pending input from the file descriptor if the buffer is empty. */
+	void fill(void) {
+		if ((this->fd < 0) || (this->rxPos < this->rxCount))
+			return;
+		this->rxPos = 0;
+		this->rxCount = 0;
+		uint8_t buffer[SIM_RX_BUFFER_SIZE];
+		ssize_t count = ::read(this->fd, buffer, sizeof(buffer));
+		if (count == 0) {
+			// end of file: peer has closed the connection
+			this->connected = false;
+			return;
+		}
+		if (count < 0) {
+			// a pty returns EIO while no process has the slave side open
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EIO))
+				this->connected = false;
+			return;
+		}
+		for (ssize_t i = 0; i < count; i++) {
+			if ((this->dropRate > 0) && (this->chance(this->dropRate))) {
+				if (this->verbose)
+					fprintf(stderr, "Dropped received byte %02X\n", buffer[i]);
+				continue;
+			}
+			this->rxBuffer[this->rxCount++] = buffer[i];
+		}
+	}
+};
+
+/** This class implements an Arducom transport over a UDP socket. Each datagram
+*   contains one command; the reply is sent to its sender as one datagram.
+*   It simulates the same link properties as the SimulatedLink class, except that
+*   whole datagrams are lost or corrupted instead of single bytes.
+*/
+class SimulatedDatagramTransport: public ArducomTransport {
+public:
+	unsigned long delayMs;		// delay between receiving a command and sending the reply
+	double dropRate;			// probability that a received datagram is lost
+	double corruptRate;			// probability that a sent datagram has one bit flipped
+	bool verbose;
+
+	SimulatedDatagramTransport(unsigned int seed) : ArducomTransport(), random(seed) {
+		this->fd = -1;
+		this->delayMs = 0;
+		this->dropRate = 0;
+		this->corruptRate = 0;
+		this->verbose = false;
+		this->replyTime = 0;
+		memset(&this->peer, 0, sizeof(this->peer));
+	}
+
+	void attach(int fd) {
+		this->fd = fd;
+	}
+
+	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
+		this->queueSend(buffer, count);
+		this->flush();
+		return ARDUCOM_OK;
+	}
+
+	virtual int8_t doWork(Arducom* arducom) {
+		if (this->status == SENDING) {
+			this->flush();
+			if (this->status == SENDING)
+				return ARDUCOM_OK;
+		}
+		uint8_t buffer[SIM_RX_BUFFER_SIZE];
+		struct sockaddr_in sender;
+		socklen_t senderSize = sizeof(sender);
+		ssize_t count = recvfrom(this->fd, buffer, sizeof(buffer), 0, (struct sockaddr*)&sender, &senderSize);
+		if (count <= 0)
+			return ARDUCOM_OK;
+		if ((this->dropRate > 0) && (this->chance(this->dropRate))) {
+			if (this->verbose)
+				fprintf(stderr, "Dropped received datagram of %d bytes\n", (int)count);
+			return ARDUCOM_OK;
+		}
+		if (this->verbose) {
+			fprintf(stderr, "Recv:");
+			for (ssize_t i = 0; i < count; i++)
+				fprintf(stderr, " %02X", buffer[i]);
+			fprintf(stderr, "\n");
+		}
+		// each datagram is a new command
+		if (count > ARDUCOM_BUFFERSIZE) {
+			this->status = TOO_MUCH_DATA;
+			this->size = 0;
+			return ARDUCOM_OVERFLOW;
+		}
+		memcpy(this->data, buffer, count);
+		this->size = count;
+		this->status = HAS_DATA;
+		this->peer = sender;
+		this->replyTime = micros() + this->delayMs * 1000;
+		return ARDUCOM_OK;
+	}
+
+	/** Returns true if a reply is waiting for the end of the simulated processing time. */
+	bool isDelaying(void) {
+		return this->status == SENDING;
+	}
+
+protected:
+	int fd;
+	std::mt19937 random;
+	struct sockaddr_in peer;
+	unsigned long replyTime;
+
+	bool chance(double probability) {
+		return std::uniform_real_distribution<double>(0.0, 1.0)(this->random) < probability;
+	}
+
+	/** Sends the queued reply once the processing time has elapsed. */
+	void flush(void) {
+		if ((this->delayMs > 0) && ((long)(micros() - this->replyTime) < 0))
+			return;
+		uint8_t out[ARDUCOM_BUFFERSIZE];
+		memcpy(out, this->data, this->size);
+		if ((this->corruptRate > 0) && (this->chance(this->corruptRate))) {
+			uint8_t i = this->random() % this->size;
+			out[i] ^= (1 << (this->random() % 8));
+			if (this->verbose)
+				fprintf(stderr, "Corrupted sent byte %02X to %02X\n", this->data[i], out[i]);
+		}
+		if (this->verbose) {
+			fprintf(stderr, "Send:");
+			for (uint8_t i = 0; i < this->size; i++)
+				fprintf(stderr, " %02X", out[i]);
+			fprintf(stderr, "\n");
+		}
+		sendto(this->fd, out, this->size, 0, (struct sockaddr*)&this->peer, sizeof(this->peer));
+		this->status = SENT;
+		this->size = 0;
+	}
+};
+
+/** This command demonstrates a slow operation that completes in the background.
+*   It expects three bytes: the duration in milliseconds (LSB first) and a flag byte.
+*   If the flag byte is nonzero the command does not estimate its remaining time.
+*   The reply contains the elapsed time in milliseconds and the number of resume calls
+*   (two bytes each, LSB first).
+*/
+class SimSlowCommand: public ArducomCommand {
+public:
+	SimSlowCommand(uint8_t commandCode) : ArducomCommand(commandCode, 3) {
+		this->startTime = 0;
+		this->duration = 0;
+		this->noEstimate = false;
+		this->resumeCalls = 0;
+	}
+
+	virtual int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+		this->duration = dataBuffer[0] | (dataBuffer[1] << 8);
+		this->noEstimate = (dataBuffer[2] != 0);
+		this->startTime = millis();
+		this->resumeCalls = 0;
+		*errorInfo = this->estimate();
+		return ARDUCOM_COMMAND_PENDING;
+	}
+
+	virtual int8_t resume(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+		if (this->resumeCalls < 0xFFFF)
+			this->resumeCalls++;
+		unsigned long elapsed = millis() - this->startTime;
+		if (elapsed < this->duration) {
+			*errorInfo = this->estimate();
+			return ARDUCOM_COMMAND_PENDING;
+		}
+		if (elapsed > 0xFFFF)
+			elapsed = 0xFFFF;
+		destBuffer[0] = elapsed & 0xFF;
+		destBuffer[1] = (elapsed >> 8) & 0xFF;
+		destBuffer[2] = this->resumeCalls & 0xFF;
+		destBuffer[3] = (this->resumeCalls >> 8) & 0xFF;
+		*dataSize = 4;
+		return ARDUCOM_OK;
+	}
+
+protected:
+	unsigned long startTime;
+	uint16_t duration;
+	bool noEstimate;
+	uint16_t resumeCalls;
+
+	// remaining time in units of 10 ms
+	uint8_t estimate(void) {
+		if (this->noEstimate)
+			return 0;
+		unsigned long elapsed = millis() - this->startTime;
+		if (elapsed >= this->duration)
+			return 0;
+		unsigned long remaining = (this->duration - elapsed + 9) / 10;
+		return (remaining > 255 ? 255 : (uint8_t)remaining);
+	}
+};
+
+/** Simulator settings from the command line. */
+class SimulatorParameters {
+public:
+	std::string transport;
+	int port;
+	std::string link;
+	std::string eepromFile;
+	int eepromSize;
+	std::string sdDirectory;
+	unsigned long delayMs;
+	unsigned long bandwidth;
+	double dropRate;
+	double corruptRate;
+	unsigned int seed;
+	bool verbose;
+
+	SimulatorParameters() {
+		transport = "serial";
+		port = ARDUCOM_TCP_DEFAULT_PORT;
+		eepromSize = SIM_DEFAULT_EEPROM_SIZE;
+		delayMs = 0;
+		bandwidth = 0;
+		dropRate = 0;
+		corruptRate = 0;
+		seed = 0;
+		verbose = false;
+	}
+
+	void setFromArguments(int argc, char* argv[]) {
+		std::vector<std::string> args(argv + 1, argv + argc);
+		for (size_t i = 0; i < args.size(); i++) {
+			if ((args.at(i) == "-h") || (args.at(i) == "-?") || (args.at(i) == "--help")) {
+				std::cout << getHelp();
+				exit(0);
+			}
+			else
+				if (args.at(i) == "-t") {
+					transport = nextArgument(args, &i, "transport type");
+					if ((transport != "serial") && (transport != "tcpip") && (transport != "udp"))
+						throw std::invalid_argument("Unknown transport type (expected serial, tcpip or udp): " + transport);
+				}
+				else
+					if (args.at(i) == "-p") {
+						port = (int)nextNumber(args, &i, "port number");
+						if ((port < 1) || (port > 65535))
+							throw std::invalid_argument("Port number must be within range 1..65535 (argument -p)");
+					}
+					else
+						if (args.at(i) == "-l") {
+							link = nextArgument(args, &i, "link path");
+						}
+						else
+							if (args.at(i) == "--eeprom") {
+								eepromFile = nextArgument(args, &i, "EEPROM file name");
+							}
+							else
+								if (args.at(i) == "--eepromSize") {
+									eepromSize = (int)nextNumber(args, &i, "EEPROM size");
+									if ((eepromSize < 1) || (eepromSize > 65536))
+										throw std::invalid_argument("EEPROM size must be within range 1..65536 (argument --eepromSize)");
+								}
+								else
+									if (args.at(i) == "--sd") {
+										sdDirectory = nextArgument(args, &i, "SD card directory");
+									}
+									else
+										if (args.at(i) == "--delay") {
+											delayMs = (unsigned long)nextNumber(args, &i, "delay in milliseconds");
+										}
+										else
+											if (args.at(i) == "--bandwidth") {
+												bandwidth = (unsigned long)nextNumber(args, &i, "bandwidth in bytes per second");
+											}
+											else
+												if (args.at(i) == "--drop") {
+													dropRate = nextRate(args, &i, "drop rate");
+												}
+												else
+													if (args.at(i) == "--corrupt") {
+														corruptRate = nextRate(args, &i, "corruption rate");
+													}
+													else
+														if (args.at(i) == "--seed") {
+															seed = (unsigned int)nextNumber(args, &i, "random seed");
+														}
+														else
+															if (args.at(i) == "-v") {
+																verbose = true;
+															}
+															else
+																throw std::invalid_argument("Unknown argument: " + args.at(i));
+		}
+	}
+
+protected:
+	std::string nextArgument(std::vector<std::string>& args, size_t* i, const char* what) {
+		(*i)++;
+		if (args.size() == *i)
+			throw std::invalid_argument("Expected " + std::string(what) + " after argument " + args.at(*i - 1));
+		return args.at(*i);
+	}
+
+	long nextNumber(std::vector<std::string>& args, size_t* i, const char* what) {
+		std::string value = nextArgument(args, i, what);
+		try {
+			long result = std::stol(value);
+			if (result < 0)
+				throw std::out_of_range(value);
+			return result;
+		}
+		catch (std::exception&) {
+			throw std::invalid_argument("Expected non-negative " + std::string(what) + " after argument " + args.at(*i - 1));
+		}
+	}
+
+	double nextRate(std::vector<std::string>& args, size_t* i, const char* what) {
+		std::string value = nextArgument(args, i, what);
+		double result;
+		try {
+			result = std::stod(value);
+		}
+		catch (std::exception&) {
+			result = -1;
+		}
+		if ((result < 0) || (result > 1))
+			throw std::invalid_argument("Expected " + std::string(what) + " between 0 and 1 after argument " + args.at(*i - 1));
+		return result;
+	}
+
+	std::string getHelp(void) {
+		std::string result;
+		result.append("Arducom slave simulator v1.0\n");
+		result.append("https://github.com/leomeyer/Arducom\n");
+		result.append("Build: " __DATE__ " " __TIME__ "\n");
+		result.append("\n");
+		result.append("Parameters:\n");
+		result.append("  -t <transport>: Transport type. One of: serial, tcpip, udp. Default: serial.\n");
+		result.append("    serial creates a pseudo terminal and prints its name.\n");
+		result.append("  -p <port>: TCP or UDP port. Default: " SIM_QUOTE(ARDUCOM_TCP_DEFAULT_PORT) ".\n");
+		result.append("  -l <path>: Create a symbolic link to the pseudo terminal.\n");
+		result.append("  --eeprom <file>: Load EEPROM content from and save it to this file.\n");
+		result.append("  --eepromSize <n>: EEPROM size in bytes. Default: " SIM_QUOTE(SIM_DEFAULT_EEPROM_SIZE) ".\n");
+		result.append("  --sd <dir>: Use this directory as SD card and enable the FTP commands.\n");
+		result.append("  --delay <ms>: Processing delay between command and reply.\n");
+		result.append("  --bandwidth <n>: Link bandwidth in bytes per second. Default: unlimited.\n");
+		result.append("  --drop <rate>: Probability (0..1) that a received byte is lost.\n");
+		result.append("    For UDP, the probability that a received datagram is lost.\n");
+		result.append("  --corrupt <rate>: Probability (0..1) that a sent byte is corrupted.\n");
+		result.append("    For UDP, the probability that a sent datagram is corrupted.\n");
+		result.append("    --bandwidth does not apply to UDP.\n");
+		result.append("  --seed <n>: Seed for the error injection random generator.\n");
+		result.append("  -v: Print transmitted bytes and injected errors to stderr.\n");
+		result.append("\n");
+		result.append("Commands:\n");
+		result.append("  0: Version (info: arducom-sim)\n");
+		result.append("  9, 10: Read, write EEPROM block\n");
+		result.append("  19, 20: Read, write test block (" SIM_QUOTE(SIM_TEST_BLOCK_SIZE) " bytes)\n");
+		result.append("  21: Slow command that completes in the background. Parameters: duration in ms\n");
+		result.append("    (2 bytes, LSB first), flag byte (nonzero: send no time estimate).\n");
+		result.append("    Returns the elapsed time in ms and the number of resume calls (2 bytes each).\n");
+#if ARDUCOM_STATISTICS == 1
+		result.append("  " SIM_QUOTE(ARDUCOM_STATISTICS_COMMAND) ": Execution statistics\n");
+#endif
+		result.append("  " SIM_QUOTE(ARDUCOM_FTP_DEFAULT_COMMANDBASE) " - 70: FTP commands (requires --sd)\n");
+		result.append("\n");
+		result.append("Example:\n");
+		result.append("\n");
+		result.append("./arducom-sim -l /tmp/arducom --sd ~/sdcard --bandwidth 5760 &\n");
+		result.append("./arducom-ftp -d /tmp/arducom -t serial --initDelay 0\n");
+		return result;
+	}
+};
+
+static volatile sig_atomic_t terminated = 0;
+
+static void handleSignal(int signal) {
+	terminated = 1;
+}
+
+static void shutdownHook(uint8_t* dataBuffer) {
+	terminated = 1;
+}
+
+static int setNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0))
+		throw std::runtime_error(std::string("Unable to set non-blocking mode: ") + strerror(errno));
+	return fd;
+}
+
+static int openPseudoTerminal(const std::string& link) {
+	int master, slave;
+	char name[256];
+	struct termios tio;
+	memset(&tio, 0, sizeof(tio));
+	cfmakeraw(&tio);
+	if (openpty(&master, &slave, name, &tio, NULL) != 0)
+		throw std::runtime_error(std::string("Unable to open pseudo terminal: ") + strerror(errno));
+	// keep the slave side open so that the master side does not see a hangup between clients
+	if (!link.empty()) {
+		unlink(link.c_str());
+		if (symlink(name, link.c_str()) != 0)
+			throw std::runtime_error("Unable to create link " + link + ": " + strerror(errno));
+	}
+	std::cout << "Serving on " << name << std::endl;
+	return setNonBlocking(master);
+}
+
+static int openDatagramSocket(int port) {
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		throw std::runtime_error(std::string("Unable to create socket: ") + strerror(errno));
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+		throw std::runtime_error(std::string("Unable to bind to port: ") + strerror(errno));
+	std::cout << "Listening on UDP port " << port << std::endl;
+	return setNonBlocking(fd);
+}
+
+static int openServerSocket(int port) {
+	int server = socket(AF_INET, SOCK_STREAM, 0);
+	if (server < 0)
+		throw std::runtime_error(std::string("Unable to create socket: ") + strerror(errno));
+	int enable = 1;
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(server, (struct sockaddr*)&address, sizeof(address)) < 0)
+		throw std::runtime_error(std::string("Unable to bind to port: ") + strerror(errno));
+	if (listen(server, 1) < 0)
+		throw std::runtime_error(std::string("Unable to listen on port: ") + strerror(errno));
+	std::cout << "Listening on TCP port " << port << std::endl;
+	return setNonBlocking(server);
+}
+
+int main(int argc, char* argv[]) {
+	SimulatorParameters parameters;
+	int fd = -1;
+	int server = -1;
+
+	try {
+		parameters.setFromArguments(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr << "Use -h for help." << std::endl;
+		return 1;
+	}
+
+	signal(SIGINT, handleSignal);
+	signal(SIGTERM, handleSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	SimulatedLink link(parameters.seed);
+	link.bandwidth = parameters.bandwidth;
+	link.delayMs = parameters.delayMs;
+	link.dropRate = parameters.dropRate;
+	link.corruptRate = parameters.corruptRate;
+	link.verbose = parameters.verbose;
+
+	ArducomTransportStream streamTransport(&link);
+
+	SimulatedDatagramTransport datagramTransport(parameters.seed);
+	datagramTransport.delayMs = parameters.delayMs;
+	datagramTransport.dropRate = parameters.dropRate;
+	datagramTransport.corruptRate = parameters.corruptRate;
+	datagramTransport.verbose = parameters.verbose;
+
+	bool udp = (parameters.transport == "udp");
+	Arducom arducom(udp ? (ArducomTransport*)&datagramTransport : (ArducomTransport*)&streamTransport);
+
+	uint8_t testBlock[SIM_TEST_BLOCK_SIZE];
+	memset(testBlock, 0, sizeof(testBlock));
+
+	EEPROM.begin(parameters.eepromSize, parameters.eepromFile.empty() ? NULL : parameters.eepromFile.c_str());
+
+	// the same commands as the hello-world sketch where applicable
+	arducom.addCommand(new ArducomVersionCommand("arducom-sim", shutdownHook));
+	arducom.addCommand(new ArducomReadEEPROMBlock(9));
+	arducom.addCommand(new ArducomWriteEEPROMBlock(10));
+	arducom.addCommand(new ArducomReadBlock(19, testBlock, SIM_TEST_BLOCK_SIZE));
+	arducom.addCommand(new ArducomWriteBlock(20, testBlock, SIM_TEST_BLOCK_SIZE));
+	arducom.addCommand(new SimSlowCommand(21));
+#if ARDUCOM_STATISTICS == 1
+	arducom.addCommand(new ArducomStatisticsCommand());
+#endif
+
+	SdFat sdCard;
+	ArducomFTP arducomFTP;
+	try {
+		if (!parameters.sdDirectory.empty()) {
+			if (!sdCard.begin(parameters.sdDirectory.c_str()))
+				throw std::runtime_error("Unable to use directory as SD card: " + parameters.sdDirectory);
+			if (arducomFTP.init(&arducom, &sdCard) != ARDUCOM_OK)
+				throw std::runtime_error("Unable to initialize the FTP commands");
+		}
+
+		if (udp) {
+			fd = openDatagramSocket(parameters.port);
+			datagramTransport.attach(fd);
+		} else
+		if (parameters.transport == "tcpip")
+			server = openServerSocket(parameters.port);
+		else {
+			fd = openPseudoTerminal(parameters.link);
+			link.attach(fd);
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	while (!terminated) {
+		// accept a new TCP client if there is none
+		if ((server >= 0) && (fd < 0)) {
+			fd = accept(server, NULL, NULL);
+			if (fd >= 0) {
+				int enable = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+				setNonBlocking(fd);
+				link.attach(fd);
+				if (parameters.verbose)
+					std::cerr << "Client connected" << std::endl;
+			}
+		}
+
+		arducom.doWork();
+
+		if ((server >= 0) && (fd >= 0) && !link.isConnected()) {
+			if (parameters.verbose)
+				std::cerr << "Client disconnected" << std::endl;
+			close(fd);
+			fd = -1;
+			link.attach(fd);
+		}
+
+		// do not spin if there is nothing to do
+		if (udp) {
+			if (!datagramTransport.isDelaying())
+				usleep(100);
+		} else
+		if (!arducom.isSending() && (link.available() <= 0))
+			usleep(100);
+	}
+
+	if (fd >= 0)
+		close(fd);
+	if (server >= 0)
+		close(server);
+	if (!parameters.link.empty())
+		unlink(parameters.link.c_str());
+	return 0;
+}
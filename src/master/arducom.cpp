@@ -20,6 +20,7 @@
 #endif
 #include <cstring>
 #include <bitset>
+#include <iomanip>
 
 #include "../slave/lib/Arducom/Arducom.h"
 
@@ -46,6 +47,7 @@ namespace Arducom {
 		char outputSeparator;
 		char inputSeparator;
 		bool tryInterpret;
+		bool stats;
 
 		ArducomParameters() : ArducomBaseParameters() {
 			command = -1;
@@ -58,6 +60,7 @@ namespace Arducom {
 			outputSeparator = ARDUCOM_DEFAULT_SEPARATOR;
 			inputSeparator = ARDUCOM_DEFAULT_SEPARATOR;
 			tryInterpret = true;
+			stats = false;
 		}
 
 		void evaluateArgument(std::vector<std::string>& args, size_t* i) override {
@@ -165,12 +168,20 @@ namespace Arducom {
 														readInputSpecified = true;
 													}
 													else
-														ArducomBaseParameters::evaluateArgument(args, i);
+														if (args.at(*i) == "--stats") {
+															stats = true;
+														}
+														else
+															ArducomBaseParameters::evaluateArgument(args, i);
 		};
 
 		ArducomMasterTransport* validate() {
 			ArducomMasterTransport* transport = ArducomBaseParameters::validate();
 
+			// the statistics command has a default code
+			if (stats && (command < 0))
+				command = ARDUCOM_STATISTICS_COMMAND;
+
 			if ((command < 0) || (command > 126))
 				throw std::invalid_argument("Expected command number within range 0..126 (argument -c)");
 
@@ -235,6 +246,8 @@ namespace Arducom {
 			result.append("    Must be in the specified input format.\n");
 			result.append("  --no-newline: No newline after output.\n");
 			result.append("  --no-interpret: No standard interpretation of command 0 response.\n");
+			result.append("  --stats: Query and display command execution statistics.\n");
+			result.append("    The slave must be compiled with ARDUCOM_STATISTICS. Command default: " ARDUCOM_QUOTE(ARDUCOM_STATISTICS_COMMAND) ".\n");
 			result.append("\n");
 			result.append("Examples:\n");
 			result.append("\n");
@@ -291,6 +304,36 @@ int arducom_main(int argc, char* argv[]) {
 		uint8_t buffer[255];
 		uint8_t size = (uint8_t)parameters.payload.size();
 
+		// query statistics?
+		if (parameters.stats) {
+			uint8_t index = 0;
+			uint8_t count = 1;
+			while (index < count) {
+				size = 1;
+				master->execute(parameters, parameters.command, &index, &size, parameters.expectedBytes, buffer, &errorInfo);
+				if (size < 3)
+					throw std::runtime_error("Invalid statistics response (too short)");
+				count = buffer[0];
+				if (index == 0) {
+					std::cout << "Timeout resets: " << (buffer[1] + (buffer[2] << 8)) << std::endl;
+					std::cout << "Command      Calls     Errors     Min us     Max us     Avg us   Total us" << std::endl;
+				}
+				if (size >= 20) {
+					uint16_t calls = buffer[4] + (buffer[5] << 8);
+					uint16_t errors = buffer[6] + (buffer[7] << 8);
+					uint32_t minMicros, maxMicros, totalMicros;
+					memcpy(&minMicros, &buffer[8], 4);
+					memcpy(&maxMicros, &buffer[12], 4);
+					memcpy(&totalMicros, &buffer[16], 4);
+					std::cout << std::setw(7) << (int)buffer[3] << std::setw(11) << calls << std::setw(11) << errors
+						<< std::setw(11) << minMicros << std::setw(11) << maxMicros
+						<< std::setw(11) << (calls > 0 ? totalMicros / calls : 0) << std::setw(11) << totalMicros << std::endl;
+				}
+				index++;
+			}
+			return 0;
+		}
+
 		master->execute(parameters, parameters.command, parameters.payload.data(), &size, parameters.expectedBytes, buffer, &errorInfo);
 
 		// output received?
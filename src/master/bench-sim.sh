@@ -0,0 +1,22 @@
+#! /bin/bash
+
+# Runs arducom-bench against arducom-sim over a pseudo terminal, TCP loopback and UDP loopback.
+# Build both tools first (make-sim.sh, make-bench.sh). Additional arguments are passed
+# to arducom-bench, e. g. --csv --label $(git rev-parse --short HEAD) >> bench.csv
+
+PTY_LINK=/tmp/arducom-bench-$$
+TCP_PORT=4153
+UDP_PORT=4154
+
+./arducom-sim -l $PTY_LINK > /dev/null &
+SERIAL_PID=$!
+./arducom-sim -t tcpip -p $TCP_PORT > /dev/null &
+TCP_PID=$!
+./arducom-sim -t udp -p $UDP_PORT > /dev/null &
+UDP_PID=$!
+trap "kill $SERIAL_PID $TCP_PID $UDP_PID 2> /dev/null" EXIT
+sleep 0.5
+
+./arducom-bench -t serial -d $PTY_LINK --initDelay 0 -l 0 "$@"
+./arducom-bench -t tcpip -d 127.0.0.1 -a $TCP_PORT -l 0 --no-header "$@"
+./arducom-bench -t udp -d 127.0.0.1 -a $UDP_PORT --no-header "$@"
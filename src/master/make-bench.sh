@@ -0,0 +1,4 @@
+#! /bin/bash
+
+# requires package libssl-dev for the crypto functions
+g++ ArducomMaster.cpp ArducomMasterI2C.cpp ArducomMasterSerial.cpp ArducomMasterTCPIP.cpp ArducomMasterUDP.cpp arducom-bench.cpp -o arducom-bench -W -Wall -Wextra -std=c++11 -Wno-unused-parameter -lrt -lcrypto -pthread
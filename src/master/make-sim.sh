@@ -0,0 +1,4 @@
+#! /bin/bash
+
+# builds the slave library with the Arduino emulation in the sim directory
+g++ arducom-sim.cpp sim/Arduino.cpp sim/EEPROM.cpp sim/SdFat.cpp ../slave/lib/Arducom/Arducom.cpp ../slave/lib/Arducom/ArducomFTP.cpp -o arducom-sim -Isim -I../slave/lib/Arducom -DARDUINO=100 -DARDUCOM_SIM -DARDUCOM_STATISTICS=1 -W -Wall -Wextra -std=c++11 -Wno-unused-parameter -lutil
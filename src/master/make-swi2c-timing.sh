@@ -0,0 +1,5 @@
+#! /bin/bash
+
+# builds the timing model for the SoftwareI2CSlave interrupt routine
+# add -DI2C_SLAVE_CLOCK_STRETCHING=1 to check the routine with clock stretching
+g++ swi2c-timing.cpp -o swi2c-timing -W -Wall -Wextra -std=c++11 -Wno-unused-parameter -O2 "$@"
@@ -0,0 +1,104 @@
+// Arducom slave simulator
+// Minimal Arduino core emulation for building the slave library on Linux
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+#include <time.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+
+static struct timespec startTime;
+static bool started = false;
+
+static uint64_t elapsedMicros(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!started) {
+		startTime = now;
+		started = true;
+	}
+	return (uint64_t)(now.tv_sec - startTime.tv_sec) * 1000000 + (now.tv_nsec - startTime.tv_nsec) / 1000;
+}
+
+// both counters wrap around like on the Arduino
+unsigned long millis(void) {
+	return (uint32_t)(elapsedMicros() / 1000);
+}
+
+unsigned long micros(void) {
+	return (uint32_t)elapsedMicros();
+}
+
+void delay(unsigned long ms) {
+	usleep(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+	usleep(us);
+}
+
+void yield(void) {
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+int digitalRead(uint8_t pin) {
+	return LOW;
+}
+
+int analogRead(uint8_t pin) {
+	return 0;
+}
+
+void analogWrite(uint8_t pin, int value) {
+}
+
+void wdt_enable(uint8_t timeout) {
+	fprintf(stderr, "Watchdog reset requested, exiting\n");
+	exit(0);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+	size_t n = 0;
+	while (size--) {
+		if (this->write(*buffer++) == 0)
+			break;
+		n++;
+	}
+	return n;
+}
+
+size_t Print::printSigned(long n, int base) {
+	if ((n < 0) && (base == DEC))
+		return this->write((uint8_t)'-') + this->printNumber(0UL - (unsigned long)n, base);
+	return this->printNumber(n, base);
+}
+
+size_t Print::printNumber(unsigned long n, int base) {
+	char buf[8 * sizeof(long) + 1];
+	char* str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2)
+		base = 10;
+	do {
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return this->write(str);
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+	size_t count = 0;
+	while ((count < length) && (this->available() > 0))
+		buffer[count++] = (uint8_t)this->read();
+	return count;
+}
@@ -0,0 +1,107 @@
+// Arducom slave simulator
+// Minimal Arduino core emulation for building the slave library on Linux
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+// This header provides just enough of the Arduino core (Print, Stream, timing
+// functions and program memory macros) to compile Arducom.cpp and ArducomFTP.cpp
+// for the host. It is only used by arducom-sim; see make-sim.sh.
+
+#ifndef __ARDUCOM_SIM_ARDUINO_H
+#define __ARDUCOM_SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH				1
+#define LOW					0
+#define INPUT				0
+#define OUTPUT				1
+#define INPUT_PULLUP		2
+
+#define DEC					10
+#define HEX					16
+#define OCT					8
+#define BIN					2
+
+#define NUM_ANALOG_INPUTS	6
+
+#define WDTO_15MS			0
+
+// program memory is ordinary memory on the host
+#define PROGMEM
+#define PSTR(s)				(s)
+#define pgm_read_byte(addr)		(*(const uint8_t*)(addr))
+#define pgm_read_word(addr)		(*(const uint16_t*)(addr))
+#define pgm_read_dword(addr)	(*(const uint32_t*)(addr))
+#define strcpy_P(dest, src)		strcpy((dest), (src))
+#define memcpy_P(dest, src, n)	memcpy((dest), (src), (n))
+
+class __FlashStringHelper;
+#define F(s)				(reinterpret_cast<const __FlashStringHelper*>(s))
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+// a watchdog reset terminates the simulator
+void wdt_enable(uint8_t timeout);
+
+inline void interrupts(void) {}
+inline void noInterrupts(void) {}
+
+/** Base class for character output, as in the Arduino core. */
+class Print {
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size);
+	virtual int availableForWrite(void) { return 0; }
+	virtual void flush(void) {}
+
+	size_t write(const char* str) { return str == NULL ? 0 : this->write((const uint8_t*)str, strlen(str)); }
+
+	size_t print(const __FlashStringHelper* str) { return this->write(reinterpret_cast<const char*>(str)); }
+	size_t print(const char* str) { return this->write(str); }
+	size_t print(char c) { return this->write((uint8_t)c); }
+	size_t print(unsigned char n, int base = DEC) { return this->printNumber(n, base); }
+	size_t print(int n, int base = DEC) { return this->printSigned(n, base); }
+	size_t print(unsigned int n, int base = DEC) { return this->printNumber(n, base); }
+	size_t print(long n, int base = DEC) { return this->printSigned(n, base); }
+	size_t print(unsigned long n, int base = DEC) { return this->printNumber(n, base); }
+
+	size_t println(void) { return this->write("\r\n"); }
+	template <typename T> size_t println(T value) { size_t n = this->print(value); return n + this->println(); }
+	template <typename T> size_t println(T value, int base) { size_t n = this->print(value, base); return n + this->println(); }
+
+private:
+	size_t printSigned(long n, int base);
+	size_t printNumber(unsigned long n, int base);
+};
+
+/** Base class for character streams, as in the Arduino core. */
+class Stream: public Print {
+public:
+	virtual int available(void) = 0;
+	virtual int read(void) = 0;
+	virtual int peek(void) = 0;
+
+	size_t readBytes(uint8_t* buffer, size_t length);
+};
+
+#endif
@@ -0,0 +1,65 @@
+// Arducom slave simulator
+// EEPROM emulation backed by a file
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass() {
+	this->data = NULL;
+	this->size = 0;
+	this->filename = NULL;
+}
+
+EEPROMClass::~EEPROMClass() {
+	free(this->data);
+	free(this->filename);
+}
+
+void EEPROMClass::begin(size_t size, const char* filename) {
+	free(this->data);
+	free(this->filename);
+	this->data = (uint8_t*)malloc(size);
+	this->size = size;
+	this->filename = (filename == NULL ? NULL : strdup(filename));
+	memset(this->data, 0xFF, size);
+
+	if (this->filename != NULL) {
+		// load existing content; a missing or short file leaves the rest erased
+		FILE* f = fopen(this->filename, "rb");
+		if (f != NULL) {
+			if (fread(this->data, 1, size, f) < size && ferror(f))
+				perror(this->filename);
+			fclose(f);
+		}
+	}
+}
+
+uint8_t EEPROMClass::read(int address) {
+	if ((address < 0) || ((size_t)address >= this->size))
+		return 0;
+	return this->data[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+	if ((address < 0) || ((size_t)address >= this->size))
+		return;
+	this->data[address] = value;
+}
+
+bool EEPROMClass::commit(void) {
+	if (this->filename == NULL)
+		return true;
+	FILE* f = fopen(this->filename, "wb");
+	if (f == NULL)
+		return false;
+	bool result = (fwrite(this->data, 1, this->size, f) == this->size);
+	if (fclose(f) != 0)
+		result = false;
+	return result;
+}
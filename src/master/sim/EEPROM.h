@@ -0,0 +1,40 @@
+// Arducom slave simulator
+// EEPROM emulation backed by a file
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+// The interface follows the ESP8266 EEPROM library (begin, read, write, commit)
+// which is what the Arducom EEPROM commands use on non-AVR platforms.
+// Unwritten memory reads as 0xFF like an erased EEPROM.
+
+#ifndef __ARDUCOM_SIM_EEPROM_H
+#define __ARDUCOM_SIM_EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass {
+public:
+	EEPROMClass();
+	~EEPROMClass();
+
+	/** Allocates size bytes of EEPROM memory. If a file name is given the content is
+	*   loaded from this file and written back to it on each commit. */
+	void begin(size_t size, const char* filename = NULL);
+
+	uint8_t read(int address);
+	void write(int address, uint8_t value);
+	bool commit(void);
+	size_t length(void) { return this->size; }
+
+protected:
+	uint8_t* data;
+	size_t size;
+	char* filename;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,292 @@
+// Arducom slave simulator
+// SD card emulation backed by a host directory
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+#include <ctype.h>
+#include <limits.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "SdFat.h"
+
+std::string SdFile::rootPath;
+SdFile* SdFile::cwd = NULL;
+
+// characters that are allowed in a FAT short name besides letters and digits
+static const char* sfnSpecialChars = "!#$%&'()-@^_`{}~";
+
+static bool isShortNameChar(char c) {
+	return isalnum((unsigned char)c) || ((c != '\0') && (strchr(sfnSpecialChars, c) != NULL));
+}
+
+/** Computes the 8.3 short name for the given host file name.
+*   Returns false if the name is not a valid short name and a generated one is used. */
+static bool makeShortName(const std::string& name, std::string& sfn) {
+	size_t dot = name.find_last_of('.');
+	std::string base = (dot == std::string::npos ? name : name.substr(0, dot));
+	std::string ext = (dot == std::string::npos ? "" : name.substr(dot + 1));
+
+	bool valid = (base.length() >= 1) && (base.length() <= 8) && (ext.length() <= 3);
+	for (size_t i = 0; valid && (i < base.length()); i++)
+		valid = isShortNameChar(base[i]);
+	for (size_t i = 0; valid && (i < ext.length()); i++)
+		valid = isShortNameChar(ext[i]);
+
+	std::string shortBase;
+	std::string shortExt;
+	for (size_t i = 0; (i < base.length()) && (shortBase.length() < (valid ? 8 : 6)); i++) {
+		if (isShortNameChar(base[i]))
+			shortBase += toupper((unsigned char)base[i]);
+		else if ((base[i] != ' ') && (base[i] != '.'))
+			shortBase += '_';
+	}
+	for (size_t i = 0; (i < ext.length()) && (shortExt.length() < 3); i++) {
+		if (isShortNameChar(ext[i]))
+			shortExt += toupper((unsigned char)ext[i]);
+		else if (ext[i] != ' ')
+			shortExt += '_';
+	}
+	if (!valid)
+		shortBase += "~1";
+	sfn = shortBase;
+	if (!shortExt.empty())
+		sfn += "." + shortExt;
+	return valid;
+}
+
+/** Looks up an entry in the host directory dirPath by its short or host name. */
+static bool findEntry(const std::string& dirPath, const std::string& name, std::string& hostPath, std::string& sfn, bool& isLongName) {
+	DIR* dir = opendir(dirPath.c_str());
+	if (dir == NULL)
+		return false;
+	bool found = false;
+	struct dirent* entry;
+	while (!found && ((entry = readdir(dir)) != NULL)) {
+		if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+			continue;
+		isLongName = !makeShortName(entry->d_name, sfn);
+		if ((strcasecmp(sfn.c_str(), name.c_str()) == 0) || (name == entry->d_name)) {
+			hostPath = dirPath + "/" + entry->d_name;
+			found = true;
+		}
+	}
+	closedir(dir);
+	return found;
+}
+
+SdFile::SdFile() {
+	this->opened = false;
+	this->directory = false;
+	this->longName = false;
+	this->file = NULL;
+	this->dir = NULL;
+}
+
+SdFile::~SdFile() {
+	this->close();
+}
+
+bool SdFile::openPath(const std::string& hostPath, const std::string& shortName, bool isLongName, uint8_t oflag) {
+	this->close();
+
+	struct stat st;
+	if (stat(hostPath.c_str(), &st) != 0)
+		return false;
+	if (S_ISDIR(st.st_mode)) {
+		// directories cannot be opened for writing
+		if ((oflag & O_WRITE) == O_WRITE)
+			return false;
+		this->dir = opendir(hostPath.c_str());
+		if (this->dir == NULL)
+			return false;
+		this->directory = true;
+	} else if (S_ISREG(st.st_mode)) {
+		this->file = fopen(hostPath.c_str(), ((oflag & O_WRITE) == O_WRITE ? "r+b" : "rb"));
+		if (this->file == NULL)
+			return false;
+		this->directory = false;
+	} else
+		return false;
+
+	this->path = hostPath;
+	this->sfn = shortName;
+	this->longName = isLongName;
+	this->opened = true;
+	return true;
+}
+
+bool SdFile::open(const char* path, uint8_t oflag) {
+	if (rootPath.empty() || (path == NULL))
+		return false;
+
+	// determine the starting directory before this file is closed (it may be the working directory)
+	std::string current = ((path[0] == '/') || (cwd == NULL) || !cwd->isOpen() ? rootPath : cwd->path);
+	std::string shortName = (current == rootPath ? "/" : (path[0] == '/' ? "/" : cwd->sfn));
+	bool isLongName = (current == rootPath ? false : cwd->longName);
+
+	// resolve the path component by component
+	std::string remaining = path;
+	while (!remaining.empty()) {
+		size_t slash = remaining.find('/');
+		std::string component = remaining.substr(0, slash);
+		remaining = (slash == std::string::npos ? "" : remaining.substr(slash + 1));
+		if (component.empty() || (component == "."))
+			continue;
+		if (component == "..") {
+			// cannot go above the root directory
+			if (current == rootPath)
+				return false;
+			current = current.substr(0, current.find_last_of('/'));
+			if (current == rootPath)
+				shortName = "/";
+			else
+				isLongName = !makeShortName(current.substr(current.find_last_of('/') + 1), shortName);
+			continue;
+		}
+		std::string hostPath;
+		if (!findEntry(current, component, hostPath, shortName, isLongName))
+			return false;
+		current = hostPath;
+	}
+	return this->openPath(current, shortName, isLongName, oflag);
+}
+
+bool SdFile::openNext(SdFile* dir, uint8_t oflag) {
+	if ((dir == NULL) || !dir->isDir())
+		return false;
+	struct dirent* entry;
+	while ((entry = readdir(dir->dir)) != NULL) {
+		if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+			continue;
+		std::string shortName;
+		bool isLongName = !makeShortName(entry->d_name, shortName);
+		// skip entries that are neither files nor directories
+		if (this->openPath(dir->path + "/" + entry->d_name, shortName, isLongName, oflag))
+			return true;
+	}
+	return false;
+}
+
+void SdFile::close(void) {
+	if (this->file != NULL)
+		fclose(this->file);
+	if (this->dir != NULL)
+		closedir(this->dir);
+	this->file = NULL;
+	this->dir = NULL;
+	this->opened = false;
+	this->directory = false;
+	this->longName = false;
+}
+
+bool SdFile::getSFN(char* name) {
+	if (!this->opened)
+		return false;
+	strcpy(name, this->sfn.c_str());
+	return true;
+}
+
+uint32_t SdFile::fileSize(void) {
+	struct stat st;
+	if ((this->file == NULL) || (fstat(fileno(this->file), &st) != 0))
+		return 0;
+	// FAT files are limited to 4 GB
+	return (st.st_size > UINT32_MAX ? UINT32_MAX : (uint32_t)st.st_size);
+}
+
+bool SdFile::dirEntry(dir_t* dir) {
+	struct stat st;
+	if (!this->opened || (stat(this->path.c_str(), &st) != 0))
+		return false;
+	memset(dir, 0, sizeof(dir_t));
+
+	// space padded 8.3 name without the dot
+	memset(dir->name, ' ', sizeof(dir->name));
+	size_t dot = this->sfn.find('.');
+	std::string base = this->sfn.substr(0, dot);
+	std::string ext = (dot == std::string::npos ? "" : this->sfn.substr(dot + 1));
+	memcpy(dir->name, base.c_str(), base.length() > 8 ? 8 : base.length());
+	memcpy(&dir->name[8], ext.c_str(), ext.length() > 3 ? 3 : ext.length());
+	dir->attributes = (this->directory ? 0x10 : 0x00);
+	dir->fileSize = this->fileSize();
+
+	// FAT timestamps; dates before 1980 cannot be represented
+	struct tm tm;
+	gmtime_r(&st.st_mtime, &tm);
+	if (tm.tm_year < 80) {
+		dir->lastWriteDate = (1 << 5) | 1;
+		dir->lastWriteTime = 0;
+	} else {
+		dir->lastWriteDate = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+		dir->lastWriteTime = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+	}
+	dir->creationDate = dir->lastWriteDate;
+	dir->creationTime = dir->lastWriteTime;
+	return true;
+}
+
+void SdFile::rewind(void) {
+	if (this->dir != NULL)
+		rewinddir(this->dir);
+	if (this->file != NULL)
+		fseek(this->file, 0, SEEK_SET);
+}
+
+bool SdFile::seekSet(uint32_t pos) {
+	if ((this->file == NULL) || (pos > this->fileSize()))
+		return false;
+	return fseek(this->file, pos, SEEK_SET) == 0;
+}
+
+int SdFile::read(void* buffer, size_t count) {
+	if (this->file == NULL)
+		return -1;
+	size_t result = fread(buffer, 1, count, this->file);
+	if (ferror(this->file))
+		return -1;
+	return (int)result;
+}
+
+bool SdFile::remove(void) {
+	if ((this->file == NULL) || this->directory)
+		return false;
+	std::string hostPath = this->path;
+	this->close();
+	return unlink(hostPath.c_str()) == 0;
+}
+
+bool SdFile::rmdir(void) {
+	if (!this->isDir())
+		return false;
+	std::string hostPath = this->path;
+	this->close();
+	// fails if the directory is not empty, like SdFat
+	return ::rmdir(hostPath.c_str()) == 0;
+}
+
+bool SdFat::begin(const char* rootDir) {
+	char resolved[PATH_MAX];
+	struct stat st;
+	if ((realpath(rootDir, resolved) == NULL) || (stat(resolved, &st) != 0) || !S_ISDIR(st.st_mode))
+		return false;
+	SdFile::rootPath = resolved;
+	SdFile::cwd = &this->workingDir;
+	return this->chdir();
+}
+
+bool SdFat::chdir(bool set_cwd) {
+	return this->chdir("/", set_cwd);
+}
+
+bool SdFat::chdir(const char* path, bool set_cwd) {
+	SdFile newDir;
+	if (!newDir.open(path, O_READ) || !newDir.isDir())
+		return false;
+	return this->workingDir.openPath(newDir.path, newDir.sfn, newDir.longName, O_READ);
+}
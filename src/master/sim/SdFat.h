@@ -0,0 +1,126 @@
+// Arducom slave simulator
+// SD card emulation backed by a host directory
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+// This header implements the subset of the SdFat library interface that is used
+// by ArducomFTP. The "card" is a directory on the host; the simulated volume
+// is always reported as a FAT32 formatted SDHC card.
+// Host file names that are not valid 8.3 names are presented with a generated
+// short name (e. g. LONGFI~1.TXT) and are reported as long file names.
+// Short name collisions are not resolved; only the first match can be opened.
+
+#ifndef __ARDUCOM_SIM_SDFAT_H
+#define __ARDUCOM_SIM_SDFAT_H
+
+#include <string>
+#include <stdio.h>
+#include <dirent.h>
+
+#include "Arduino.h"
+
+// open flags (values as in SdFat)
+#define O_READ					0x01
+#define O_WRITE					0x02
+
+// card types
+#define SD_CARD_TYPE_SD1		1
+#define SD_CARD_TYPE_SD2		2
+#define SD_CARD_TYPE_SDHC		3
+
+// size of the simulated card in 512 byte blocks (4 GB)
+#define ARDUCOM_SIM_CARD_BLOCKS	7744512
+
+// FAT directory entry; only the fields used by ArducomFTP are filled
+struct dir_t {
+	uint8_t name[11];
+	uint8_t attributes;
+	uint16_t creationTime;
+	uint16_t creationDate;
+	uint16_t lastWriteTime;
+	uint16_t lastWriteDate;
+	uint32_t fileSize;
+};
+
+class Sd2Card {
+public:
+	uint32_t cardSize(void) { return ARDUCOM_SIM_CARD_BLOCKS; }
+	uint8_t type(void) { return SD_CARD_TYPE_SDHC; }
+};
+
+class SdVolume {
+public:
+	uint8_t fatType(void) { return 32; }
+};
+
+/** A file or directory on the simulated card. */
+class SdFile {
+public:
+	SdFile();
+	~SdFile();
+
+	/** Opens the file or directory with the given name. Names are resolved relative to the
+	*   current working directory unless they start with a slash. Directories can only be
+	*   opened with O_READ. */
+	bool open(const char* path, uint8_t oflag = O_READ);
+	/** Opens the next entry of the directory dir. */
+	bool openNext(SdFile* dir, uint8_t oflag = O_READ);
+	void close(void);
+
+	bool isOpen(void) { return this->opened; }
+	bool isDir(void) { return this->opened && this->directory; }
+	bool isLFN(void) { return this->longName; }
+	bool getSFN(char* name);
+	uint32_t fileSize(void);
+	bool dirEntry(dir_t* dir);
+
+	void rewind(void);
+	bool seekSet(uint32_t pos);
+	int read(void* buffer, size_t count);
+
+	bool remove(void);
+	bool rmdir(void);
+
+protected:
+	friend class SdFat;
+
+	bool openPath(const std::string& hostPath, const std::string& shortName, bool isLongName, uint8_t oflag);
+
+	// the host path of the root and the current working directory
+	static std::string rootPath;
+	static SdFile* cwd;
+
+	bool opened;
+	bool directory;
+	bool longName;
+	std::string path;
+	std::string sfn;
+	FILE* file;
+	DIR* dir;
+};
+
+/** Emulates an SD card with a FAT volume. */
+class SdFat {
+public:
+	/** Uses the given host directory as the root of the card. */
+	bool begin(const char* rootDir);
+
+	Sd2Card* card(void) { return &this->sdCard; }
+	SdVolume* vol(void) { return &this->sdVolume; }
+	SdFile* vwd(void) { return &this->workingDir; }
+
+	/** Changes the working directory to the root directory. */
+	bool chdir(bool set_cwd = false);
+	/** Changes the working directory. Paths starting with a slash are absolute. */
+	bool chdir(const char* path, bool set_cwd = false);
+
+protected:
+	Sd2Card sdCard;
+	SdVolume sdVolume;
+	SdFile workingDir;
+};
+
+#endif
@@ -0,0 +1,4 @@
+// Arducom slave simulator
+// Stream is declared together with the other core classes in Arduino.h
+
+#include "Arduino.h"
@@ -0,0 +1,38 @@
+#! /bin/bash
+
+# Runs the slow command 21 of arducom-sim over a pseudo terminal, TCP loopback and UDP loopback,
+# with tagged and untagged commands, with and without the slave's time estimate, and with -l 0.
+# Build both tools first (make-sim.sh, make.sh). Prints the master's result for each run
+# (elapsed time in ms, resume calls) and exits with 1 if a run has failed.
+
+PTY_LINK=/tmp/arducom-slow-$$
+TCP_PORT=4155
+UDP_PORT=4156
+# duration of the slow command in ms (LSB first)
+DURATION=F401
+
+./arducom-sim -l $PTY_LINK > /dev/null &
+SERIAL_PID=$!
+./arducom-sim -t tcpip -p $TCP_PORT > /dev/null &
+TCP_PID=$!
+./arducom-sim -t udp -p $UDP_PORT > /dev/null &
+UDP_PID=$!
+trap "kill $SERIAL_PID $TCP_PID $UDP_PID 2> /dev/null" EXIT
+sleep 0.5
+
+FAILED=0
+for TRANSPORT in "-t serial -d $PTY_LINK --initDelay 0" "-t tcpip -d 127.0.0.1 -a $TCP_PORT" "-t udp -d 127.0.0.1 -a $UDP_PORT"; do
+	for TAGS in "" "--tags"; do
+		for DELAY in "" "-l 0"; do
+			for FLAG in 00 01; do
+				ARGS="$TRANSPORT $TAGS $DELAY -c 21 -p $DURATION$FLAG -o Int16"
+				RESULT=$(./arducom $ARGS 2>&1)
+				if [ $? -ne 0 ]; then
+					FAILED=1
+				fi
+				echo "$ARGS: $RESULT"
+			done
+		done
+	done
+done
+exit $FAILED
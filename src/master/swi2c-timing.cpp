@@ -0,0 +1,645 @@
+// swi2c-timing
+// Timing model for the SoftwareI2CSlave interrupt routine
+//
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+// Arduino communications library
+// Project page: https://github.com/leomeyer/Arducom
+// License: MIT License. For details see the project page.
+
+// This tool compiles the interrupt service routine of SoftwareI2CSlave.h on the
+// host and runs it against a simulated I2C master. Register accesses of the routine
+// are redirected to the model: each read of the input pins and each write to the
+// data direction register advances a cycle counter of a 16 MHz ATmega and lets the
+// master proceed to that point in time. Other interrupt sources (timer 0 overflow,
+// timer 2 compare, USART receive) raise their flags periodically and are serviced
+// whenever the global interrupt flag is set.
+//
+// The master repeats transactions like the SoftwareI2CSlave.ino example: it writes
+// a random block, waits, and reads the block back. A transaction fails if the slave
+// does not acknowledge or returns different data. The tool reports the error rate,
+// the longest time interrupts were disabled by the I2C routine, and the latency and
+// lost events of the other interrupt sources.
+//
+// This is not a cycle-accurate AVR simulation: the cost of an instruction sequence
+// is estimated per register access (see --read-cycles, --write-cycles, --entry-cycles).
+// Results are reproducible for a given --seed.
+//
+// The model is not calibrated against hardware. On a 16 MHz Uno the previous,
+// edge-triggered routine worked at 40 kHz and failed in about 5 percent of the
+// transfers at 50 kHz. In this model, with the default settings, it already fails
+// in about a quarter of the transfers at 40 kHz. Changing the entry cost or the
+// time at which the master changes SDA after the falling clock edge moves its
+// error rate anywhere between almost none and almost all transfers. Some settings
+// come close to both hardware results, but neighbouring settings do not, so they
+// cannot be trusted for other bus speeds. The error rates reported here therefore
+// do not show whether a bus speed works on hardware. The time that interrupts are
+// disabled depends much less on these settings.
+//
+// Build with make-swi2c-timing.sh. Add -DI2C_SLAVE_CLOCK_STRETCHING=1 to the compiler
+// flags to check the routine with clock stretching.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <exception>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CPU_MHZ					16
+#define TIMING_DEFAULT_COUNT	10000
+#define TIMING_DEFAULT_KHZ		100
+#define TIMING_DEFAULT_SEED		1
+
+/********************************************************************************/
+/* Simulated AVR environment                                                    */
+/********************************************************************************/
+
+// current time in CPU cycles
+static uint64_t now = 0;
+static std::mt19937 randomGenerator;
+
+// estimated cycles per access of the I2C routine (including the surrounding loop code)
+static uint32_t readCycles = 6;
+static uint32_t writeCycles = 2;
+// cycles from the interrupt flag to the first statement of a service routine, and back
+static uint32_t entryCycles = 40;
+static uint32_t exitCycles = 40;
+
+static bool interruptsEnabled = true;
+static bool inI2CRoutine = false;
+static uint64_t interruptsOffSince = 0;
+static uint64_t maxInterruptsOff = 0;
+static unsigned long reentries = 0;
+
+static void advance(uint64_t cycles);
+static void i2cRoutine(void);
+static void serviceOtherInterrupt(void);
+
+// pin change interrupt state
+static bool pinChangeFlag = false;
+static uint8_t pinChangeEnable = 0;
+
+static void interruptsOff(void) {
+	if (interruptsEnabled && inI2CRoutine)
+		interruptsOffSince = now;
+	interruptsEnabled = false;
+}
+
+static void interruptsOn(void) {
+	if (!interruptsEnabled && inI2CRoutine && (now - interruptsOffSince > maxInterruptsOff))
+		maxInterruptsOff = now - interruptsOffSince;
+	interruptsEnabled = true;
+}
+
+void cli(void) {
+	advance(1);
+	interruptsOff();
+}
+
+void sei(void) {
+	advance(1);
+	interruptsOn();
+	// the instruction after sei() is executed before a pending interrupt is serviced
+	advance(1);
+	if (!inI2CRoutine)
+		return;
+	// the I2C routine must not be entered again while it is active
+	if (pinChangeFlag && pinChangeEnable)
+		reentries++;
+	serviceOtherInterrupt();
+}
+
+uint32_t millis(void) {
+	return (uint32_t)(now / (CPU_MHZ * 1000));
+}
+
+struct SimSREG {
+	operator uint8_t() const {
+		return interruptsEnabled ? 0x80 : 0;
+	}
+	SimSREG& operator=(uint8_t value) {
+		if (value & 0x80)
+			interruptsOn();
+		else
+			interruptsOff();
+		return *this;
+	}
+};
+
+static SimSREG simSREG;
+
+// pin change interrupt control register
+struct SimPCICR {
+	operator uint8_t() const {
+		return pinChangeEnable;
+	}
+	SimPCICR& operator|=(unsigned long value) {
+		advance(writeCycles);
+		pinChangeEnable |= (uint8_t)value;
+		return *this;
+	}
+	SimPCICR& operator&=(unsigned long value) {
+		advance(writeCycles);
+		pinChangeEnable &= (uint8_t)value;
+		return *this;
+	}
+};
+
+static SimPCICR simPCICR;
+
+// pin change interrupt flag register; writing a one clears the flag
+struct SimPCIFR {
+	SimPCIFR& operator=(unsigned long value) {
+		advance(writeCycles);
+		if (value)
+			pinChangeFlag = false;
+		return *this;
+	}
+};
+
+static SimPCIFR simPCIFR;
+
+// bus lines: a line is high unless the master or the slave pulls it low
+static bool masterSCL = true;
+static bool masterSDA = true;
+static uint8_t slaveDDR = 0;
+static uint8_t busPins = 0x03;
+
+static void updateBus(void);
+
+// data direction register of the slave: a set bit pulls the line low
+struct SimDDR {
+	operator uint8_t() const {
+		return slaveDDR;
+	}
+	SimDDR& operator|=(unsigned long value) {
+		advance(writeCycles);
+		slaveDDR |= (uint8_t)value;
+		updateBus();
+		return *this;
+	}
+	SimDDR& operator&=(unsigned long value) {
+		advance(writeCycles);
+		slaveDDR &= (uint8_t)value;
+		updateBus();
+		return *this;
+	}
+};
+
+static SimDDR simDDR;
+
+static uint8_t readPins(void) {
+	advance(readCycles);
+	return busPins;
+}
+
+static uint8_t pinMaskRegister;
+
+/********************************************************************************/
+/* SoftwareI2CSlave configuration and code under test                           */
+/********************************************************************************/
+
+#define bit(b)					(1UL << (b))
+#define SREG					simSREG
+#define PCICR					simPCICR
+#define PCIFR					simPCIFR
+#define ISR(vector)				static void i2cRoutine(void)
+
+#define I2C_SLAVE_ADDRESS		0x77
+#define I2C_SLAVE_BUFSIZE		32
+#define I2C_SLAVE_READ_PINS		readPins()
+#define I2C_SLAVE_DDR_PINS		simDDR
+#define I2C_SLAVE_SCL_BIT		0
+#define I2C_SLAVE_SDA_BIT		1
+#define I2C_SLAVE_INTVECTOR		PCINT1_vect
+#define I2C_SLAVE_INTFLAG		1
+#define I2C_SLAVE_CLEARFLAG		1
+#define I2C_SLAVE_PINMASKREG	pinMaskRegister
+#ifndef I2C_SLAVE_CLOCK_STRETCHING
+#define I2C_SLAVE_CLOCK_STRETCHING	0
+#endif
+
+#include "../slave/lib/SoftwareI2CSlave/SoftwareI2CSlave.h"
+
+/********************************************************************************/
+/* Other interrupt sources                                                      */
+/********************************************************************************/
+
+struct InterruptSource {
+	std::string name;
+	uint64_t period;		// cycles between events; 0 disables the source
+	uint32_t cost;			// cycles of the service routine, including entry and exit
+	uint8_t depth;			// events the hardware can hold (flag or receive buffer)
+	uint64_t nextEvent;
+	std::vector<uint64_t> pending;
+	unsigned long events;
+	unsigned long lost;
+	uint64_t maxLatency;
+};
+
+static std::vector<InterruptSource> sources;
+
+static void updateSources(void) {
+	for (size_t s = 0; s < sources.size(); s++) {
+		InterruptSource& source = sources.at(s);
+		if (source.period == 0)
+			continue;
+		while (source.nextEvent <= now) {
+			source.events++;
+			if (source.pending.size() < source.depth)
+				source.pending.push_back(source.nextEvent);
+			else
+				source.lost++;
+			source.nextEvent += source.period;
+		}
+	}
+}
+
+// services the pending interrupt with the highest priority (the first in the list)
+static void serviceOtherInterrupt(void) {
+	for (size_t s = 0; s < sources.size(); s++) {
+		InterruptSource& source = sources.at(s);
+		if (source.pending.empty())
+			continue;
+		uint64_t latency = now - source.pending.front();
+		if (latency > source.maxLatency)
+			source.maxLatency = latency;
+		source.pending.erase(source.pending.begin());
+		bool enabled = interruptsEnabled;
+		interruptsEnabled = false;
+		advance(source.cost);
+		interruptsEnabled = enabled;
+		return;
+	}
+}
+
+static bool otherInterruptPending(void) {
+	for (size_t s = 0; s < sources.size(); s++)
+		if (!sources.at(s).pending.empty())
+			return true;
+	return false;
+}
+
+/********************************************************************************/
+/* Simulated master                                                             */
+/********************************************************************************/
+
+enum ActionType {
+	SET_SDA,
+	SCL_LOW,
+	SCL_RELEASE,		// waits while the slave holds SCL low
+	SAMPLE_DATA,
+	SAMPLE_ACK,
+	WAIT,
+	END
+};
+
+struct Action {
+	ActionType type;
+	uint8_t value;
+	uint32_t delay;		// cycles until the next action
+};
+
+static std::vector<Action> actions;
+static size_t actionIndex = 0;
+static uint64_t nextActionTime = 0;
+static bool masterBlocked = false;
+
+// transaction state
+static std::vector<uint8_t> written;
+static std::vector<uint8_t> readBack;
+static uint8_t readByte;
+static uint8_t readBits;
+static bool nacked;
+static bool transactionDone;
+
+static uint32_t halfPeriod;
+
+static void updateBus(void) {
+	bool scl = masterSCL && !(slaveDDR & I2C_SLAVE_SCL);
+	bool sda = masterSDA && !(slaveDDR & I2C_SLAVE_SDA);
+	uint8_t pins = (scl ? I2C_SLAVE_SCL : 0) | (sda ? I2C_SLAVE_SDA : 0);
+	if (pins != busPins)
+		pinChangeFlag = true;
+	busPins = pins;
+	// the slave has released SCL while the master waits for it
+	if (masterBlocked && scl) {
+		masterBlocked = false;
+		nextActionTime = now + actions.at(actionIndex).delay;
+		actionIndex++;
+	}
+}
+
+static void add(ActionType type, uint8_t value, uint32_t delay) {
+	Action action = { type, value, delay };
+	actions.push_back(action);
+}
+
+static void addStart(bool repeated) {
+	uint32_t quarter = halfPeriod / 2;
+	if (repeated) {
+		add(SET_SDA, 1, quarter);
+		add(SCL_RELEASE, 0, halfPeriod);
+	}
+	add(SET_SDA, 0, halfPeriod);
+	add(SCL_LOW, 0, quarter);
+}
+
+static void addWriteByte(uint8_t data) {
+	uint32_t quarter = halfPeriod / 2;
+	for (int i = 7; i >= 0; i--) {
+		add(SET_SDA, (data >> i) & 1, quarter);
+		add(SCL_RELEASE, 0, halfPeriod);
+		add(SCL_LOW, 0, quarter);
+	}
+	add(SET_SDA, 1, quarter);
+	add(SCL_RELEASE, 0, quarter);
+	add(SAMPLE_ACK, 0, quarter);
+	add(SCL_LOW, 0, quarter);
+}
+
+static void addReadByte(bool ack) {
+	uint32_t quarter = halfPeriod / 2;
+	for (int i = 0; i < 8; i++) {
+		add(SET_SDA, 1, quarter);
+		add(SCL_RELEASE, 0, quarter);
+		add(SAMPLE_DATA, 0, quarter);
+		add(SCL_LOW, 0, quarter);
+	}
+	add(SET_SDA, ack ? 0 : 1, quarter);
+	add(SCL_RELEASE, 0, halfPeriod);
+	add(SCL_LOW, 0, quarter);
+}
+
+static void addStop(void) {
+	uint32_t quarter = halfPeriod / 2;
+	add(SET_SDA, 0, quarter);
+	add(SCL_RELEASE, 0, quarter);
+	add(SET_SDA, 1, halfPeriod);
+}
+
+static void buildTransaction(uint32_t processingCycles, uint32_t gapCycles) {
+	actions.clear();
+	actionIndex = 0;
+	written.clear();
+	readBack.clear();
+	readBits = 0;
+	nacked = false;
+	transactionDone = false;
+
+	size_t length = 1 + randomGenerator() % I2C_SLAVE_BUFSIZE;
+	for (size_t i = 0; i < length; i++)
+		written.push_back((uint8_t)randomGenerator());
+
+	add(WAIT, 0, gapCycles);
+	// write the block
+	addStart(false);
+	addWriteByte(I2C_SLAVE_ADDRESS << 1);
+	for (size_t i = 0; i < length; i++)
+		addWriteByte(written.at(i));
+	addStop();
+	// give the main loop time to supply the reply
+	add(WAIT, 0, processingCycles);
+	// read it back
+	addStart(false);
+	addWriteByte((I2C_SLAVE_ADDRESS << 1) | 1);
+	for (size_t i = 0; i < length; i++)
+		addReadByte(i < length - 1);
+	addStop();
+	add(END, 0, 0);
+}
+
+static void runMaster(void) {
+	while (!masterBlocked && !transactionDone && (actionIndex < actions.size()) && (nextActionTime <= now)) {
+		const Action& action = actions.at(actionIndex);
+		switch (action.type) {
+		case SET_SDA:
+			masterSDA = (action.value != 0);
+			updateBus();
+			break;
+		case SCL_LOW:
+			masterSCL = false;
+			updateBus();
+			break;
+		case SCL_RELEASE:
+			masterSCL = true;
+			updateBus();
+			// clock stretching?
+			if (!(busPins & I2C_SLAVE_SCL)) {
+				masterBlocked = true;
+				return;
+			}
+			break;
+		case SAMPLE_DATA:
+			readByte = (readByte << 1) | ((busPins & I2C_SLAVE_SDA) ? 1 : 0);
+			if (++readBits == 8) {
+				readBack.push_back(readByte);
+				readBits = 0;
+			}
+			break;
+		case SAMPLE_ACK:
+			if (busPins & I2C_SLAVE_SDA)
+				nacked = true;
+			break;
+		case WAIT:
+			break;
+		case END:
+			transactionDone = true;
+			break;
+		}
+		nextActionTime += action.delay;
+		actionIndex++;
+	}
+}
+
+static void advance(uint64_t cycles) {
+	now += cycles;
+	runMaster();
+	updateSources();
+}
+
+/********************************************************************************/
+/* Slave application (SoftwareI2CSlave.ino)                                     */
+/********************************************************************************/
+
+static volatile int16_t receivedLength = 0;
+
+static void I2CReceive(uint8_t length) {
+	receivedLength = length;
+}
+
+static void mainLoop(void) {
+	advance(10);
+	if (receivedLength > 0) {
+		uint8_t length = (uint8_t)receivedLength;
+		receivedLength = 0;
+		i2c_slave_send(i2c_slave_buffer, length);
+	}
+}
+
+static void enterI2CRoutine(void) {
+	pinChangeFlag = false;
+	// finish the current instruction, then the prologue of the routine
+	advance(randomGenerator() % 4 + entryCycles);
+	inI2CRoutine = true;
+	interruptsOff();
+	i2cRoutine();
+	advance(exitCycles);
+	interruptsOn();
+	inI2CRoutine = false;
+}
+
+/********************************************************************************/
+/* Main                                                                         */
+/********************************************************************************/
+
+static void printUsage(void) {
+	std::cout << "swi2c-timing: Timing model for the SoftwareI2CSlave interrupt routine" << std::endl;
+	std::cout << std::endl;
+	std::cout << "Usage: swi2c-timing [options]" << std::endl;
+	std::cout << "  --count <n>: Number of write/read transactions (default: " << TIMING_DEFAULT_COUNT << ")" << std::endl;
+	std::cout << "  --khz <n>: Bus speed of the master in kHz (default: " << TIMING_DEFAULT_KHZ << ")" << std::endl;
+	std::cout << "  --seed <n>: Seed for the random generator (default: " << TIMING_DEFAULT_SEED << ")" << std::endl;
+	std::cout << "  --read-cycles <n>: Cycles per pin read of the I2C routine (default: 6)" << std::endl;
+	std::cout << "  --write-cycles <n>: Cycles per register write of the I2C routine (default: 2)" << std::endl;
+	std::cout << "  --entry-cycles <n>: Cycles to enter or leave the I2C routine (default: 40)" << std::endl;
+	std::cout << "  --timer0 <us>,<cost>: Period and service time of timer 0 in microseconds (default: 1024,5)" << std::endl;
+	std::cout << "  --timer2 <us>,<cost>: Period and service time of timer 2 in microseconds (default: 1000,4)" << std::endl;
+	std::cout << "  --serial <baud>,<cost>: Baud rate and service time of the USART receiver (default: 9600,4)" << std::endl;
+	std::cout << "  A period or baud rate of 0 disables the source." << std::endl;
+}
+
+static void parsePair(const std::string& value, uint64_t& first, uint64_t& second) {
+	size_t comma = value.find(',');
+	if (comma == std::string::npos)
+		throw std::invalid_argument("Expected two comma separated values: " + value);
+	first = std::stoull(value.substr(0, comma));
+	second = std::stoull(value.substr(comma + 1));
+}
+
+static void addSource(const std::string& name, uint64_t period, uint64_t cost, uint8_t depth) {
+	InterruptSource source;
+	source.name = name;
+	source.period = period;
+	source.cost = (uint32_t)cost;
+	source.depth = depth;
+	source.nextEvent = (period > 0 ? randomGenerator() % period : 0);
+	source.events = 0;
+	source.lost = 0;
+	source.maxLatency = 0;
+	sources.push_back(source);
+}
+
+int main(int argc, char* argv[]) {
+	unsigned long count = TIMING_DEFAULT_COUNT;
+	uint64_t khz = TIMING_DEFAULT_KHZ;
+	unsigned long seed = TIMING_DEFAULT_SEED;
+	uint64_t timer0Period = 1024, timer0Cost = 5;
+	uint64_t timer2Period = 1000, timer2Cost = 4;
+	uint64_t baudRate = 9600, serialCost = 4;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if ((arg == "-?") || (arg == "--help")) {
+				printUsage();
+				return 0;
+			}
+			if (i + 1 >= argc)
+				throw std::invalid_argument("Missing value for " + arg);
+			std::string value = argv[++i];
+			if (arg == "--count")
+				count = std::stoul(value);
+			else
+			if (arg == "--khz")
+				khz = std::stoull(value);
+			else
+			if (arg == "--seed")
+				seed = std::stoul(value);
+			else
+			if (arg == "--read-cycles")
+				readCycles = std::stoul(value);
+			else
+			if (arg == "--write-cycles")
+				writeCycles = std::stoul(value);
+			else
+			if (arg == "--entry-cycles")
+				entryCycles = exitCycles = std::stoul(value);
+			else
+			if (arg == "--timer0")
+				parsePair(value, timer0Period, timer0Cost);
+			else
+			if (arg == "--timer2")
+				parsePair(value, timer2Period, timer2Cost);
+			else
+			if (arg == "--serial")
+				parsePair(value, baudRate, serialCost);
+			else
+				throw std::invalid_argument("Unknown argument: " + arg);
+		}
+		if ((khz == 0) || (khz > 400))
+			throw std::invalid_argument("Bus speed must be between 1 and 400 kHz");
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	randomGenerator.seed(seed);
+	halfPeriod = (uint32_t)(CPU_MHZ * 1000 / khz / 2);
+
+	// sources in the order of their interrupt priority on the ATmega328
+	addSource("timer 2", timer2Period * CPU_MHZ, timer2Cost * CPU_MHZ, 1);
+	addSource("timer 0", timer0Period * CPU_MHZ, timer0Cost * CPU_MHZ, 1);
+	// the receiver holds two characters; the third one overruns
+	addSource("serial", (baudRate > 0 ? CPU_MHZ * 1000000ULL * 10 / baudRate : 0), serialCost * CPU_MHZ, 2);
+
+	i2c_slave_init(&I2CReceive);
+
+	unsigned long failures = 0;
+	unsigned long done = 0;
+	buildTransaction(CPU_MHZ * 200, CPU_MHZ * 100);
+	nextActionTime = now;
+	while (done < count) {
+		if (transactionDone) {
+			bool ok = !nacked && (readBack == written);
+			if (!ok)
+				failures++;
+			done++;
+			// after a failure, give the slave time to recover from a timeout
+			buildTransaction(CPU_MHZ * 200, ok ? CPU_MHZ * 100 : CPU_MHZ * 10000);
+			nextActionTime = now;
+			continue;
+		}
+		if (pinChangeFlag && pinChangeEnable) {
+			enterI2CRoutine();
+			continue;
+		}
+		if (otherInterruptPending()) {
+			serviceOtherInterrupt();
+			continue;
+		}
+		mainLoop();
+	}
+
+	double seconds = (double)now / (CPU_MHZ * 1000000.0);
+	std::cout << "Bus speed: " << khz << " kHz, clock stretching: " << (I2C_SLAVE_CLOCK_STRETCHING == 1 ? "on" : "off") << std::endl;
+	std::cout << "Transactions: " << count << ", failed: " << failures << ", error rate: "
+		<< std::fixed << std::setprecision(3) << (100.0 * failures / count) << " %" << std::endl;
+	std::cout << "Simulated time: " << std::setprecision(1) << seconds << " s" << std::endl;
+	std::cout << "Longest time with interrupts disabled by the I2C routine: " << (maxInterruptsOff / CPU_MHZ) << " us" << std::endl;
+	std::cout << "Pin change interrupts pending between bytes: " << reentries << std::endl;
+	for (size_t s = 0; s < sources.size(); s++) {
+		const InterruptSource& source = sources.at(s);
+		if (source.period == 0)
+			continue;
+		std::cout << std::left << std::setw(8) << source.name << std::right << ": " << source.events << " events, "
+			<< source.lost << " lost, maximum latency " << (source.maxLatency / CPU_MHZ) << " us" << std::endl;
+	}
+
+	return (failures > 0 ? 2 : 0);
+}
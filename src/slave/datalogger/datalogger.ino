@@ -435,6 +435,10 @@ raw_upload_hex:
 // For PIND, use PCMSK2
 #define I2C_SLAVE_PINMASKREG  PCMSK1
 
+// Hold SCL low until the reply is ready (clock stretching). Use with arducom --clock-stretching;
+// the master must support clock stretching.
+// #define I2C_SLAVE_CLOCK_STRETCHING	1
+
 #include <SoftwareI2CSlave.h>
 	
 #endif	// SOFTWARE_I2C
@@ -916,7 +920,7 @@ ArducomTransportStream arducomTransport(&SERIAL_STREAM);
 #elif defined I2C_SLAVE_ADDRESS
 	// I2C may be either software or hardware
 	#ifdef SOFTWARE_I2C
-	ArducomSoftwareI2C arducomTransport(&i2c_slave_init, &i2c_slave_send, &i2c_slave_buffer[0]);
+	ArducomSoftwareI2C arducomTransport(&i2c_slave_init, &i2c_slave_send, &i2c_slave_buffer[0], &i2c_slave_check_timeout, &i2c_slave_tx_pending);
 	#else
 	ArducomHardwareI2C arducomTransport(I2C_SLAVE_ADDRESS);
 	#endif
@@ -5,6 +5,9 @@
 // The ESP8266 is connected to the Arduino in this or a similar fashion:
 // http://www.teomaragakis.com/hardware/electronics/how-to-connect-an-esp8266-to-an-arduino-uno/
 // Software serial can be used on the Arduino so that hardware serial is still available for debugging.
+// Commands from several WiFi clients are queued by the proxy and forwarded one at a time.
+// The serial connection starts with 9600 baud; the proxy then switches to SERIAL_BAUDRATE
+// if the Arduino sketch supports the baud rate command (see ArducomSetBaudrate).
 
 // This example code is in the public domain.
 
@@ -38,17 +41,39 @@ WiFiAddresses myAddresses {
 
 #define HOSTNAME "ESP8266Proxy"
 
+#define SERIAL_INITIAL_BAUDRATE	9600
+#define SERIAL_BAUDRATE			ARDUCOM_DEFAULT_BAUDRATE
+
 // set up the transport mechanism
 ESP8266WifiTransport wifiTransport(myNetworks, &myAddresses, HOSTNAME);
 
 // set up the proxy transport that transfers data from the ESP8266 to the Serial stream
 ArducomTransportProxy proxyTransport(&wifiTransport, &Serial);
 
+// Read-only commands whose replies the proxy may answer from its cache
+// (command code, time to live in milliseconds). Forwarding any other command clears the cache.
+ArducomProxyCacheRule cacheRules[] = {
+//  { 19, 1000 },   // hello-world: read test block
+    { 0, 0 }  // mandatory
+};
+
+// Commands that reply with a run of frames; the proxy relays all frames to the master
+// (FTP commands ListDir and ReadBlocks with the default command base 60)
+const uint8_t runCommands[] = { 60 + 9, 60 + 8 };
+
 // initialize Arducom with the proxy transport
 Arducom arducom(&proxyTransport);
 
+void setSerialBaudrate(uint32_t baudrate) {
+  Serial.flush();
+  Serial.begin(baudrate);
+}
+
 void setup() {
-  Serial.begin(9600);
+  Serial.begin(SERIAL_INITIAL_BAUDRATE);
+  proxyTransport.setBaudrate(&setSerialBaudrate, SERIAL_INITIAL_BAUDRATE, SERIAL_BAUDRATE);
+  proxyTransport.setCacheRules(cacheRules);
+  proxyTransport.setRunCommands(runCommands, sizeof(runCommands));
 }
 
 void loop() {
@@ -46,8 +46,11 @@
 // 3. Hardware I2C: Define I2C_SLAVE_ADDRESS.
 // 4. Software I2C: Define I2C_SLAVE_ADDRESS and SOFTWARE_I2C.
 // 5. Ethernet: Define ETHERNET_PORT. An Ethernet shield is required.
+// Serial, I2C and Ethernet may also be combined; the transports share the commands.
 
 // 1. Hardware Serial
+// For high baud rates or long running main loops consider the interrupt driven
+// ArducomTransportUART instead (see ../lib/Arducom/ArducomUART.h).
 // #define SERIAL_STREAM		  Serial
 // #define SERIAL_BAUDRATE		ARDUCOM_DEFAULT_BAUDRATE
 
@@ -121,6 +124,10 @@
 // For PIND, use PCMSK2
 #define I2C_SLAVE_PINMASKREG  PCMSK1
 
+// Hold SCL low until the reply is ready (clock stretching). Use with arducom --clock-stretching;
+// the master must support clock stretching.
+// #define I2C_SLAVE_CLOCK_STRETCHING	1
+
 #include "SoftwareI2CSlave.h"
 
 #endif	// SOFTWARE_I2C
@@ -179,19 +186,6 @@
  #define USE_ARDUCOM_DEBUG
 #endif
 
-// validate setup
-#if defined ETHERNET_PORT && defined SERIAL_STREAM
-#error You cannot use Ethernet and serial communication at the same time.
-#endif
-
-#if defined ETHERNET_PORT && defined I2C_SLAVE_ADDRESS
-#error You cannot use Ethernet and I2C communication at the same time.
-#endif
-
-#if defined SERIAL_STREAM && defined I2C_SLAVE_ADDRESS
-#error You cannot use serial and I2C communication at the same time.
-#endif
-
 /*******************************************************
 * RTC access command implementation (for getting and
 * setting of RTC time)
@@ -245,29 +239,40 @@ public:
 
 #ifdef SERIAL_STREAM
 	// plain serial connection
-	ArducomTransportStream arducomTransport(&SERIAL_STREAM);
-#elif defined I2C_SLAVE_ADDRESS
+	ArducomTransportStream serialTransport(&SERIAL_STREAM);
+#endif
+#ifdef I2C_SLAVE_ADDRESS
 	// I2C may be either software or hardware
 	#ifdef SOFTWARE_I2C
-	ArducomSoftwareI2C arducomTransport(&i2c_slave_init, &i2c_slave_send, &i2c_slave_buffer[0]);
+	ArducomSoftwareI2C i2cTransport(&i2c_slave_init, &i2c_slave_send, &i2c_slave_buffer[0], &i2c_slave_check_timeout, &i2c_slave_tx_pending);
 	#else
-	ArducomHardwareI2C arducomTransport(I2C_SLAVE_ADDRESS);
+	ArducomHardwareI2C i2cTransport(I2C_SLAVE_ADDRESS);
 	#endif
-#elif defined ETHERNET_PORT
+#endif
+#ifdef ETHERNET_PORT
 	// Ethernet settings
 	byte eth_mac[] = {ETHERNET_MAC};
 	IPAddress eth_ip(ETHERNET_IP);
-	ArducomTransportEthernet arducomTransport(ETHERNET_PORT);
+	ArducomTransportEthernet ethernetTransport(ETHERNET_PORT);
 
 	// command to initialize LAN
 	// To use different network settings see the Ethernet library documentation:
 	// https://www.arduino.cc/en/Reference/Ethernet
 	#define INITIALIZE_ETHERNET() 		Ethernet.begin(eth_mac, eth_ip)
+#endif
+
+// the first transport is passed to Arducom, the others are added in setup()
+#ifdef SERIAL_STREAM
+	#define ARDUCOM_TRANSPORT	serialTransport
+#elif defined I2C_SLAVE_ADDRESS
+	#define ARDUCOM_TRANSPORT	i2cTransport
+#elif defined ETHERNET_PORT
+	#define ARDUCOM_TRANSPORT	ethernetTransport
 #else
 #error You have to define a transport method (SERIAL_STREAM, I2C_SLAVE_ADDRESS or ETHERNET_PORT).
 #endif
 
-Arducom arducom(&arducomTransport
+Arducom arducom(&ARDUCOM_TRANSPORT
 #if defined DEBUG_OUTPUT && defined USE_ARDUCOM_DEBUG
 , &DEBUG_OUTPUT
 #endif
@@ -303,6 +308,14 @@ void dateTime(uint16_t* date, uint16_t* time) {
 }
 #endif
 
+#ifdef SERIAL_STREAM
+// called by the baud rate command (e. g. from the ESP8266Proxy)
+void setSerialBaudrate(uint32_t baudrate) {
+	SERIAL_STREAM.flush();
+	SERIAL_STREAM.begin(baudrate);
+}
+#endif
+
 /*******************************************************
 * Setup
 *******************************************************/
@@ -329,9 +342,21 @@ void setup()
 		INITIALIZE_ETHERNET();
 #endif
 
+#if defined I2C_SLAVE_ADDRESS && defined SERIAL_STREAM
+	arducom.addTransport(&i2cTransport);
+#endif
+#if defined ETHERNET_PORT && (defined SERIAL_STREAM || defined I2C_SLAVE_ADDRESS)
+	arducom.addTransport(&ethernetTransport);
+#endif
+
 	// reserved version command (it's recommended to leave this in
 	// except if you really have to save flash/RAM)
 	arducom.addCommand(new ArducomVersionCommand("HelloWorld"));
+
+#ifdef SERIAL_STREAM
+	// allows the ESP8266Proxy to switch to a higher baud rate
+	arducom.addCommand(new ArducomSetBaudrate(&setSerialBaudrate));
+#endif
 /*
 	// EEPROM access commands
 	arducom.addCommand(new ArducomReadEEPROMBlock(9));
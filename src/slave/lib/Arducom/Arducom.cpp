@@ -27,7 +27,7 @@
 
 #include <Arduino.h>
 
-#if defined(ESP8266)
+#if defined(ESP8266) || defined(ARDUCOM_SIM)
 #include <EEPROM.h>
 #endif
 
@@ -71,6 +71,34 @@ int8_t ArducomTransport::hasData(void) {
 	return this->size;
 }
 
+void ArducomTransport::queueSend(uint8_t* buffer, uint8_t count) {
+	// replies are usually composed in place
+	if (buffer != this->data)
+		memcpy(this->data, buffer, count);
+	this->size = count;
+	this->sendPos = 0;
+	this->status = SENDING;
+}
+
+void ArducomTransport::writeQueued(Print* output) {
+	uint8_t count = this->size - this->sendPos;
+	int available = output->availableForWrite();
+	if (available > 0)
+		this->reportsCapacity = true;
+	else
+	// zero also means that the output does not support this function; write everything then
+	if (!this->reportsCapacity)
+		available = count;
+	if (count > available)
+		count = available;
+	if (count > 0)
+		this->sendPos += output->write((const uint8_t *)&this->data[this->sendPos], count);
+	if (this->sendPos >= this->size) {
+		this->status = SENT;
+		this->size = 0;
+	}
+}
+
 /******************************************************************************************	
 * Arducom stream transport class implementation
 ******************************************************************************************/
@@ -80,7 +108,7 @@ ArducomTransportStream::ArducomTransportStream(Stream* stream): ArducomTransport
 }
 
 int8_t ArducomTransportStream::send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
-	#ifdef ARDUCOM_DEBUG_SUPPORT
+	#if ARDUCOM_DEBUG_SUPPORT == 1
 	if (arducom->debug) {
 		arducom->debug->print(F("Send: "));
 		for (uint8_t i = 0; i < count; i++) {
@@ -90,20 +118,25 @@ int8_t ArducomTransportStream::send(Arducom* arducom, uint8_t* buffer, uint8_t c
 		arducom->debug->println();
 	}
 	#endif
-	this->stream->write((const uint8_t *)buffer, count);
-	this->stream->flush();
-	this->status = SENT;
-	this->size = 0;
+	// transmit as much as possible now; the rest is sent by doWork()
+	this->queueSend(buffer, count);
+	this->writeQueued(this->stream);
 	return ARDUCOM_OK;
 }
 
 int8_t ArducomTransportStream::doWork(Arducom* arducom) {
+	if (this->status == SENDING) {
+		this->writeQueued(this->stream);
+		// do not accept new data before the reply has been sent
+		if (this->status == SENDING)
+			return ARDUCOM_OK;
+	}
 	if (this->status != HAS_DATA)
 		this->size = 0;
 	// read incoming data
 	while (stream->available()) {
 		this->data[this->size] = stream->read();
-		#ifdef ARDUCOM_DEBUG_SUPPORT
+		#if ARDUCOM_DEBUG_SUPPORT == 1
 		if (arducom->debug) {
 			arducom->debug->print(F("Recv: "));
 			arducom->debug->print(this->data[this->size], HEX);
@@ -128,61 +161,340 @@ int8_t ArducomTransportStream::doWork(Arducom* arducom) {
 ArducomTransportProxy::ArducomTransportProxy(ArducomTransport* transport, Stream* stream): ArducomTransport() {
 	this->transport = transport;
 	this->stream = stream;
+	this->queueStart = 0;
+	this->queueCount = 0;
+	this->awaitingReply = false;
+	this->sendTime = 0;
+	this->switchTime = 0;
+	this->timeoutMs = ARDUCOM_DEFAULT_TIMEOUT_MS;
+	this->timeouts = 0;
+	this->baudrateState = BAUDRATE_FIXED;
+	this->baudrateFunc = NULL;
+	this->initialBaudrate = 0;
+	this->baudrate = 0;
+	this->currentBaudrate = 0;
+	this->baudrateCommand = ARDUCOM_BAUDRATE_COMMAND;
+	this->runCommands = NULL;
+	this->runCommandCount = 0;
+	#if ARDUCOM_PROXY_CACHE_SIZE > 0
+	this->cacheRules = NULL;
+	this->clearCache();
+	#endif
+}
+
+void ArducomTransportProxy::setTimeout(uint32_t timeoutMs) {
+	this->timeoutMs = timeoutMs;
+}
+
+void ArducomTransportProxy::setBaudrate(ArducomBaudrateFunc setBaudrate, uint32_t initialBaudrate, uint32_t baudrate, uint8_t commandCode) {
+	this->baudrateFunc = setBaudrate;
+	this->initialBaudrate = initialBaudrate;
+	this->baudrate = baudrate;
+	this->currentBaudrate = initialBaudrate;
+	this->baudrateCommand = commandCode;
+	this->baudrateState = (baudrate != initialBaudrate ? BAUDRATE_PENDING : BAUDRATE_FIXED);
+}
+
+void ArducomTransportProxy::setRunCommands(const uint8_t* commandCodes, uint8_t count) {
+	this->runCommands = commandCodes;
+	this->runCommandCount = count;
+}
+
+bool ArducomTransportProxy::isRunCommand(uint8_t commandCode) {
+	for (uint8_t i = 0; i < this->runCommandCount; i++)
+		if (this->runCommands[i] == commandCode)
+			return true;
+	return false;
+}
+
+#if ARDUCOM_PROXY_CACHE_SIZE > 0
+void ArducomTransportProxy::setCacheRules(const ArducomProxyCacheRule* rules) {
+	this->cacheRules = rules;
+	this->clearCache();
+}
+
+void ArducomTransportProxy::clearCache(void) {
+	for (uint8_t i = 0; i < ARDUCOM_PROXY_CACHE_SIZE; i++)
+		this->cache[i].replySize = 0;
+}
+
+uint16_t ArducomTransportProxy::getCacheTTL(uint8_t commandCode) {
+	if (this->cacheRules == NULL)
+		return 0;
+	for (const ArducomProxyCacheRule* rule = this->cacheRules; rule->ttlMs > 0; rule++)
+		if (rule->commandCode == commandCode)
+			return rule->ttlMs;
+	return 0;
 }
 
+bool ArducomTransportProxy::replyFromCache(Arducom* arducom, int16_t sender, uint8_t* request, uint8_t size) {
+	uint8_t code = request[1];
+	uint8_t headerSize = ARDUCOM_HEADER_SIZE(code);
+	uint8_t payloadSize = code & ARDUCOM_LENGTH_MASK;
+	bool tagged = (code & ARDUCOM_TAG_FLAG) == ARDUCOM_TAG_FLAG;
+	// a command with a wrong checksum is left to the device
+	if ((code & ARDUCOM_CHECKSUM_FLAG)
+		&& (calculateChecksum(request[0], code, &request[headerSize - (tagged ? 1 : 0)], payloadSize + (tagged ? 1 : 0)) != request[2]))
+		return false;
+	for (uint8_t i = 0; i < ARDUCOM_PROXY_CACHE_SIZE; i++) {
+		CacheEntry& entry = this->cache[i];
+		if ((entry.replySize == 0) || (entry.requestSize != payloadSize + 1) || (entry.request[0] != request[0])
+			|| (memcmp(&entry.request[1], &request[headerSize], payloadSize) != 0))
+			continue;
+		if (millis() - entry.time >= entry.ttlMs) {
+			entry.replySize = 0;
+			return false;
+		}
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug)
+			arducom->debug->println(F("Proxy: cached reply"));
+		#endif
+		// compose the reply with tag and checksum of this command
+		uint8_t reply[ARDUCOM_BUFFERSIZE];
+		memcpy(&reply[headerSize], entry.reply, entry.replySize);
+		uint8_t tag = (tagged ? request[headerSize - 1] : 0);
+		uint8_t replySize = arducom->composeReply(reply, request[0], code, tag, ARDUCOM_OK, 0, entry.replySize);
+		this->transport->sendTo(arducom, sender, reply, replySize);
+		return true;
+	}
+	return false;
+}
+
+void ArducomTransportProxy::cacheReply(uint8_t* request, uint8_t* reply, uint8_t replySize) {
+	uint16_t ttl = this->getCacheTTL(request[0]);
+	// error replies are not cached
+	if ((ttl == 0) || (reply[0] == ARDUCOM_ERROR_CODE))
+		return;
+	uint8_t payloadSize = request[1] & ARDUCOM_LENGTH_MASK;
+	uint8_t replyHeaderSize = ARDUCOM_HEADER_SIZE(reply[1]);
+	// the header is composed again for each command; the payload must fit behind any header
+	if (replySize - replyHeaderSize > ARDUCOM_BUFFERSIZE - ARDUCOM_HEADER_SIZE(ARDUCOM_CHECKSUM_FLAG | ARDUCOM_TAG_FLAG))
+		return;
+	// replace an entry for the same request, an empty or expired entry, or the oldest entry
+	uint8_t index = 0;
+	uint32_t maxAge = 0;
+	for (uint8_t i = 0; i < ARDUCOM_PROXY_CACHE_SIZE; i++) {
+		CacheEntry& entry = this->cache[i];
+		if ((entry.replySize > 0) && (entry.requestSize == payloadSize + 1) && (entry.request[0] == request[0])
+			&& (memcmp(&entry.request[1], &request[ARDUCOM_HEADER_SIZE(request[1])], payloadSize) == 0)) {
+			index = i;
+			break;
+		}
+		uint32_t age = millis() - entry.time;
+		// empty and expired entries are used first
+		if ((entry.replySize == 0) || (age >= entry.ttlMs))
+			age = 0xFFFFFFFF;
+		if (age >= maxAge) {
+			index = i;
+			maxAge = age;
+		}
+	}
+	CacheEntry& entry = this->cache[index];
+	entry.time = millis();
+	entry.ttlMs = ttl;
+	entry.request[0] = request[0];
+	memcpy(&entry.request[1], &request[ARDUCOM_HEADER_SIZE(request[1])], payloadSize);
+	entry.requestSize = payloadSize + 1;
+	memcpy(entry.reply, &reply[replyHeaderSize], replySize - replyHeaderSize);
+	entry.replySize = replySize - replyHeaderSize;
+}
+#endif
+
 int8_t ArducomTransportProxy::send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
 	// if this method is ever called by the master it is an error
 	// because the master should never see the data passing through this proxy
 	return ARDUCOM_TRANSPORT_ERROR;
 }
 
+void ArducomTransportProxy::switchBaudrate(uint32_t baudrate) {
+	this->baudrateFunc(baudrate);
+	this->currentBaudrate = baudrate;
+	// give the downstream device time to switch, too
+	this->switchTime = millis();
+}
+
+void ArducomTransportProxy::sendError(Arducom* arducom, int16_t sender, uint8_t code, uint8_t tag, uint8_t error) {
+	uint8_t reply[4];
+	reply[0] = ARDUCOM_ERROR_CODE;
+	reply[1] = error;
+	reply[2] = 0;
+	// tagged commands receive the tag as fourth byte
+	reply[3] = tag;
+	this->transport->sendTo(arducom, sender, reply, ((code & ARDUCOM_TAG_FLAG) ? 4 : 3));
+}
+
+void ArducomTransportProxy::sendNext(Arducom* arducom) {
+	// discard stray data (for example, a reply that arrived too late)
+	while (this->stream->available())
+		this->stream->read();
+	this->size = 0;
+	if (this->baudrateState == BAUDRATE_PENDING) {
+		// request the new baud rate, LSB first
+		uint8_t command[6];
+		command[0] = this->baudrateCommand;
+		command[1] = 4;
+		memcpy(&command[2], &this->baudrate, 4);
+		this->stream->write((const uint8_t *)command, 6);
+		this->baudrateState = BAUDRATE_NEGOTIATING;
+	} else {
+		Request& request = this->queue[this->queueStart];
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug) {
+			arducom->debug->print(F("Proxy send: "));
+			for (uint8_t i = 0; i < request.size; i++) {
+				arducom->debug->print(request.data[i], HEX);
+				arducom->debug->print(F(" "));
+			}
+			arducom->debug->println();
+		}
+		#endif
+		this->stream->write((const uint8_t *)request.data, request.size);
+		#if ARDUCOM_PROXY_CACHE_SIZE > 0
+		// the command may change the state of the device
+		if (this->getCacheTTL(request.data[0]) == 0)
+			this->clearCache();
+		#endif
+	}
+	this->awaitingReply = true;
+	this->sendTime = millis();
+}
+
+void ArducomTransportProxy::takeOver(Arducom* arducom) {
+	uint8_t request[ARDUCOM_BUFFERSIZE];
+	uint8_t size = this->transport->size;
+	memcpy(request, this->transport->data, size);
+	// the transport may continue with the next command
+	int16_t sender = this->transport->detach();
+	this->transport->status = NO_DATA;
+	#if ARDUCOM_PROXY_CACHE_SIZE > 0
+	if (this->replyFromCache(arducom, sender, request, size))
+		return;
+	#endif
+	if (this->queueCount >= ARDUCOM_PROXY_QUEUE_SIZE) {
+		uint8_t code = request[1];
+		this->sendError(arducom, sender, code, (code & ARDUCOM_TAG_FLAG ? request[ARDUCOM_HEADER_SIZE(code) - 1] : 0), ARDUCOM_BUSY);
+		return;
+	}
+	Request& entry = this->queue[(this->queueStart + this->queueCount) % ARDUCOM_PROXY_QUEUE_SIZE];
+	memcpy(entry.data, request, size);
+	entry.size = size;
+	entry.sender = sender;
+	this->queueCount++;
+}
+
+void ArducomTransportProxy::handleReply(Arducom* arducom) {
+	this->awaitingReply = false;
+	this->timeouts = 0;
+	if (this->baudrateState == BAUDRATE_NEGOTIATING) {
+		if (this->data[0] == (this->baudrateCommand | 0x80)) {
+			// confirmed; the device switches after sending the reply
+			if (this->currentBaudrate != this->baudrate)
+				this->switchBaudrate(this->baudrate);
+		}
+		// if the device does not know the command the current rate is kept
+		this->baudrateState = BAUDRATE_FIXED;
+		return;
+	}
+	Request& request = this->queue[this->queueStart];
+	// the reply must belong to the command
+	bool matches = (this->data[0] == ARDUCOM_ERROR_CODE) || (this->data[0] == (request.data[0] | 0x80));
+	if (matches && (request.data[1] & ARDUCOM_TAG_FLAG)) {
+		uint8_t tagPos = (this->data[0] == ARDUCOM_ERROR_CODE ? 3 : ARDUCOM_HEADER_SIZE(this->data[1]) - 1);
+		matches = (this->data[0] == ARDUCOM_ERROR_CODE || (this->data[1] & ARDUCOM_TAG_FLAG))
+			&& (this->data[tagPos] == request.data[ARDUCOM_HEADER_SIZE(request.data[1]) - 1]);
+	}
+	if (matches) {
+		#if ARDUCOM_PROXY_CACHE_SIZE > 0
+		this->cacheReply(request.data, this->data, this->size);
+		#endif
+		int8_t sent = this->transport->sendTo(arducom, request.sender, this->data, this->size);
+		// further frames of a run follow while their first payload byte is not 0
+		if ((sent == ARDUCOM_OK) && (this->data[0] != ARDUCOM_ERROR_CODE) && this->isRunCommand(request.data[0])
+			&& ((this->data[1] & ARDUCOM_LENGTH_MASK) > 0) && (this->data[ARDUCOM_HEADER_SIZE(this->data[1])] != 0)) {
+			this->awaitingReply = true;
+			this->sendTime = millis();
+			return;
+		}
+	}
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	else
+	if (arducom->debug)
+		arducom->debug->println(F("Proxy: reply does not match"));
+	#endif
+	this->queueStart = (this->queueStart + 1) % ARDUCOM_PROXY_QUEUE_SIZE;
+	this->queueCount--;
+}
+
+void ArducomTransportProxy::handleTimeout(Arducom* arducom) {
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	if (arducom->debug)
+		arducom->debug->println(F("Proxy: reply timeout"));
+	#endif
+	this->awaitingReply = false;
+	this->size = 0;
+	if (this->baudrateState == BAUDRATE_NEGOTIATING) {
+		// the device may still be starting up, or it may already use the new rate
+		// (for example, if this device has been restarted); try again with the other rate
+		this->switchBaudrate(this->currentBaudrate == this->initialBaudrate ? this->baudrate : this->initialBaudrate);
+		this->baudrateState = BAUDRATE_PENDING;
+		return;
+	}
+	// drop the command; the master will repeat it
+	this->queueStart = (this->queueStart + 1) % ARDUCOM_PROXY_QUEUE_SIZE;
+	this->queueCount--;
+	this->timeouts++;
+	// the device may have been restarted with its initial baud rate
+	if ((this->baudrateFunc != NULL) && (this->baudrate != this->initialBaudrate) && (this->timeouts >= ARDUCOM_PROXY_MAX_TIMEOUTS)) {
+		this->timeouts = 0;
+		this->baudrateState = BAUDRATE_PENDING;
+	}
+}
+
 int8_t ArducomTransportProxy::doWork(Arducom* arducom) {
 	int8_t result = transport->doWork(arducom);
 	// pass errors through
 	if (result != ARDUCOM_OK)
 		return result;
-	// data received by the transport?
-	if (transport->status == HAS_DATA) {
-		// send the data over the stream
-		this->stream->write((const uint8_t *)transport->data, transport->size);
-		this->stream->flush();
-		transport->status = NO_DATA;
-	}
-	// read incoming data
-	if (stream->available()) {
-		// need to collect all data at once because the target transport
-		// may require to send everything out at once. Use a small timeout between bytes
-		uint32_t startTime = millis();
-		while (millis() - startTime < 3) {
-			if (stream->available()) {
-				this->data[this->size] = stream->read();
-				#ifdef ARDUCOM_DEBUG_SUPPORT
-				if (arducom->debug) {
-					arducom->debug->print(F("Recv: "));
-					arducom->debug->print(this->data[this->size], HEX);
-					arducom->debug->println(F(" "));
-				}
-				#endif
-				this->size++;
-				// this may cause problems if the buffer size of the proxied device
-				// is larger than this device's buffer size. A solution is to 
-				// increase the buffer size for devices that are only intended
-				// to work as proxies.
-				if (this->size > ARDUCOM_BUFFERSIZE) {
-					this->status = TOO_MUCH_DATA;
-					this->size = 0;
-					return ARDUCOM_OVERFLOW;
-				}
-				startTime = millis();
+	// command received by the transport?
+	// (transports may deliver a command in several parts)
+	if ((transport->status == HAS_DATA) && arducom->isCommandComplete(transport))
+		this->takeOver(arducom);
+	if (this->awaitingReply) {
+		// read the reply as far as it is available; the frame header specifies its size
+		while (this->stream->available()) {
+			this->data[this->size] = this->stream->read();
+			this->size++;
+			uint8_t frameSize = 2;
+			if (this->size >= 2) {
+				if (this->data[0] == ARDUCOM_ERROR_CODE) {
+					// error replies to tagged commands contain the tag
+					bool tagged = (this->baudrateState != BAUDRATE_NEGOTIATING) && (this->queue[this->queueStart].data[1] & ARDUCOM_TAG_FLAG);
+					frameSize = (tagged ? 4 : 3);
+				} else
+					frameSize = ARDUCOM_HEADER_SIZE(this->data[1]) + (this->data[1] & ARDUCOM_LENGTH_MASK);
+			}
+			// this may happen if the buffer size of the proxied device
+			// is larger than this device's buffer size. A solution is to
+			// increase the buffer size for devices that are only intended
+			// to work as proxies.
+			if (frameSize > ARDUCOM_BUFFERSIZE) {
+				this->handleTimeout(arducom);
+				return ARDUCOM_OVERFLOW;
+			}
+			if (this->size >= frameSize) {
+				this->handleReply(arducom);
+				this->size = 0;
+				break;
 			}
 		}
+		if (this->awaitingReply && (millis() - this->sendTime >= this->timeoutMs))
+			this->handleTimeout(arducom);
 	}
-	if (this->size > 0) {
-		// send data using underlying transport
-		result = transport->send(arducom, this->data, this->size);
-		this->size = 0;
-	}
-	return result;
+	// next command; wait a little after a baud rate change
+	if (!this->awaitingReply && ((this->queueCount > 0) || (this->baudrateState == BAUDRATE_PENDING))
+		&& (millis() - this->switchTime >= ARDUCOM_PROXY_SWITCH_MS))
+		this->sendNext(arducom);
+	return ARDUCOM_OK;
 }
 
 /******************************************************************************************	
@@ -190,132 +502,351 @@ int8_t ArducomTransportProxy::doWork(Arducom* arducom) {
 ******************************************************************************************/
 
 Arducom::Arducom(ArducomTransport* transport, Print* debugPrint, uint16_t receiveTimeout) {
+	this->transports[0] = transport;
+	this->transportCount = 1;
+	this->nextTransport = 0;
 	this->transport = transport;
+	this->current = 0;
+	this->continuedCommand = NULL;
 	#if ARDUCOM_DEBUG_SUPPORT == 1
 	this->debug = debugPrint;
 	this->origDebug = debugPrint;	// remember original pointer (debug is switched off by NULLing debug)
 	#endif
-	this->lastDataSize = -1;
 	this->receiveTimeout = receiveTimeout;
-	this->lastReceiveTime = 0;
+	for (uint8_t i = 0; i < ARDUCOM_MAX_TRANSPORTS; i++) {
+		this->lastDataSize[i] = -1;
+		this->lastReceiveTime[i] = 0;
+	}
+	#if ARDUCOM_REPLY_CACHE == 1
+	this->cacheSize = 0;
+	this->pendingCommand = NULL;
+	this->pendingSize = 0;
+	#endif
+	#if ARDUCOM_DISPATCH_TABLE == 1
+	memset(this->commands, 0, sizeof(this->commands));
+	#else
+	this->commands = NULL;
+	this->commandCount = 0;
+	#endif
+	this->housekeepingList = NULL;
+	#if ARDUCOM_STATISTICS == 1
+	this->timeoutResets = 0;
+	#endif
 }
 	
+uint8_t Arducom::addTransport(ArducomTransport* transport) {
+	if (this->transportCount >= ARDUCOM_MAX_TRANSPORTS)
+		return ARDUCOM_OVERFLOW;
+	this->transports[this->transportCount] = transport;
+	this->transportCount++;
+	return ARDUCOM_OK;
+}
+
 uint8_t Arducom::addCommand(ArducomCommand* cmd) {
-	if (cmd->commandCode > 126)
+	if (cmd->commandCode > ARDUCOM_MAX_COMMANDCODE)
 		return ARDUCOM_COMMANDCODE_INVALID;
-	// check whether the command is already in the list
-	ArducomCommand* command = this->list;
-	while (command != 0) {
-		if (command->commandCode == cmd->commandCode)
-			return ARDUCOM_COMMAND_ALREADY_EXISTS;
-		command = command->next;
+	// check whether the command already exists
+	if (this->getCommand(cmd->commandCode) != NULL)
+		return ARDUCOM_COMMAND_ALREADY_EXISTS;
+	#if ARDUCOM_DISPATCH_TABLE == 1
+	this->commands[cmd->commandCode] = cmd;
+	#else
+	// grow the array by one entry (commands are usually added once during setup)
+	ArducomCommand** newCommands = (ArducomCommand**)realloc(this->commands, (this->commandCount + 1) * sizeof(ArducomCommand*));
+	if (newCommands == NULL)
+		return ARDUCOM_OVERFLOW;
+	this->commands = newCommands;
+	// insert the command keeping the array sorted by command code
+	uint8_t pos = this->commandCount;
+	while ((pos > 0) && (this->commands[pos - 1]->commandCode > cmd->commandCode)) {
+		this->commands[pos] = this->commands[pos - 1];
+		pos--;
 	}
-	cmd->next = this->list;
-	this->list = cmd;
+	this->commands[pos] = cmd;
+	this->commandCount++;
+	#endif
+	// commands that do not require housekeeping are removed from the list by doWork()
+	cmd->next = this->housekeepingList;
+	this->housekeepingList = cmd;
 	return ARDUCOM_OK;
 }
+
+ArducomCommand* Arducom::getCommand(uint8_t commandCode) {
+	#if ARDUCOM_DISPATCH_TABLE == 1
+	if (commandCode > ARDUCOM_MAX_COMMANDCODE)
+		return NULL;
+	return this->commands[commandCode];
+	#else
+	// binary search
+	uint8_t low = 0;
+	uint8_t high = this->commandCount;
+	while (low < high) {
+		uint8_t mid = (low + high) >> 1;
+		uint8_t code = this->commands[mid]->commandCode;
+		if (code == commandCode)
+			return this->commands[mid];
+		if (code < commandCode)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return NULL;
+	#endif
+}
 	
+uint8_t Arducom::getCommandCount(void) {
+	#if ARDUCOM_DISPATCH_TABLE == 1
+	uint8_t count = 0;
+	for (uint8_t i = 0; i <= ARDUCOM_MAX_COMMANDCODE; i++)
+		if (this->commands[i] != NULL)
+			count++;
+	return count;
+	#else
+	return this->commandCount;
+	#endif
+}
+
+ArducomCommand* Arducom::getCommandAt(uint8_t index) {
+	#if ARDUCOM_DISPATCH_TABLE == 1
+	for (uint8_t i = 0; i <= ARDUCOM_MAX_COMMANDCODE; i++)
+		if (this->commands[i] != NULL) {
+			if (index == 0)
+				return this->commands[i];
+			index--;
+		}
+	return NULL;
+	#else
+	if (index >= this->commandCount)
+		return NULL;
+	return this->commands[index];
+	#endif
+}
+
 uint8_t Arducom::doWork(void) {
 	// do the command housekeeping
-	ArducomCommand* command = this->list;
-	while (command != 0) {
+	ArducomCommand** link = &this->housekeepingList;
+	while (*link != NULL) {
+		ArducomCommand* command = *link;
+		this->noHousekeeping = false;
 		command->doWork(this);
-		command = command->next;
+		// the command does not override doWork(); it need not be called again
+		if (this->noHousekeeping)
+			*link = command->next;
+		else
+			link = &command->next;
 	}
-	
+
+	#if ARDUCOM_REPLY_CACHE == 1
+	// continue a pending command
+	if (this->pendingCommand != NULL)
+		this->resumePending();
+	#endif
+
+	// serve the transports in turn; the first one changes with each call
+	// so that none of them is preferred if commands arrive at the same time
+	uint8_t result = ARDUCOM_OK;
+	for (uint8_t i = 0; i < this->transportCount; i++) {
+		this->current = (this->nextTransport + i) % this->transportCount;
+		this->transport = this->transports[this->current];
+		uint8_t transportResult = this->serveTransport();
+		// report the first result that is not ARDUCOM_OK
+		if (result == ARDUCOM_OK)
+			result = transportResult;
+	}
+	this->nextTransport = (this->nextTransport + 1) % this->transportCount;
+	return result;
+}
+
+uint8_t Arducom::serveTransport(void) {
+	ArducomCommand* command;
+
 	// transport data handling
 	uint8_t result = this->transport->doWork(this);
 	if (result != ARDUCOM_OK)
 		return result;
 
+	// a run of reply frames is in progress on this transport?
+	if ((this->continuedCommand != NULL) && (this->continuedTransport == this->current)) {
+		// a new command from the master cancels the run
+		if (this->transport->status == ArducomTransport::HAS_DATA)
+			this->continuedCommand = NULL;
+		else {
+			// wait until the transport has passed on the previous frame
+			if ((this->transport->status == ArducomTransport::SENDING) || (this->transport->status == ArducomTransport::READY_TO_SEND))
+				return ARDUCOM_OK;
+			this->continueReply();
+			return ARDUCOM_COMMAND_HANDLED;
+		}
+	}
+
 	int8_t dataSize = this->transport->hasData();
 	uint8_t errorInfo = 0;
 	
 	// performance optimization: test commands only if a new data size is reported
 	// expect at least two bytes: command and code byte
-	if ((dataSize != this->lastDataSize) && (dataSize > 1)) {
-		this->lastDataSize = dataSize;
+	if ((dataSize != this->lastDataSize[this->current]) && (dataSize > 1)) {
+		this->lastDataSize[this->current] = dataSize;
 		// reset timeout counter
-		this->lastReceiveTime = millis();
+		this->lastReceiveTime[this->current] = millis();
 		// the first byte is the command byte
 		uint8_t commandByte = this->transport->data[0];
 		// the next byte is the code byte which contains the length
 		uint8_t code = this->transport->data[1];
+		// the header consists of command and code byte plus optional checksum and tag bytes
+		uint8_t headerSize = ARDUCOM_HEADER_SIZE(code);
 		// check whether the specified number of bytes has already been received
 		// the lower six bits of the code denote the payload size
-		if (dataSize - 2 < (code & 0b00111111))
+		if (dataSize - headerSize < (code & ARDUCOM_LENGTH_MASK))
 			// not enough data
 			return ARDUCOM_OK;
 		// checksum expected? highest bit of the code byte
-		bool checksum = (code >> 7);
-		// check whether checksum byte arrived
-		if (checksum) {
-			if (dataSize - 3 < (code & 0b00111111))
-				// not enough data
-				return ARDUCOM_OK;
-		}
+		bool checksum = (code & ARDUCOM_CHECKSUM_FLAG) == ARDUCOM_CHECKSUM_FLAG;
+		// tag byte present? bit 6 of the code byte
+		bool tagged = (code & ARDUCOM_TAG_FLAG) == ARDUCOM_TAG_FLAG;
+		uint8_t tag = (tagged ? this->transport->data[headerSize - 1] : 0);
 		// the command has been fully received
-		uint8_t destBuffer[ARDUCOM_BUFFERSIZE];
-		// payload data size is always without command and code and optional checksum byte
-		dataSize -= (checksum ? 3 : 2);
-		// go through commands to find a match
-		ArducomCommand* command = this->list;
-		result = ARDUCOM_COMMAND_UNKNOWN;
-		while (command != 0) {
-			// set errorInfo to the command code; if no command is found this code is returned
+		// the reply is composed in place in the transport's send buffer
+		uint8_t* sendBuffer = this->transport->getSendBuffer();
+		// payload data size is always without the header
+		dataSize -= headerSize;
+		// the checksum covers the tag byte and the payload
+		uint8_t requestSum = calculateChecksum(commandByte, code, (uint8_t*)&this->transport->data[headerSize - (tagged ? 1 : 0)], dataSize + (tagged ? 1 : 0));
+		bool handled = false;
+		// find the command
+		command = this->getCommand(commandByte);
+		if (command == NULL) {
+			result = ARDUCOM_COMMAND_UNKNOWN;
+			// return the command code
 			errorInfo = commandByte;
-			if (command->commandCode == commandByte) {
-				// clear error info before executing a command (if handle() does not set it no garbage will be returned)
-				errorInfo = 0;
-				bool handle = true;
-				// if specified, the number of payload bytes must be at least the number of expected bytes
-				if (command->expectedBytes >= 0) {
-					// has at least the expected number of bytes been received?
-					if (dataSize < command->expectedBytes) {
-						result = ARDUCOM_PARAMETER_MISMATCH;
-						errorInfo = command->expectedBytes;		// return number of expected bytes
-						handle = false;							// do not handle the command
-					}
+		} else
+		// if specified, the number of payload bytes must be at least the number of expected bytes
+		if ((command->expectedBytes >= 0) && (dataSize < command->expectedBytes)) {
+			result = ARDUCOM_PARAMETER_MISMATCH;
+			errorInfo = command->expectedBytes;		// return number of expected bytes
+		} else
+		// verify checksum
+		if (checksum && (requestSum != this->transport->data[2])) {
+			result = ARDUCOM_CHECKSUM_ERROR;
+			errorInfo = requestSum;
+		} else
+		// a command is sending a run of frames to another transport; only one run at a time,
+		// and commands that reply in runs must not change their state in the meantime
+		if ((this->continuedCommand != NULL) && ((command == this->continuedCommand) || command->repliesInRuns())) {
+			result = ARDUCOM_BUSY;
+			errorInfo = 1;
+		} else
+		#if ARDUCOM_REPLY_CACHE == 1
+		// the pending command is not finished yet; the master should ask again later
+		if ((this->pendingCommand != NULL) && ((command == this->pendingCommand)
+			|| (tagged && (this->pendingCommandByte == commandByte) && (this->pendingTag == tag) && (this->pendingRequestSum == requestSum)))) {
+			result = ARDUCOM_BUSY;
+			errorInfo = this->pendingEstimate;
+		} else
+		#endif
+		{
+			#if ARDUCOM_REPLY_CACHE == 1
+			// repeated tagged command? send the cached reply
+			if (tagged && (this->cacheSize > 0) && (this->cacheCommand == commandByte) && (this->cacheTag == tag)
+				&& (this->cacheRequestSum == requestSum) && (millis() - this->cacheTime < ARDUCOM_REPLY_CACHE_MS)) {
+				#if ARDUCOM_DEBUG_SUPPORT == 1
+				if (this->debug) {
+					this->debug->print(F("Repeated tag: "));
+					this->debug->println((int)tag);
 				}
-				
-				if (handle) {
-					if (checksum) {
-						// calculate and verify checksum 
-						uint8_t cksum = calculateChecksum(commandByte, code, (uint8_t*)&this->transport->data[3], dataSize);
-						if (cksum != this->transport->data[2]) {
-							result = ARDUCOM_CHECKSUM_ERROR;
-							errorInfo = cksum;
-							break;
-						}
-					}
-					
-					#if ARDUCOM_DEBUG_SUPPORT == 1
-					if (this->debug) {
-						this->debug->print(F("Cmd: "));
-						this->debug->print((int)commandByte);
-						this->debug->print(F(" Params: "));
-						this->debug->println((int)dataSize);
-					}
+				#endif
+				this->lastDataSize[this->current] = -1;
+				this->lastReceiveTime[this->current] = 0;
+				this->transport->send(this, this->cache, this->cacheSize);
+				return (this->cache[0] == ARDUCOM_ERROR_CODE ? ARDUCOM_COMMAND_ERROR : ARDUCOM_COMMAND_HANDLED);
+			}
+			// repeated command that has been completed in the background? send its reply
+			if (tagged && (this->pendingSize > 0) && (this->pendingCommandByte == commandByte) && (this->pendingTag == tag)
+				&& (this->pendingRequestSum == requestSum) && (millis() - this->pendingTime < ARDUCOM_REPLY_CACHE_MS)) {
+				this->lastDataSize[this->current] = -1;
+				this->lastReceiveTime[this->current] = 0;
+				this->transport->send(this, this->pendingReply, this->pendingSize);
+				return (this->pendingReply[0] == ARDUCOM_ERROR_CODE ? ARDUCOM_COMMAND_ERROR : ARDUCOM_COMMAND_HANDLED);
+			}
+			#endif
+
+			#if ARDUCOM_DEBUG_SUPPORT == 1
+			if (this->debug) {
+				this->debug->print(F("Cmd: "));
+				this->debug->print((int)commandByte);
+				this->debug->print(F(" Params: "));
+				this->debug->println((int)dataSize);
+			}
+			#endif
+			// clear error info before executing a command (if handle() does not set it no garbage will be returned)
+			errorInfo = 0;
+			#if ARDUCOM_STATISTICS == 1
+			uint32_t startMicros = micros();
+			#endif
+			// let the command do the work
+			result = command->handle(this, &this->transport->data[headerSize], &dataSize, 
+				&sendBuffer[headerSize], ARDUCOM_BUFFERSIZE - headerSize, &errorInfo);
+			handled = true;
+			#if ARDUCOM_STATISTICS == 1
+			bool pending = false;
+			#endif
+			// further frames follow this reply?
+			if (result == ARDUCOM_COMMAND_CONTINUE) {
+				// only one run at a time; another transport's run is still active
+				// (the command should have declared repliesInRuns() to be checked before handle())
+				if (this->continuedCommand != NULL) {
+					result = ARDUCOM_BUSY;
+					errorInfo = 1;
+				} else {
+					this->continuedCommand = command;
+					this->continuedTransport = this->current;
+					this->continuedCode = code;
+					this->continuedTag = tag;
+					result = ARDUCOM_OK;
+				}
+			}
+			if (result == ARDUCOM_COMMAND_PENDING) {
+				#if ARDUCOM_REPLY_CACHE == 1
+				// tagged commands complete in the background; the result is kept until the master repeats the request
+				// (only one command can be pending at a time)
+				if (tagged && (this->pendingCommand == NULL)) {
+					this->pendingCommand = command;
+					this->pendingCode = code;
+					this->pendingEstimate = errorInfo;
+					this->pendingSize = 0;
+					this->pendingCommandByte = commandByte;
+					this->pendingTag = tag;
+					this->pendingRequestSum = requestSum;
+					#if ARDUCOM_STATISTICS == 1
+					this->pendingMicros = micros() - startMicros;
 					#endif
-					// let the command do the work
-					result = command->handle(this, &this->transport->data[(checksum ? 3 : 2)], &dataSize, 
-						&destBuffer[(checksum ? 3 : 2)], ARDUCOM_BUFFERSIZE - (checksum ? 3 : 2), &errorInfo);
-					#if ARDUCOM_DEBUG_SUPPORT == 1
-					if (this->debug) {
-						this->debug->print(F("Ret: "));
-						this->debug->print((int)result);
-						this->debug->print(F(" Params: "));
-						this->debug->println((int)dataSize);
-					}
+					result = ARDUCOM_BUSY;
+					#if ARDUCOM_STATISTICS == 1
+					pending = true;
 					#endif
+				} else
+				#endif
+				// complete the command now
+				while (result == ARDUCOM_COMMAND_PENDING) {
+					errorInfo = 0;
+					result = command->resume(this, &sendBuffer[headerSize], &dataSize, ARDUCOM_BUFFERSIZE - headerSize, &errorInfo);
 				}
-				break;
 			}
-			command = command->next;
+			#if ARDUCOM_STATISTICS == 1
+			if (!pending)
+				command->recordStatistics(result, micros() - startMicros);
+			#endif
+			#if ARDUCOM_DEBUG_SUPPORT == 1
+			if (this->debug) {
+				this->debug->print(F("Ret: "));
+				this->debug->print((int)result);
+				this->debug->print(F(" Params: "));
+				this->debug->println((int)dataSize);
+			}
+			#endif
 		}
 		// reset data size cache (start over)
-		this->lastDataSize = -1;
-		this->lastReceiveTime = 0;
+		this->lastDataSize[this->current] = -1;
+		this->lastReceiveTime[this->current] = 0;
 		// check result code
 		if (result != ARDUCOM_OK) {
 			// an error has occurred; send it back to the master
@@ -327,38 +858,36 @@ uint8_t Arducom::doWork(void) {
 				this->debug->println((int)errorInfo);
 			}
 			#endif
-			// send error code back
-			destBuffer[0] = ARDUCOM_ERROR_CODE;
-			destBuffer[1] = result;
-			destBuffer[2] = errorInfo;
-			// error codes are not checksummed
-			this->transport->send(this, destBuffer, 3);
+			uint8_t replySize = this->composeReply(sendBuffer, commandByte, code, tag, result, errorInfo, 0);
+			#if ARDUCOM_REPLY_CACHE == 1
+			// busy replies are never cached
+			if (tagged && handled && (result != ARDUCOM_BUSY))
+				this->cacheReply(commandByte, tag, requestSum, sendBuffer, replySize);
+			#endif
+			this->transport->send(this, sendBuffer, replySize);
 			return ARDUCOM_COMMAND_ERROR;
 		}
 		// the command has been handled, send data back
-		// set MSB of command byte
-		destBuffer[0] = command->commandCode | 0x80;
-		// prepare return code: lower six bits are length of payload
-		destBuffer[1] = (dataSize & 0b00111111);
-		// checksum calculation
-		if (checksum) {
-			// indicate checksum to master
-			destBuffer[1] |= 0x80;
-			// calculate checksum
-			destBuffer[2] = calculateChecksum(destBuffer[0], destBuffer[1], &destBuffer[3], dataSize);
-		}
+		uint8_t replySize = this->composeReply(sendBuffer, command->commandCode, code, tag, result, errorInfo, dataSize);
+		#if ARDUCOM_REPLY_CACHE == 1
+		if (tagged)
+			this->cacheReply(commandByte, tag, requestSum, sendBuffer, replySize);
+		#endif
 		
-		this->transport->send(this, destBuffer, (checksum ? 3 : 2) + dataSize);
+		this->transport->send(this, sendBuffer, replySize);
 		return ARDUCOM_COMMAND_HANDLED;
 	} else {
 		// new data is not available
 		// check whether receive timeout is up
-		if ((this->lastReceiveTime > 0) && (this->receiveTimeout > 0)) {
-			if (millis() - this->lastReceiveTime > this->receiveTimeout) {
+		if ((this->lastReceiveTime[this->current] > 0) && (this->receiveTimeout > 0)) {
+			if (millis() - this->lastReceiveTime[this->current] > this->receiveTimeout) {
 				// timeout is up, reset the transport and start over
 				this->transport->reset();
-				this->lastReceiveTime = 0;
-				this->lastDataSize = -1;
+				this->lastReceiveTime[this->current] = 0;
+				this->lastDataSize[this->current] = -1;
+				#if ARDUCOM_STATISTICS == 1
+				this->timeoutResets++;
+				#endif
 				return ARDUCOM_TIMEOUT;
 			}
 		}
@@ -366,6 +895,94 @@ uint8_t Arducom::doWork(void) {
 	return ARDUCOM_OK;
 }
 
+uint8_t Arducom::composeReply(uint8_t* buffer, uint8_t commandCode, uint8_t code, uint8_t tag, uint8_t result, uint8_t errorInfo, uint8_t dataSize) {
+	bool tagged = (code & ARDUCOM_TAG_FLAG) == ARDUCOM_TAG_FLAG;
+	if (result != ARDUCOM_OK) {
+		// send error code back
+		buffer[0] = ARDUCOM_ERROR_CODE;
+		buffer[1] = result;
+		buffer[2] = errorInfo;
+		// error codes are not checksummed; tagged commands receive the tag as fourth byte
+		buffer[3] = tag;
+		return (tagged ? 4 : 3);
+	}
+	// set MSB of command byte
+	buffer[0] = commandCode | 0x80;
+	// prepare return code: lower six bits are length of payload
+	buffer[1] = (dataSize & ARDUCOM_LENGTH_MASK);
+	uint8_t headerSize = ARDUCOM_HEADER_SIZE(code);
+	if (tagged) {
+		// return the tag to the master
+		buffer[1] |= ARDUCOM_TAG_FLAG;
+		buffer[headerSize - 1] = tag;
+	}
+	// checksum calculation
+	if ((code & ARDUCOM_CHECKSUM_FLAG) == ARDUCOM_CHECKSUM_FLAG) {
+		// indicate checksum to master
+		buffer[1] |= ARDUCOM_CHECKSUM_FLAG;
+		// calculate checksum
+		buffer[2] = calculateChecksum(buffer[0], buffer[1], &buffer[3], dataSize + (tagged ? 1 : 0));
+	}
+	return headerSize + dataSize;
+}
+
+void Arducom::continueReply(void) {
+	ArducomCommand* command = this->continuedCommand;
+	uint8_t* sendBuffer = this->transport->getSendBuffer();
+	uint8_t headerSize = ARDUCOM_HEADER_SIZE(this->continuedCode);
+	int8_t dataSize = 0;
+	uint8_t errorInfo = 0;
+	#if ARDUCOM_STATISTICS == 1
+	uint32_t startMicros = micros();
+	#endif
+	uint8_t result = command->continueReply(this, &sendBuffer[headerSize], &dataSize, ARDUCOM_BUFFERSIZE - headerSize, &errorInfo);
+	if (result == ARDUCOM_COMMAND_CONTINUE)
+		result = ARDUCOM_OK;
+	else
+		// last frame or error
+		this->continuedCommand = NULL;
+	#if ARDUCOM_STATISTICS == 1
+	command->recordStatistics(result, micros() - startMicros);
+	#endif
+	uint8_t replySize = this->composeReply(sendBuffer, command->commandCode, this->continuedCode, this->continuedTag, result, errorInfo, (result == ARDUCOM_OK ? dataSize : 0));
+	this->transport->send(this, sendBuffer, replySize);
+}
+
+#if ARDUCOM_REPLY_CACHE == 1
+void Arducom::cacheReply(uint8_t commandByte, uint8_t tag, uint8_t requestSum, uint8_t* buffer, uint8_t size) {
+	memcpy(this->cache, buffer, size);
+	this->cacheSize = size;
+	this->cacheCommand = commandByte;
+	this->cacheTag = tag;
+	this->cacheRequestSum = requestSum;
+	this->cacheTime = millis();
+}
+
+void Arducom::resumePending(void) {
+	uint8_t headerSize = ARDUCOM_HEADER_SIZE(this->pendingCode);
+	int8_t dataSize = 0;
+	uint8_t errorInfo = 0;
+	#if ARDUCOM_STATISTICS == 1
+	uint32_t startMicros = micros();
+	#endif
+	uint8_t result = this->pendingCommand->resume(this, &this->pendingReply[headerSize], &dataSize, ARDUCOM_BUFFERSIZE - headerSize, &errorInfo);
+	#if ARDUCOM_STATISTICS == 1
+	this->pendingMicros += micros() - startMicros;
+	#endif
+	if (result == ARDUCOM_COMMAND_PENDING) {
+		this->pendingEstimate = errorInfo;
+		return;
+	}
+	// the command is complete; the master receives the result when it repeats the command
+	this->pendingSize = this->composeReply(this->pendingReply, this->pendingCommand->commandCode, this->pendingCode, this->pendingTag, result, errorInfo, dataSize);
+	this->pendingTime = millis();
+	#if ARDUCOM_STATISTICS == 1
+	this->pendingCommand->recordStatistics(result, this->pendingMicros);
+	#endif
+	this->pendingCommand = NULL;
+}
+#endif
+
 void Arducom::setFlags(uint8_t mask, uint8_t flags) {
 	#if ARDUCOM_DEBUG_SUPPORT == 1
 	if ((mask & ARDUCOM_FLAG_ENABLEDEBUG) == ARDUCOM_FLAG_ENABLEDEBUG) {
@@ -410,11 +1027,9 @@ bool Arducom::isCommandComplete(ArducomTransport* transport) {
 	// the first byte is the command byte
 	// the next byte is the code byte which contains the length
 	uint8_t code = transport->data[1];
-	// checksum expected? highest bit of the code byte
-	bool checksum = (code >> 7);
 	// check whether the specified number of bytes has already been received
 	// the lower six bits of the code denote the payload size
-	if (dataSize - (checksum ? 3 : 2) < (code & 0b00111111))
+	if (dataSize - ARDUCOM_HEADER_SIZE(code) < (code & ARDUCOM_LENGTH_MASK))
 		// not enough data
 		return false;
 	return true;
@@ -479,6 +1094,72 @@ int8_t ArducomVersionCommand::handle(Arducom* arducom, uint8_t* dataBuffer, int8
 	return ARDUCOM_OK;
 }
 
+void ArducomCommand::doWork(Arducom* arducom) {
+	// no housekeeping required; Arducom removes the command from its housekeeping list
+	arducom->noHousekeeping = true;
+}
+
+#if ARDUCOM_STATISTICS == 1
+void ArducomCommand::recordStatistics(uint8_t result, uint32_t duration) {
+	if (this->statCalls < 0xFFFF)
+		this->statCalls++;
+	if ((result != ARDUCOM_OK) && (this->statErrors < 0xFFFF))
+		this->statErrors++;
+	if (duration < this->statMinMicros)
+		this->statMinMicros = duration;
+	if (duration > this->statMaxMicros)
+		this->statMaxMicros = duration;
+	this->statTotalMicros += duration;
+}
+
+int8_t ArducomStatisticsCommand::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	// this method expects a one-byte command index
+	uint8_t index = dataBuffer[0];
+	uint8_t pos = 0;
+	destBuffer[pos++] = arducom->getCommandCount();
+	memcpy(&destBuffer[pos], &arducom->timeoutResets, 2);
+	pos += 2;
+	ArducomCommand* command = arducom->getCommandAt(index);
+	if (command != NULL) {
+		destBuffer[pos++] = command->commandCode;
+		memcpy(&destBuffer[pos], &command->statCalls, 2);
+		pos += 2;
+		memcpy(&destBuffer[pos], &command->statErrors, 2);
+		pos += 2;
+		// report a minimum of 0 if the command has not been called yet
+		uint32_t minMicros = (command->statCalls > 0 ? command->statMinMicros : 0);
+		memcpy(&destBuffer[pos], &minMicros, 4);
+		pos += 4;
+		memcpy(&destBuffer[pos], &command->statMaxMicros, 4);
+		pos += 4;
+		memcpy(&destBuffer[pos], &command->statTotalMicros, 4);
+		pos += 4;
+	}
+	*dataSize = pos;
+	return ARDUCOM_OK;
+}
+#endif
+
+int8_t ArducomSetBaudrate::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	// this method expects a four-byte baud rate
+	uint32_t baudrate;
+	memcpy(&baudrate, dataBuffer, 4);
+	if (baudrate == 0)
+		return ARDUCOM_ILLEGAL_ARGUMENT;
+	// the new rate is set after the reply has been sent (at the current rate)
+	this->baudrate = baudrate;
+	memcpy(destBuffer, &baudrate, 4);
+	*dataSize = 4;
+	return ARDUCOM_OK;
+}
+
+void ArducomSetBaudrate::doWork(Arducom* arducom) {
+	if ((this->baudrate == 0) || arducom->isSending())
+		return;
+	this->setBaudrate(this->baudrate);
+	this->baudrate = 0;
+}
+
 /***************************************
 * Predefined EEPROM access commands
 ****************************************/
@@ -492,7 +1173,7 @@ int8_t ArducomWriteEEPROMByte::handle(Arducom* arducom, uint8_t* dataBuffer, int
 	if (E2END < address)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_update_byte((uint8_t*)address, dataBuffer[2]);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	EEPROM.write(address, dataBuffer[2]);
@@ -512,7 +1193,7 @@ int8_t ArducomReadEEPROMByte::handle(Arducom* arducom, uint8_t* dataBuffer, int8
 	uint16_t address = *((uint16_t*)dataBuffer);
 	#if defined(__AVR__)
 	destBuffer[0] = eeprom_read_byte((uint8_t*)address);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	destBuffer[0] = EEPROM.read(address);
@@ -532,7 +1213,7 @@ int8_t ArducomWriteEEPROMInt16::handle(Arducom* arducom, uint8_t* dataBuffer, in
 	if (E2END < address + 1)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_update_word((uint16_t*)address, dataBuffer[2] + (dataBuffer[3] << 8));
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + 1)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	EEPROM.write(address, dataBuffer[2]);
@@ -555,7 +1236,7 @@ int8_t ArducomReadEEPROMInt16::handle(Arducom* arducom, uint8_t* dataBuffer, int
 	if (E2END < address + 1)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_read_block(destBuffer, (uint16_t*)address, 2);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + 1)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	destBuffer[0] = EEPROM.read(address);
@@ -576,7 +1257,7 @@ int8_t ArducomWriteEEPROMInt32::handle(Arducom* arducom, uint8_t* dataBuffer, in
 	if (E2END < address + 3)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_update_block((const void *)&dataBuffer[2], (uint16_t*)address, 4);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + 3)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	for (uint8_t i = 0; i < 4; i++)
@@ -599,7 +1280,7 @@ int8_t ArducomReadEEPROMInt32::handle(Arducom* arducom, uint8_t* dataBuffer, int
 	if (E2END < address + 3)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_read_block(destBuffer, (uint16_t*)address, 4);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + 3)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	for (uint8_t i = 0; i < 4; i++)
@@ -620,7 +1301,7 @@ int8_t ArducomWriteEEPROMInt64::handle(Arducom* arducom, uint8_t* dataBuffer, in
 	if (E2END < address + 7)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_update_block((const void *)&dataBuffer[2], (uint16_t*)address, 8);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + 7)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	for (uint8_t i = 0; i < 8; i++)
@@ -643,7 +1324,7 @@ int8_t ArducomReadEEPROMInt64::handle(Arducom* arducom, uint8_t* dataBuffer, int
 	if (E2END < address + 7)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_read_block(destBuffer, (uint16_t*)address, 8);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + 7)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	for (uint8_t i = 0; i < 8; i++)
@@ -670,7 +1351,7 @@ int8_t ArducomWriteEEPROMBlock::handle(Arducom* arducom, uint8_t* dataBuffer, in
 	if (E2END < address + *dataSize - 2)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_update_block((const void *)&dataBuffer[2], (uint16_t*)address, *dataSize - 2);
-	#elif defined(ESP8266)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
 	if (EEPROM.length() <= (size_t)address + *dataSize - 2)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	for (uint8_t i = 0; i < *dataSize - 2; i++)
@@ -695,13 +1376,13 @@ int8_t ArducomReadEEPROMBlock::handle(Arducom* arducom, uint8_t* dataBuffer, int
 		return ARDUCOM_BUFFER_OVERRUN;
 	}
 	#if defined(__AVR__)
-	if (E2END < address + * dataSize - 2)
+	if (E2END < address + length - 1)
 		return ARDUCOM_LIMIT_EXCEEDED;
 	eeprom_read_block(destBuffer, (uint16_t*)address, length);
-	#elif defined(ESP8266)
-	if (EEPROM.length() <= (size_t)address + *dataSize - 2)
+	#elif defined(ESP8266) || defined(ARDUCOM_SIM)
+	if (EEPROM.length() < (size_t)address + length)
 		return ARDUCOM_LIMIT_EXCEEDED;
-	for (uint8_t i = 0; i < *dataSize - 2; i++)
+	for (uint8_t i = 0; i < length; i++)
 		destBuffer[i] = EEPROM.read(address + i);
 	#else
 		return ARDUCOM_NOT_IMPLEMENTED;
@@ -27,6 +27,35 @@
 // Comment this or set it to 0 to reduce code size.
 #define ARDUCOM_DEBUG_SUPPORT			0
 
+// If ARDUCOM_REPLY_CACHE is 1 Arducom keeps a copy of the last reply to a tagged command.
+// A repeated tagged command (same command, tag and payload) is answered from this copy
+// instead of being executed again. A command that completes in the background (see ArducomCommand::resume)
+// keeps its reply in a second copy. Set it to 0 to save about 80 bytes of RAM.
+#define ARDUCOM_REPLY_CACHE				1
+
+// Time in milliseconds during which a cached reply is considered valid for a repeated command.
+#define ARDUCOM_REPLY_CACHE_MS			3000
+
+// If ARDUCOM_DISPATCH_TABLE is 1 commands are looked up in a table indexed by command code
+// (127 pointers). Otherwise a sorted array that only holds the added commands is searched
+// which saves RAM on small AVRs.
+#ifndef ARDUCOM_DISPATCH_TABLE
+#if defined(__AVR__)
+#define ARDUCOM_DISPATCH_TABLE			0
+#else
+#define ARDUCOM_DISPATCH_TABLE			1
+#endif
+#endif
+
+// Highest allowed command code
+#define ARDUCOM_MAX_COMMANDCODE			126
+
+// If ARDUCOM_STATISTICS is 1 Arducom records execution statistics for each command
+// (16 bytes of RAM per command) which can be queried using the ArducomStatisticsCommand.
+#ifndef ARDUCOM_STATISTICS
+#define ARDUCOM_STATISTICS				0
+#endif
+
 // Arducom status codes that are used internally
 #define ARDUCOM_OK						0
 #define ARDUCOM_COMMAND_HANDLED			1
@@ -44,6 +73,11 @@
 #define ARDUCOM_TRANSPORT_ERROR			13
 #define ARDUCOM_HARDWARE_ERROR			14
 #define ARDUCOM_NETWORK_ERROR			15
+#define ARDUCOM_TAG_MISMATCH			16
+// returned by command handlers whose result is not yet available (see ArducomCommand::resume)
+#define ARDUCOM_COMMAND_PENDING			17
+// returned by command handlers whose reply is followed by further frames (see ArducomCommand::continueReply)
+#define ARDUCOM_COMMAND_CONTINUE		18
 
 // Arducom error codes that are being sent back to the master
 #define ARDUCOM_NO_DATA					128
@@ -56,15 +90,32 @@
 #define ARDUCOM_NOT_IMPLEMENTED			135
 #define ARDUCOM_INVALID_CONFIG			136
 #define ARDUCOM_ILLEGAL_ARGUMENT		137
+// the command is still being processed; the info byte estimates the remaining time in units of 10 ms
+#define ARDUCOM_BUSY					138
+// the reply is not yet available (premature request on I2C); the master should request it again without
+// sending the command again. The info byte estimates the remaining time in units of 10 ms
+#define ARDUCOM_NOT_READY				139
 #define ARDUCOM_FUNCTION_ERROR			254
 
 #define ARDUCOM_ERROR_CODE				255
 
+// size of the transport buffer; the Wire library limits I2C frames to 32 bytes
+#ifndef ARDUCOM_BUFFERSIZE
 #define ARDUCOM_BUFFERSIZE	32
+#endif
 #if (ARDUCOM_BUFFERSIZE > 64)
 #error "Maximum ARDUCOM_BUFFERSIZE is 64"
 #endif
 
+// Code byte bit flags; the lower six bits of the code byte contain the payload length.
+// If the tag flag is set the header contains a tag byte after the optional checksum byte.
+#define ARDUCOM_CHECKSUM_FLAG			0x80
+#define ARDUCOM_TAG_FLAG				0x40
+#define ARDUCOM_LENGTH_MASK				0x3F
+
+// Size of a frame header (command byte, code byte, optional checksum and tag bytes) for the given code byte
+#define ARDUCOM_HEADER_SIZE(code)		(2 + (((code) & ARDUCOM_CHECKSUM_FLAG) ? 1 : 0) + (((code) & ARDUCOM_TAG_FLAG) ? 1 : 0))
+
 // Configuration bit flag constants
 #define ARDUCOM_FLAG_ENABLEDEBUG		0x01
 #define ARDUCOM_FLAG_INFINITELOOP		0x40
@@ -72,6 +123,12 @@
 
 #define ARDUCOM_VERSION_COMMAND         0
 
+// Default command code of the statistics command
+#define ARDUCOM_STATISTICS_COMMAND		126
+
+// Default command code of the baud rate command (used by the ArducomTransportProxy)
+#define ARDUCOM_BAUDRATE_COMMAND		125
+
 // Interpreted by command 0; calls the shutdown hook if provided
 // as command line parameter, specify "ADEE" as input is LSB first
 #define ARDUCOM_SHUTDOWN				((uint16_t)0xEEAD)
@@ -82,12 +139,51 @@
 
 #define ARDUCOM_TCP_DEFAULT_PORT		4152
 
+#define ARDUCOM_UDP_DEFAULT_PORT		4152
+
+// maximum number of transports of an Arducom instance
+#ifndef ARDUCOM_MAX_TRANSPORTS
+#define ARDUCOM_MAX_TRANSPORTS			3
+#endif
+
+// number of commands the ArducomTransportProxy accepts while waiting for a reply
+#ifndef ARDUCOM_PROXY_QUEUE_SIZE
+#ifdef ESP8266
+#define ARDUCOM_PROXY_QUEUE_SIZE		4
+#else
+#define ARDUCOM_PROXY_QUEUE_SIZE		1
+#endif
+#endif
+
+// time the ArducomTransportProxy waits after a baud rate change before it sends the next command
+#ifndef ARDUCOM_PROXY_SWITCH_MS
+#define ARDUCOM_PROXY_SWITCH_MS			10
+#endif
+
+// number of consecutive reply timeouts after which the ArducomTransportProxy negotiates the baud rate again
+#ifndef ARDUCOM_PROXY_MAX_TIMEOUTS
+#define ARDUCOM_PROXY_MAX_TIMEOUTS		3
+#endif
+
+// number of replies the ArducomTransportProxy can cache (0 disables the cache)
+#ifndef ARDUCOM_PROXY_CACHE_SIZE
+#ifdef ESP8266
+#define ARDUCOM_PROXY_CACHE_SIZE		8
+#else
+#define ARDUCOM_PROXY_CACHE_SIZE		0
+#endif
+#endif
+
 #ifdef ARDUINO
 
 #include <Arduino.h>
 
 class Arducom;
 
+/** Function that changes the baud rate of a serial connection. It must wait until pending output
+*   has been transmitted, for example: Serial.flush(); Serial.begin(baudrate); */
+typedef void (*ArducomBaudrateFunc)(uint32_t baudrate);
+
 /******************************************************************************************
 * Arducom transport base class definition
 ******************************************************************************************/
@@ -98,9 +194,10 @@ class Arducom;
 *   Messages that are being sent back consist of a two byte header plus an optional payload.
 *   The first byte is the command code with its highest bit set. It signals the master that the
 *   correct command has been processed. In this case the second byte's lower six bits specify
-*   the length of the returned payload. The highest two bits can signal command specific codes.
+*   the length of the returned payload. The highest bit signals a checksum byte, bit 6 a tag byte.
 *   If the first byte is 255 it signals an unsupported command or another error. In this case
 *   the second byte is an error code and the third byte contains error specific information.
+*   Error replies to tagged commands contain the tag as fourth byte.
 */
 class ArducomTransport {
 
@@ -116,6 +213,7 @@ public:
 		, HAS_DATA
 		, READY_TO_SEND
 		, SENT
+		, SENDING
 	};
 
 	volatile Status status;
@@ -124,8 +222,13 @@ public:
 	uint8_t data[ARDUCOM_BUFFERSIZE];
 	// number of valid bytes in the buffer
 	volatile uint8_t size;
+	// position of the next byte to transmit while the status is SENDING
+	uint8_t sendPos;
+	// set when the output has reported free space; until then availableForWrite() is assumed to be unsupported
+	bool reportsCapacity;
 
 	ArducomTransport() {
+		this->reportsCapacity = false;
 		this->reset();
 	};
 
@@ -138,8 +241,38 @@ public:
 	/** Prepares the transport to send count bytes from the buffer; returns -1 in case of errors. */
 	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count) = 0;
 
+	/** Returns the buffer in which replies are composed. Command handlers write their results
+	*   directly into this buffer so that send() does not have to copy them if the same buffer
+	*   is passed back. By default this is the receive buffer, so the request is overwritten. */
+	virtual uint8_t* getSendBuffer(void) {
+		return this->data;
+	};
+
 	/** Performs regular housekeeping; called from the Arducom main class; returns -1 in case of errors. */
 	virtual int8_t doWork(Arducom* arducom) = 0;
+
+	/** Called by the ArducomTransportProxy when it has taken over a complete command. Transports that
+	*   serve several masters may release the sender and receive the next command while the reply is
+	*   pending. Returns a value that identifies the sender for sendTo(). */
+	virtual int16_t detach(void) {
+		return 0;
+	};
+
+	/** Sends the reply to a command that has been taken over by the ArducomTransportProxy.
+	*   The sender is the value returned by detach(). By default, the reply is passed to send(). */
+	virtual int8_t sendTo(Arducom* arducom, int16_t sender, uint8_t* buffer, uint8_t count) {
+		return this->send(arducom, buffer, count);
+	};
+
+protected:
+	/** Places count bytes from the buffer in the send queue (the data buffer) and sets the status to SENDING.
+	*   While the status is SENDING the transport must not accept new data. */
+	void queueSend(uint8_t* buffer, uint8_t count);
+
+	/** Writes as many queued bytes to the output as it accepts without blocking.
+	*   If the output cannot tell how much it accepts all queued bytes are written.
+	*   Sets the status to SENT when the queue is empty. */
+	void writeQueued(Print* output);
 };
 
 /** This class defines the transport mechanism for Arducom commands over a Stream.
@@ -158,7 +291,22 @@ protected:
 	Stream* stream;
 };
 
-/** This class relays communication from an ArducomTransport to a generic Stream.
+/** This structure defines a command whose replies the ArducomTransportProxy may cache. */
+struct ArducomProxyCacheRule {
+	uint8_t commandCode;
+	// time in milliseconds for which a reply is valid; 0 terminates the table
+	uint16_t ttlMs;
+};
+
+/** This class relays communication from an ArducomTransport to a generic Stream, for example
+*   from WiFi clients to an Arduino that is connected to the serial port of an ESP8266.
+*   Complete commands are taken over from the transport and queued (up to ARDUCOM_PROXY_QUEUE_SIZE);
+*   when the queue is full the master receives ARDUCOM_BUSY. One command at a time is written to the
+*   stream. Its reply is recognized by the frame header, not by a pause in the data, and returned
+*   to the master that sent the command if command code and tag match. A command that is not
+*   answered within the timeout is dropped. The frames of a run are relayed if the command
+*   is known to reply in runs (see setRunCommands()).
+*   The proxy can negotiate a higher baud rate with the downstream device (see setBaudrate()).
 */
 class ArducomTransportProxy: public ArducomTransport {
 
@@ -170,9 +318,118 @@ public:
 	/** Prepares the transport to send count bytes from the buffer; returns -1 in case of errors. */
 	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count);
 
+	/** Sets the time to wait for a reply from the stream. Defaults to ARDUCOM_DEFAULT_TIMEOUT_MS. */
+	virtual void setTimeout(uint32_t timeoutMs);
+
+	/** Switches the stream from the initial baud rate (which must already be set) to the given baud rate.
+	*   The downstream device must handle the baud rate command (see ArducomSetBaudrate).
+	*   The rate is changed by the supplied function after the device has confirmed the new rate.
+	*   If the device does not answer the proxy alternates between both rates until it does;
+	*   after ARDUCOM_PROXY_MAX_TIMEOUTS unanswered commands the rate is negotiated again.
+	*   If the device does not know the command the current baud rate is kept. */
+	virtual void setBaudrate(ArducomBaudrateFunc setBaudrate, uint32_t initialBaudrate, uint32_t baudrate, uint8_t commandCode = ARDUCOM_BAUDRATE_COMMAND);
+
+	/** Sets the commands that reply with a run of frames (see ArducomCommand::continueReply).
+	*   The proxy relays the frames of such a command to its master as long as the first payload byte
+	*   is not 0, which is the case for the FTP commands ARDUCOM_FTP_COMMAND_LISTDIR and
+	*   ARDUCOM_FTP_COMMAND_READBLOCKS. Other commands are finished after the first frame. */
+	virtual void setRunCommands(const uint8_t* commandCodes, uint8_t count);
+
+	#if ARDUCOM_PROXY_CACHE_SIZE > 0
+	/** Sets the commands whose replies are cached. The table is terminated by an entry with ttlMs 0.
+	*   A command with the same payload as a cached one is answered by the proxy until the reply expires;
+	*   tag and checksum are those of the new command. Commands that are not in the table may change
+	*   the state of the device, so forwarding one of them clears the cache. */
+	virtual void setCacheRules(const ArducomProxyCacheRule* rules);
+
+	/** Discards all cached replies. */
+	virtual void clearCache(void);
+	#endif
+
 protected:
+	enum BaudrateState
+#if __cplusplus >= 201103L
+: uint8_t
+#endif
+{
+		BAUDRATE_FIXED
+		, BAUDRATE_PENDING
+		, BAUDRATE_NEGOTIATING
+	};
+
+	// a command that has been taken over from the transport
+	struct Request {
+		int16_t sender;
+		uint8_t size;
+		uint8_t data[ARDUCOM_BUFFERSIZE];
+	};
+
 	ArducomTransport* transport;
 	Stream* stream;
+	Request queue[ARDUCOM_PROXY_QUEUE_SIZE];
+	// index of the oldest request; it is the one that has been written to the stream
+	uint8_t queueStart;
+	uint8_t queueCount;
+	// true while a command (or the baud rate command) is waiting for its reply
+	bool awaitingReply;
+	uint32_t sendTime;
+	// time of the last baud rate change
+	uint32_t switchTime;
+	uint32_t timeoutMs;
+	uint8_t timeouts;
+	BaudrateState baudrateState;
+	ArducomBaudrateFunc baudrateFunc;
+	uint32_t initialBaudrate;
+	uint32_t baudrate;
+	uint32_t currentBaudrate;
+	uint8_t baudrateCommand;
+	const uint8_t* runCommands;
+	uint8_t runCommandCount;
+
+	/** Returns true if the command replies with a run of frames. */
+	bool isRunCommand(uint8_t commandCode);
+
+	#if ARDUCOM_PROXY_CACHE_SIZE > 0
+	// a cached reply; the request is stored without header
+	struct CacheEntry {
+		uint32_t time;
+		uint16_t ttlMs;
+		uint8_t requestSize;
+		uint8_t request[ARDUCOM_BUFFERSIZE];
+		uint8_t replySize;
+		uint8_t reply[ARDUCOM_BUFFERSIZE];
+	};
+
+	const ArducomProxyCacheRule* cacheRules;
+	CacheEntry cache[ARDUCOM_PROXY_CACHE_SIZE];
+
+	/** Returns the time to live for replies to the given command, or 0 if they are not cached. */
+	uint16_t getCacheTTL(uint8_t commandCode);
+
+	/** Answers the command from the cache; returns false if there is no valid reply. */
+	bool replyFromCache(Arducom* arducom, int16_t sender, uint8_t* request, uint8_t size);
+
+	/** Places the reply to the command in the cache if the command is cacheable. */
+	void cacheReply(uint8_t* request, uint8_t* reply, uint8_t replySize);
+	#endif
+
+	/** Replies to a command that cannot be queued with an error. */
+	void sendError(Arducom* arducom, int16_t sender, uint8_t code, uint8_t tag, uint8_t error);
+
+	/** Takes over a complete command from the transport. */
+	void takeOver(Arducom* arducom);
+
+	/** Writes the next command to the stream. */
+	void sendNext(Arducom* arducom);
+
+	/** Handles a complete reply frame in the data buffer. */
+	void handleReply(Arducom* arducom);
+
+	/** Called if the reply to the last command has not arrived in time. */
+	void handleTimeout(Arducom* arducom);
+
+	/** Sets the baud rate of the stream. */
+	void switchBaudrate(uint32_t baudrate);
 };
 
 
@@ -186,12 +443,24 @@ public:
 	uint8_t commandCode;
 	int8_t expectedBytes;	// number of expected bytes
 
+	#if ARDUCOM_STATISTICS == 1
+	// execution statistics (handler time in microseconds)
+	uint16_t statCalls;
+	uint16_t statErrors;
+	uint32_t statMinMicros;
+	uint32_t statMaxMicros;
+	uint32_t statTotalMicros;
+	#endif
+
 protected:
 	/** Initializes an ArducomCommand for a variable number of expected data bytes. */
 	ArducomCommand(const uint8_t commandCode) {
 		this->commandCode = commandCode;
 		this->expectedBytes = -1;
 		this->next = 0;
+		#if ARDUCOM_STATISTICS == 1
+		this->resetStatistics();
+		#endif
 	};
 
 	/** Initializes an ArducomCommand for a known number of expected data bytes. */
@@ -199,6 +468,9 @@ protected:
 		this->commandCode = commandCode;
 		this->expectedBytes = expectedBytes;
 		this->next = 0;
+		#if ARDUCOM_STATISTICS == 1
+		this->resetStatistics();
+		#endif
 	};
 
 	/** Is called when the command code of this command has been received and the number of expected bytes match.
@@ -206,17 +478,64 @@ protected:
 	* up to a length of maxBufferSize. The length of the returned data should be placed in dataSize.
 	* The result data is sent back to the master if this method returns a code of 0 (ARDUCOM_OK).
 	* Any other return code is interpreted as an error. Additional error information can be returned in errorInfo.
+	* The destBuffer is part of the transport's send buffer which may be the same memory as the dataBuffer.
+	* Implementations must therefore evaluate their parameters before writing result data.
 	*/
 	virtual int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) = 0;
+
+	/** Slow commands may return ARDUCOM_COMMAND_PENDING from handle() after having evaluated their parameters,
+	* and place an estimate of the remaining time (in units of 10 ms) in errorInfo. The operation is then
+	* continued by calling this method from subsequent Arducom doWork calls. It should do a limited amount
+	* of work and return ARDUCOM_COMMAND_PENDING with a new estimate until the result is ready. The result
+	* data must be placed in destBuffer and its length in dataSize, as with handle().
+	* If the command was tagged, the master receives ARDUCOM_BUSY replies with the estimate in the meantime
+	* and the result is held in a separate slot of the reply cache until the master repeats the command.
+	* Untagged commands are completed immediately by calling this method until the result is ready.
+	*/
+	virtual int8_t resume(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+		return ARDUCOM_NOT_IMPLEMENTED;
+	};
+
+	/** Commands that return a run of reply frames for one request return ARDUCOM_COMMAND_CONTINUE from handle()
+	* after having placed the first frame's data in destBuffer. The frame is sent as a normal reply. As soon as
+	* the transport has passed it on, this method is called to supply the data of the next frame in the same way.
+	* It returns ARDUCOM_COMMAND_CONTINUE while more frames follow and ARDUCOM_OK with the last frame; any other
+	* code is sent as an error reply and ends the run. A new command on the same transport cancels the run.
+	* Only one run can be active at a time; while it is, other transports receive ARDUCOM_BUSY for the
+	* running command and for commands that would start another run.
+	* All frames carry the command code, checksum flag and tag of the request.
+	*/
+	virtual int8_t continueReply(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+		return ARDUCOM_NOT_IMPLEMENTED;
+	};
+
+	/** Commands that may return ARDUCOM_COMMAND_CONTINUE must return true here. While a run is active such
+	* commands receive ARDUCOM_BUSY before handle() is called, so that they do not change their state. */
+	virtual bool repliesInRuns(void) {
+		return false;
+	};
 	
-	/** This method is routinely called by the Arducom doWork method.
-	* It allows the command to do its own housekeeping.
+	/** This method is routinely called by the Arducom doWork method. It allows the command to do its own housekeeping.
+	* Commands that do not override it are no longer called after the first time.
 	*/
-	virtual void doWork(Arducom*) {};
+	virtual void doWork(Arducom* arducom);
 
-	// forms a linked list of supported commands (internal data structure)
+	// forms a linked list of commands that require housekeeping (internal data structure)
 	ArducomCommand* next;
 
+	#if ARDUCOM_STATISTICS == 1
+	void resetStatistics(void) {
+		this->statCalls = 0;
+		this->statErrors = 0;
+		this->statMinMicros = 0xFFFFFFFF;
+		this->statMaxMicros = 0;
+		this->statTotalMicros = 0;
+	};
+
+	/** Records an execution of this command. */
+	void recordStatistics(uint8_t result, uint32_t duration);
+	#endif
+
 friend class Arducom;
 };
 
@@ -241,6 +560,12 @@ public:
 	* within this time window. Otherwise, the transport is being reset which will discard the incomplete command. */
 	Arducom(ArducomTransport* transport, Print* debugPrint = NULL, uint16_t receiveTimeout = ARDUCOM_DEFAULT_TIMEOUT_MS);
 
+	/** Adds a further transport (up to ARDUCOM_MAX_TRANSPORTS). All transports share the commands;
+	* doWork() serves them in turn, and each keeps its own receive state. Note that the reply cache
+	* does not distinguish between transports.
+	* Returns ARDUCOM_OK if the transport could be added. */
+	uint8_t addTransport(ArducomTransport* transport);
+
 	/** Adds the specified command to the internal list. When the command is
 	* received from the master, its handle() method is executed.
 	* Returns ARDUCOM_OK if the command could be added. */
@@ -257,20 +582,116 @@ public:
 	
 	virtual bool isCommandComplete(ArducomTransport* transport);
 
+	/** Returns true while a transport is still transmitting a reply. The transport does not
+	* accept new commands during this time. */
+	bool isSending(void) {
+		for (uint8_t i = 0; i < this->transportCount; i++)
+			if (this->transports[i]->status == ArducomTransport::SENDING)
+				return true;
+		return false;
+	};
+
+	/** Returns the command with the specified command code or NULL if there is no such command. */
+	ArducomCommand* getCommand(uint8_t commandCode);
+
+	/** Returns the number of added commands. */
+	uint8_t getCommandCount(void);
+
+	/** Returns the added command with the given index (in the order of command codes) or NULL. */
+	ArducomCommand* getCommandAt(uint8_t index);
+
+	#if ARDUCOM_STATISTICS == 1
+	// number of transport resets because a command has not been completely received within the receive timeout
+	uint16_t timeoutResets;
+	#endif
+
 protected:
+	ArducomTransport* transports[ARDUCOM_MAX_TRANSPORTS];
+	uint8_t transportCount;
+	// index of the transport that is served first by the next call of doWork()
+	uint8_t nextTransport;
+	// the transport that is being served and its index
 	ArducomTransport* transport;
+	uint8_t current;
+
+	#if ARDUCOM_DISPATCH_TABLE == 1
+	// command lookup table, indexed by command code
+	ArducomCommand* commands[ARDUCOM_MAX_COMMANDCODE + 1];
+	#else
+	// commands sorted by command code
+	ArducomCommand** commands;
+	uint8_t commandCount;
+	#endif
 
-	// linked list of commands
-	ArducomCommand* list;
+	// linked list of commands that require housekeeping
+	ArducomCommand* housekeepingList;
+	// set by ArducomCommand::doWork if the command has not overridden it
+	bool noHousekeeping;
 
-	// performance optimization: store data size of last check
-	int8_t lastDataSize;
+	// performance optimization: store data size of last check (per transport)
+	int8_t lastDataSize[ARDUCOM_MAX_TRANSPORTS];
 
 	uint16_t receiveTimeout;
-	long lastReceiveTime;
+	long lastReceiveTime[ARDUCOM_MAX_TRANSPORTS];
+
+	/** Receives and processes a command from the current transport. */
+	uint8_t serveTransport(void);
+
+	// command that is sending a run of reply frames (see ArducomCommand::continueReply)
+	ArducomCommand* continuedCommand;
+	// index of the transport that receives the run
+	uint8_t continuedTransport;
+	// code byte and tag of the request that started the run
+	uint8_t continuedCode;
+	uint8_t continuedTag;
+
+	/** Sends the next frame of the continued command over the current transport. */
+	void continueReply(void);
 
 	// backup of Print instance for re-enabling debug
 	Print* origDebug;
+
+	#if ARDUCOM_REPLY_CACHE == 1
+	// copy of the last reply to a tagged command
+	uint8_t cache[ARDUCOM_BUFFERSIZE];
+	uint8_t cacheSize;
+	uint8_t cacheCommand;
+	uint8_t cacheTag;
+	// checksum over the request of the cached reply (distinguishes requests that use the same tag)
+	uint8_t cacheRequestSum;
+	uint32_t cacheTime;
+
+	/** Remembers the reply to a tagged command. */
+	void cacheReply(uint8_t commandByte, uint8_t tag, uint8_t requestSum, uint8_t* buffer, uint8_t size);
+
+	// tagged command that is being completed in the background
+	ArducomCommand* pendingCommand;
+	// code byte of the pending command's request
+	uint8_t pendingCode;
+	// reply of the pending command; kept until the master repeats the request, like the cache
+	uint8_t pendingReply[ARDUCOM_BUFFERSIZE];
+	uint8_t pendingSize;
+	uint8_t pendingCommandByte;
+	uint8_t pendingTag;
+	uint8_t pendingRequestSum;
+	uint32_t pendingTime;
+	// last estimate of the remaining time for the pending command (10 ms units)
+	uint8_t pendingEstimate;
+	#if ARDUCOM_STATISTICS == 1
+	// accumulated handler time of the pending command
+	uint32_t pendingMicros;
+	#endif
+
+	/** Continues the pending command and keeps its reply when it is complete. */
+	void resumePending(void);
+	#endif
+
+	/** Builds the reply frame for a command into the buffer. The payload (if any) must already be present
+	* after the header. Code and tag are those of the request. Returns the size of the reply. */
+	uint8_t composeReply(uint8_t* buffer, uint8_t commandCode, uint8_t code, uint8_t tag, uint8_t result, uint8_t errorInfo, uint8_t dataSize);
+
+friend class ArducomTransportProxy;
+friend class ArducomCommand;
 };
 
 /******************************************************************************************
@@ -307,6 +728,44 @@ private:
 	void (*shutdownHook)(uint8_t* dataBuffer);
 };
 
+#if ARDUCOM_STATISTICS == 1
+/** This class implements a command that returns execution statistics (requires ARDUCOM_STATISTICS == 1).
+*   It expects a one-byte command index. The reply contains the number of commands (one byte) and the
+*   number of transport resets due to receive timeouts (two bytes). If the index is lower than the number
+*   of commands, the statistics of the command with this index follow:
+*   command code (one byte), number of calls (two bytes), number of calls that returned an error (two bytes),
+*   minimum, maximum and total handler time in microseconds (four bytes each). All values are LSB first.
+*/
+class ArducomStatisticsCommand: public ArducomCommand {
+public:
+	ArducomStatisticsCommand(uint8_t commandCode = ARDUCOM_STATISTICS_COMMAND) : ArducomCommand(commandCode, 1) {}
+
+	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo);
+};
+#endif
+
+/** This class implements a command that changes the baud rate of a serial connection. It is sent by the
+*   ArducomTransportProxy (see ArducomTransportProxy::setBaudrate()). It expects the new baud rate
+*   as four bytes, LSB first, and returns the same value. The supplied function is called with the
+*   new rate after the reply has been sent.
+*/
+class ArducomSetBaudrate: public ArducomCommand {
+public:
+	ArducomSetBaudrate(ArducomBaudrateFunc setBaudrate, uint8_t commandCode = ARDUCOM_BAUDRATE_COMMAND) : ArducomCommand(commandCode, 4) {
+		this->setBaudrate = setBaudrate;
+		this->baudrate = 0;
+	}
+
+	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) override;
+
+	void doWork(Arducom* arducom) override;
+
+protected:
+	ArducomBaudrateFunc setBaudrate;
+	// baud rate to set after the reply has been sent; 0 if none
+	uint32_t baudrate;
+};
+
 /***************************************
 * Predefined EEPROM access commands
 ****************************************/
@@ -31,10 +31,15 @@
 ESP8266WifiTransport::ESP8266WifiTransport(WiFiNetwork* networks, const char* hostname, WiFiAddresses* staticIPs) : ArducomTransport() {
 	this->server = nullptr;
 	this->port = ARDUCOM_TCP_DEFAULT_PORT;
+	this->current = -1;
+	this->next = 0;
 	this->networks = networks;
 	this->currentNetwork = networks;
 	this->staticIPs = staticIPs;
 	this->hostname = hostname;
+	this->wifiState = WIFI_DISCONNECTED;
+	this->stateStart = 0;
+	this->attemptsLeft = 0;
 	this->processingStart = 0;
 	this->timeoutMs = ARDUCOM_DEFAULT_TIMEOUT_MS;
 	this->connectAttempts = 20;
@@ -56,7 +61,43 @@ void ESP8266WifiTransport::setConnectAttempts(uint8_t connectAttempts) {
 	this->connectAttempts = connectAttempts;
 }
 
+void ESP8266WifiTransport::reset(void) {
+	ArducomTransport::reset();
+	// the rest of an abandoned frame must not be taken for a new command
+	this->discardCurrent();
+}
+
+void ESP8266WifiTransport::discardCurrent(void) {
+	if (this->current < 0)
+		return;
+	WiFiClient& client = this->clients[this->current];
+	while (client.available() > 0)
+		client.read();
+	// continue with the next client
+	this->next = (this->current + 1) % ARDUCOM_ESP8266_MAX_CLIENTS;
+	this->current = -1;
+}
+
+void ESP8266WifiTransport::stopClients(void) {
+	for (uint8_t i = 0; i < ARDUCOM_ESP8266_MAX_CLIENTS; i++)
+		this->clients[i].stop();
+	this->current = -1;
+	this->status = NO_DATA;
+	this->size = 0;
+}
+
 int8_t ESP8266WifiTransport::send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
+	if ((this->current < 0) || !this->clients[this->current].connected()) {
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug)
+			arducom->debug->println(F("Client not connected"));
+		#endif
+		// the client has gone away; discard the reply
+		this->status = NO_DATA;
+		this->size = 0;
+		this->current = -1;
+		return ARDUCOM_NETWORK_ERROR;
+	}
 	#if ARDUCOM_DEBUG_SUPPORT == 1
 	if (arducom->debug) {
 		arducom->debug->print(F("Send: "));
@@ -67,11 +108,46 @@ int8_t ESP8266WifiTransport::send(Arducom* arducom, uint8_t* buffer, uint8_t cou
 		arducom->debug->println();
 	}
 	#endif
-	this->client.write((const uint8_t *)buffer, count);
-	this->client.flush();
-	this->client.stop();
-	this->status = SENT;
-	this->processingStart = 0;
+	// transmit as much as possible now; the rest is sent by doWork()
+	// the connection stays open for further commands
+	this->queueSend(buffer, count);
+	this->writeQueued(&this->clients[this->current]);
+	this->lastActivity[this->current] = millis();
+	return ARDUCOM_OK;
+}
+
+int16_t ESP8266WifiTransport::detach(void) {
+	int16_t sender = this->current;
+	this->current = -1;
+	this->next = (sender + 1) % ARDUCOM_ESP8266_MAX_CLIENTS;
+	this->status = NO_DATA;
+	this->size = 0;
+	return sender;
+}
+
+int8_t ESP8266WifiTransport::sendTo(Arducom* arducom, int16_t sender, uint8_t* buffer, uint8_t count) {
+	if ((sender < 0) || (sender >= ARDUCOM_ESP8266_MAX_CLIENTS) || !this->clients[sender].connected()) {
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug)
+			arducom->debug->println(F("Client not connected"));
+		#endif
+		return ARDUCOM_NETWORK_ERROR;
+	}
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	if (arducom->debug) {
+		arducom->debug->printf("Send to %d: ", sender);
+		for (uint8_t i = 0; i < count; i++) {
+			arducom->debug->print(buffer[i], HEX);
+			arducom->debug->print(F(" "));
+		}
+		arducom->debug->println();
+	}
+	#endif
+	// the data buffer may already hold the next command, so the reply is passed to the
+	// client directly; a reply frame fits into the TCP send buffer
+	if (this->clients[sender].write((const uint8_t *)buffer, count) != count)
+		return ARDUCOM_NETWORK_ERROR;
+	this->lastActivity[sender] = millis();
 	return ARDUCOM_OK;
 }
 
@@ -79,7 +155,6 @@ bool ESP8266WifiTransport::connect(WiFiNetwork* network, Arducom* arducom) {
 	if (!this->networks)
 		return false;
 	WiFi.disconnect();
-	delay(100);
 	// set hostname if specified
 	if (this->hostname)
 		WiFi.hostname(this->hostname);
@@ -98,125 +173,325 @@ bool ESP8266WifiTransport::connect(WiFiNetwork* network, Arducom* arducom) {
 	}
 	WiFi.mode(WIFI_STA);
 	WiFi.begin(network->name, network->password);
-	
-	int attempts = this->connectAttempts;
-	while (attempts > 0 && WiFi.status() != WL_CONNECTED)
-	{
-		delay(this->timeoutMs);
-		#if ARDUCOM_DEBUG_SUPPORT == 1
-		if (arducom->debug)
-			arducom->debug->print(F("."));
-		#endif
-		attempts--;
-	}
-	// not yet connected?
-	if (WiFi.status() != WL_CONNECTED) {
-		return false;
-	}
+	// the connection is established in the background
 	return true;
 }
 
-int8_t ESP8266WifiTransport::doWork(Arducom* arducom) {
-	// sever not set up (disconnected)?
-	if (server == nullptr) {
+bool ESP8266WifiTransport::maintainConnection(Arducom* arducom) {
+	switch (this->wifiState) {
+	case WIFI_DISCONNECTED:
+		// no networks defined?
+		if (!this->currentNetwork || !this->currentNetwork->name)
+			return false;
 		#if ARDUCOM_DEBUG_SUPPORT == 1
 		if (arducom->debug)
 			arducom->debug->printf("Connecting to network: %s\n", this->currentNetwork->name);
 		#endif
 		if (this->connect(this->currentNetwork, arducom)) {
-			// connected, start server
-			server = new WiFiServer(this->port);
-			server->begin();
+			this->wifiState = WIFI_CONNECTING;
+			this->stateStart = millis();
+			this->attemptsLeft = this->connectAttempts;
+		}
+		return false;
+	case WIFI_CONNECTING:
+		if (WiFi.status() == WL_CONNECTED) {
+			this->startListening(arducom);
+			this->wifiState = WIFI_CONNECTED;
+			return true;
+		}
+		if (millis() - this->stateStart < this->timeoutMs)
+			return false;
+		this->stateStart = millis();
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug)
+			arducom->debug->print(F("."));
+		#endif
+		if (this->attemptsLeft > 0)
+			this->attemptsLeft--;
+		if (this->attemptsLeft > 0)
+			return false;
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug)
+			arducom->debug->printf("\nConnecting to network %s failed with status %d\n", this->currentNetwork->name, WiFi.status());
+		#endif
+		// try next network
+		this->currentNetwork++;
+		// end of list?
+		if (!this->currentNetwork->name)
+			// start over
+			this->currentNetwork = this->networks;
+		this->wifiState = WIFI_DISCONNECTED;
+		return false;
+	case WIFI_CONNECTED:
+		// check whether still connected
+		if (WiFi.status() == WL_CONNECTED)
+			return true;
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug)
+			arducom->debug->printf("\nDisconnected from %s with status %d\n", this->currentNetwork->name, WiFi.status());
+		#endif
+		this->stopListening();
+		this->wifiState = WIFI_DISCONNECTED;
+		return false;
+	}
+	return false;
+}
+
+void ESP8266WifiTransport::startListening(Arducom* arducom) {
+	// connected, start server
+	if (this->server == nullptr)
+		this->server = new WiFiServer(this->port);
+	this->server->begin();
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	if (arducom->debug)
+		arducom->debug->printf("Server started, listening at %s:%d\n", WiFi.localIP().toString().c_str(), this->port);
+	#endif
+}
+
+void ESP8266WifiTransport::stopListening(void) {
+	this->stopClients();
+	this->server->stop();
+}
+
+void ESP8266WifiTransport::maintainClients(Arducom* arducom) {
+	// accept a new connection
+	WiFiClient newClient = this->server->available();
+	if (newClient) {
+		uint8_t i = 0;
+		while ((i < ARDUCOM_ESP8266_MAX_CLIENTS) && this->clients[i])
+			i++;
+		if (i < ARDUCOM_ESP8266_MAX_CLIENTS) {
 			#if ARDUCOM_DEBUG_SUPPORT == 1
 			if (arducom->debug)
-				arducom->debug->printf("Server started, listening at %s:%d\n", WiFi.localIP().toString().c_str(), this->port);
+				arducom->debug->printf("Client connected: %d\n", i);
 			#endif
+			this->clients[i] = newClient;
+			this->clients[i].setNoDelay(true);
+			this->lastActivity[i] = millis();
 		} else {
+			// all slots are in use
+			newClient.stop();
+		}
+	}
+	// close disconnected and idle connections (except the one that is being served)
+	for (uint8_t i = 0; i < ARDUCOM_ESP8266_MAX_CLIENTS; i++) {
+		if (!this->clients[i] || (i == this->current))
+			continue;
+		if (!this->clients[i].connected() || (millis() - this->lastActivity[i] > ARDUCOM_ESP8266_IDLE_TIMEOUT_MS)) {
 			#if ARDUCOM_DEBUG_SUPPORT == 1
 			if (arducom->debug)
-				arducom->debug->printf("\nConnecting to network %s failed with status %d\n", this->currentNetwork->name, WiFi.status());
+				arducom->debug->printf("Client disconnected: %d\n", i);
 			#endif
-			// try next network
-			this->currentNetwork++;
-			// end of list?
-			if (!this->currentNetwork || !this->currentNetwork->name)
-				// start over
-				this->currentNetwork = this->networks;
+			this->clients[i].stop();
+		}
+	}
+}
+
+int8_t ESP8266WifiTransport::doWork(Arducom* arducom) {
+	if (!this->maintainConnection(arducom))
+		return ARDUCOM_OK;
+
+	if (this->status == SENDING) {
+		WiFiClient& client = this->clients[this->current];
+		if (!client.connected()) {
+			// the client has gone away; discard the reply
+			this->status = NO_DATA;
+			this->size = 0;
+			this->current = -1;
+			return ARDUCOM_NETWORK_ERROR;
+		}
+		this->writeQueued(&client);
+		this->lastActivity[this->current] = millis();
+		// do not accept new data before the reply has been sent
+		if (this->status == SENDING)
 			return ARDUCOM_OK;
+	}
+
+	this->maintainClients(arducom);
+
+	if (this->current >= 0) {
+		// The current client is released when its reply has been sent.
+		// If the command has been taken over without being answered the client is kept
+		// until the timeout elapses; otherwise the reply could not be sent to it.
+		// (The ArducomTransportProxy class releases the client with detach().)
+		// Incomplete commands are dropped after the timeout, too.
+		if ((this->status == SENT) || !this->clients[this->current].connected()
+			|| ((this->status != HAS_DATA) && (millis() - this->processingStart >= this->timeoutMs))
+			|| ((this->status == HAS_DATA) && (millis() - this->lastActivity[this->current] >= this->timeoutMs))) {
+			if (this->status != SENT) {
+				this->status = NO_DATA;
+				this->size = 0;
+			}
+			this->discardCurrent();
 		}
 	}
 
-	// check whether still connected
-	if (WiFi.status() != WL_CONNECTED) {
+	// select the next client that has data
+	if (this->current < 0) {
+		for (uint8_t i = 0; i < ARDUCOM_ESP8266_MAX_CLIENTS; i++) {
+			uint8_t index = (this->next + i) % ARDUCOM_ESP8266_MAX_CLIENTS;
+			if (this->clients[index] && (this->clients[index].available() > 0)) {
+				this->current = index;
+				this->status = NO_DATA;
+				this->size = 0;
+				break;
+			}
+		}
+		if (this->current < 0)
+			return ARDUCOM_OK;
+	} else
+	// the command is being processed
+	if (this->status != HAS_DATA)
+		return ARDUCOM_OK;
+
+	// read the current client's data in bulk, but not beyond the end of the command
+	// so that a following command stays in the socket buffer
+	WiFiClient& client = this->clients[this->current];
+	int available = client.available();
+	while (available > 0) {
+		// command and code byte first, then the rest of the frame as specified by the code byte
+		uint8_t frameSize = (this->size < 2 ? 2 : ARDUCOM_HEADER_SIZE(this->data[1]) + (this->data[1] & ARDUCOM_LENGTH_MASK));
+		if (this->size >= frameSize)
+			break;
+		if (frameSize > ARDUCOM_BUFFERSIZE) {
+			this->discardCurrent();
+			this->status = TOO_MUCH_DATA;
+			this->size = 0;
+			return ARDUCOM_OVERFLOW;
+		}
+		int count = frameSize - this->size;
+		if (count > available)
+			count = available;
+		count = client.read(&this->data[this->size], count);
+		if (count <= 0)
+			break;
 		#if ARDUCOM_DEBUG_SUPPORT == 1
-		if (arducom->debug)
-			arducom->debug->printf("\nDisconnected from %s with status %d\n", this->currentNetwork->name, WiFi.status());
+		if (arducom->debug) {
+			arducom->debug->print(F("Recv: "));
+			for (int i = 0; i < count; i++) {
+				arducom->debug->print(this->data[this->size + i], HEX);
+				arducom->debug->print(F(" "));
+			}
+			arducom->debug->println();
+		}
 		#endif
-		server->close();
-		server->stop();
-		free(server);
-		server = nullptr;
-		return ARDUCOM_OK;
+		this->size += count;
+		available -= count;
+		this->status = HAS_DATA;
+		this->lastActivity[this->current] = millis();
+		if (arducom->isCommandComplete(this)) {
+			#if ARDUCOM_DEBUG_SUPPORT == 1
+			if (arducom->debug)
+				arducom->debug->printf("Received %d bytes\n", this->size);
+			#endif
+			this->processingStart = millis();
+		}
 	}
+	return ARDUCOM_OK;
+}
 
-	// Processing of the last command must finish within a certain time.
-	// Otherwise we will query for a new client (an old connection will be discarded).
-	// This is mainly to support the ArducomProxyTransport class. Regular Arducom
-	// commands will be immediately processed by the Arducom class, so that send
-	// can be expected to be called immediately after this method returns.
-	// If the method is called repeatedly without send() being called, however,
-	// the client instance will be overwritten with the next client (or an invalid value),
-	// causing the connection to be dropped. Thus, if send is called later, the data
-	// is lost because the client cannot be determined any more.
-	// This mechanism avoids this problem.
-	if (millis() - this->processingStart < this->timeoutMs)
-		return ARDUCOM_OK;
+/******************************************************************************************	
+* ESP8266 UDP transport implementation
+******************************************************************************************/
 
-	// free to listen for new connections
-	
-	// check for incoming connection
-	client = server->available();
-	if (!client)
-		// nothing to do
-		return ARDUCOM_OK;
+ESP8266UDPTransport::ESP8266UDPTransport(WiFiNetwork* networks, const char* hostname, WiFiAddresses* staticIPs) : ESP8266WifiTransport(networks, hostname, staticIPs) {
+	this->port = ARDUCOM_UDP_DEFAULT_PORT;
+	this->remotePort = 0;
+	this->awaitingReply = false;
+}
+
+void ESP8266UDPTransport::reset(void) {
+	ArducomTransport::reset();
+	this->awaitingReply = false;
+}
 
+void ESP8266UDPTransport::startListening(Arducom* arducom) {
+	this->udp.begin(this->port);
 	#if ARDUCOM_DEBUG_SUPPORT == 1
 	if (arducom->debug)
-		arducom->debug->println(F("Client connected, reading data"));
+		arducom->debug->printf("Listening for UDP datagrams at %s:%d\n", WiFi.localIP().toString().c_str(), this->port);
 	#endif
-	if (this->status != HAS_DATA)
+}
+
+void ESP8266UDPTransport::stopListening(void) {
+	this->udp.stop();
+	this->awaitingReply = false;
+	this->status = NO_DATA;
+	this->size = 0;
+}
+
+int8_t ESP8266UDPTransport::send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
+	if (!this->awaitingReply) {
+		// the sender is unknown or the reply is too late
+		this->status = NO_DATA;
 		this->size = 0;
-	uint32_t startTime = millis();
-	while (client.connected() && (millis() - startTime < this->timeoutMs)) {
-		// read incoming data
-		if (client.available()) {
-			this->data[this->size] = client.read();
-			#if ARDUCOM_DEBUG_SUPPORT == 1
-			if (arducom->debug) {
-				arducom->debug->print(F("Recv: "));
-				arducom->debug->print(this->data[this->size], HEX);
-				arducom->debug->println(F(" "));
-			}
-			#endif
-			this->size++;
-			this->status = HAS_DATA;
-			if (this->size > ARDUCOM_BUFFERSIZE) {
-				this->status = TOO_MUCH_DATA;
-				this->size = 0;
-				return ARDUCOM_OVERFLOW;
-			}
-			if (arducom->isCommandComplete(this))
-				break;
-			startTime = millis();
+		return ARDUCOM_NETWORK_ERROR;
+	}
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	if (arducom->debug) {
+		arducom->debug->print(F("Send: "));
+		for (uint8_t i = 0; i < count; i++) {
+			arducom->debug->print(buffer[i], HEX);
+			arducom->debug->print(F(" "));
 		}
+		arducom->debug->println();
+	}
+	#endif
+	this->awaitingReply = false;
+	// the reply is one datagram; it is buffered by the network stack
+	this->status = SENT;
+	this->size = 0;
+	if (!this->udp.beginPacket(this->remoteIP, this->remotePort))
+		return ARDUCOM_NETWORK_ERROR;
+	this->udp.write((const uint8_t *)buffer, count);
+	if (!this->udp.endPacket())
+		return ARDUCOM_NETWORK_ERROR;
+	return ARDUCOM_OK;
+}
+
+int8_t ESP8266UDPTransport::doWork(Arducom* arducom) {
+	if (!this->maintainConnection(arducom))
+		return ARDUCOM_OK;
+
+	// The reply goes to the sender of the last command. Further datagrams are left
+	// in the receive queue until the reply has been sent or the timeout has elapsed
+	// (the ArducomTransportProxy class sends the reply later).
+	if (this->awaitingReply) {
+		if (millis() - this->processingStart < this->timeoutMs)
+			return ARDUCOM_OK;
+		this->awaitingReply = false;
+		this->status = NO_DATA;
+		this->size = 0;
+	}
+
+	int packetSize = this->udp.parsePacket();
+	if (packetSize <= 0)
+		return ARDUCOM_OK;
+	// each datagram contains one command; the master repeats it if necessary
+	if (packetSize > ARDUCOM_BUFFERSIZE) {
+		this->status = TOO_MUCH_DATA;
+		this->size = 0;
+		return ARDUCOM_OVERFLOW;
 	}
-	if (this->status == NO_DATA)
-		return ARDUCOM_TIMEOUT;
+	int count = this->udp.read(this->data, packetSize);
+	if (count <= 0)
+		return ARDUCOM_OK;
 	#if ARDUCOM_DEBUG_SUPPORT == 1
-	if (arducom->debug)
-		arducom->debug->printf("Received %d bytes\n", this->size);
+	if (arducom->debug) {
+		arducom->debug->print(F("Recv: "));
+		for (int i = 0; i < count; i++) {
+			arducom->debug->print(this->data[i], HEX);
+			arducom->debug->print(F(" "));
+		}
+		arducom->debug->println();
+	}
 	#endif
-	this->processingStart = millis();    
+	this->size = count;
+	this->status = HAS_DATA;
+	this->remoteIP = this->udp.remoteIP();
+	this->remotePort = this->udp.remotePort();
+	this->awaitingReply = true;
+	this->processingStart = millis();
 	return ARDUCOM_OK;
 }
 
@@ -26,6 +26,7 @@
 #ifdef ESP8266
 
 #include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
 
 #include <Arducom.h>
 
@@ -44,25 +45,77 @@ struct WiFiAddresses {
 };
 
 
+// The maximum number of simultaneously connected clients.
+#ifndef ARDUCOM_ESP8266_MAX_CLIENTS
+#define ARDUCOM_ESP8266_MAX_CLIENTS			4
+#endif
+
+// Clients that have not sent anything for this time are disconnected.
+#ifndef ARDUCOM_ESP8266_IDLE_TIMEOUT_MS
+#define ARDUCOM_ESP8266_IDLE_TIMEOUT_MS		10000
+#endif
+
 /** This class defines the transport mechanism for Arducom commands over 
  * an ESP266 module.
+ * The WiFi connection is managed by doWork() without blocking: the transport tries the
+ * defined networks in turn, waiting for connectAttempts * timeoutMs milliseconds for each,
+ * and reconnects automatically if the connection is lost. The sketch keeps running
+ * in the meantime.
+ * Up to ARDUCOM_ESP8266_MAX_CLIENTS connections are accepted. They stay open until the
+ * client closes them or has been idle for ARDUCOM_ESP8266_IDLE_TIMEOUT_MS. Clients are
+ * served round-robin, one command at a time; the reply is sent to the client that
+ * sent the command. With an ArducomTransportProxy the commands of several clients
+ * can be pending at the same time. Note that the reply cache does not distinguish between clients.
  */
 class ESP8266WifiTransport: public ArducomTransport {
 
 protected:
+	enum WiFiState {
+		WIFI_DISCONNECTED,
+		WIFI_CONNECTING,
+		WIFI_CONNECTED
+	};
+
 	WiFiServer *server;
 	int port;
-	WiFiClient client;
+	WiFiClient clients[ARDUCOM_ESP8266_MAX_CLIENTS];
+	uint32_t lastActivity[ARDUCOM_ESP8266_MAX_CLIENTS];
+	// index of the client whose command is being processed; -1 if none
+	int8_t current;
+	// index at which the search for the next client with data starts
+	uint8_t next;
 	WiFiNetwork* networks;
 	WiFiNetwork* currentNetwork;
 	WiFiAddresses* staticIPs;
 	const char* hostname;
-	uint32_t processingStart;  // important for proxy functionality
+	WiFiState wifiState;
+	uint32_t stateStart;
+	uint8_t attemptsLeft;
+	uint32_t processingStart;
 	uint32_t timeoutMs;
 	uint8_t connectAttempts;
 
+	/** Starts connecting to the given network; does not wait for the connection to be established. */
 	virtual bool connect(WiFiNetwork* network, Arducom* arducom);
-	
+
+	/** Advances the connection state machine; returns true if the WiFi connection is up. */
+	virtual bool maintainConnection(Arducom* arducom);
+
+	/** Starts accepting commands after the WiFi connection has been established. */
+	virtual void startListening(Arducom* arducom);
+
+	/** Stops accepting commands after the WiFi connection has been lost. */
+	virtual void stopListening(void);
+
+	/** Accepts new connections and closes disconnected and idle ones. */
+	void maintainClients(Arducom* arducom);
+
+	/** Stops all client connections. */
+	void stopClients(void);
+
+	/** Discards the data that is available from the current client and releases it. */
+	void discardCurrent(void);
+
 public:
 	ESP8266WifiTransport(WiFiNetwork* networks, const char* hostname = nullptr, WiFiAddresses* staticIPs = nullptr);
 
@@ -73,12 +126,63 @@ public:
 	/** Sets the timeout for the various network operations. Defaults to ARDUCOM_DEFAULT_TIMEOUT_MS. */
 	virtual void setTimeout(long timeoutMs);
 
-	/** Sets the number of connection attempts until a different network is attempted (if defined). */
+	/** Sets the number of timeout periods to wait for a connection until a different network is attempted (if defined). */
 	virtual void setConnectAttempts(uint8_t connectAttempts);
 
 	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count) override;
 
 	virtual int8_t doWork(Arducom* arducom) override;
+
+	/** Releases the current client so that the next command can be received while an
+	*   ArducomTransportProxy waits for the reply. Returns the index of the client. */
+	virtual int16_t detach(void) override;
+
+	/** Sends the reply to a command that has been released with detach() to its client. */
+	virtual int8_t sendTo(Arducom* arducom, int16_t sender, uint8_t* buffer, uint8_t count) override;
+
+	/** Resets the transport; the rest of an incomplete frame is discarded. */
+	virtual void reset(void) override;
+};
+
+/** This class defines the transport mechanism for Arducom commands over UDP
+ * on an ESP266 module. Each datagram contains one command; the reply is sent
+ * as one datagram to the sender. There is no connection setup, so one request
+ * and one reply packet are exchanged per command. The master must use tagged
+ * commands to detect lost datagrams and to match replies to commands; the reply
+ * cache makes sure that repeated commands are not executed twice.
+ * The WiFi connection is managed as in ESP8266WifiTransport.
+ * The default port is ARDUCOM_UDP_DEFAULT_PORT.
+ */
+class ESP8266UDPTransport: public ESP8266WifiTransport {
+
+protected:
+	WiFiUDP udp;
+	// sender of the command that is being processed
+	IPAddress remoteIP;
+	uint16_t remotePort;
+	bool awaitingReply;
+
+	virtual void startListening(Arducom* arducom) override;
+
+	virtual void stopListening(void) override;
+
+public:
+	ESP8266UDPTransport(WiFiNetwork* networks, const char* hostname = nullptr, WiFiAddresses* staticIPs = nullptr);
+
+	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count) override;
+
+	virtual int8_t doWork(Arducom* arducom) override;
+
+	/** The sender is kept until the reply has been sent; further datagrams wait in the receive queue. */
+	virtual int16_t detach(void) override {
+		return 0;
+	};
+
+	virtual int8_t sendTo(Arducom* arducom, int16_t sender, uint8_t* buffer, uint8_t count) override {
+		return this->send(arducom, buffer, count);
+	};
+
+	virtual void reset(void) override;
 };
 
 #endif		// def ESP8266
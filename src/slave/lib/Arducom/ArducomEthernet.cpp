@@ -29,18 +29,41 @@
 #include <ArducomEthernet.h>
 
 ArducomTransportEthernet::ArducomTransportEthernet(uint16_t port): ArducomTransport(), server(port) {
+	this->current = -1;
+	this->next = 0;
 	this->initOK = false;
 }
 
+void ArducomTransportEthernet::reset(void) {
+	ArducomTransport::reset();
+	// the rest of an abandoned frame must not be taken for a new command
+	this->discardCurrent();
+}
+
+void ArducomTransportEthernet::discardCurrent(void) {
+	if (this->current < 0)
+		return;
+	EthernetClient& client = this->clients[this->current];
+	while (client.available() > 0)
+		client.read();
+	// continue with the next client
+	this->next = (this->current + 1) % ARDUCOM_ETHERNET_MAX_CLIENTS;
+	this->current = -1;
+}
+
 int8_t ArducomTransportEthernet::send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
-	if (!this->client.connected()) {
+	if ((this->current < 0) || !this->clients[this->current].connected()) {
 		#if ARDUCOM_DEBUG_SUPPORT == 1
 		if (arducom->debug)
 			arducom->debug->println(F("Client not connected"));
 		#endif
+		// the client has gone away; discard the reply
+		this->status = NO_DATA;
+		this->size = 0;
+		this->current = -1;
 		return ARDUCOM_NETWORK_ERROR;
 	}
-	#ifdef ARDUCOM_DEBUG_SUPPORT
+	#if ARDUCOM_DEBUG_SUPPORT == 1
 	if (arducom->debug) {
 		arducom->debug->print(F("Send: "));
 		for (uint8_t i = 0; i < count; i++) {
@@ -50,14 +73,50 @@ int8_t ArducomTransportEthernet::send(Arducom* arducom, uint8_t* buffer, uint8_t
 		arducom->debug->println();
 	}
 	#endif
-	this->client.write((const uint8_t *)buffer, count);
-	this->client.flush();
-	this->lastSendTime = millis();
-	this->status = SENT;
-	this->size = 0;
+	// transmit as much as possible now; the rest is sent by doWork()
+	this->queueSend(buffer, count);
+	this->writeQueued(&this->clients[this->current]);
+	this->lastActivity[this->current] = millis();
 	return ARDUCOM_OK;
 }
 
+void ArducomTransportEthernet::maintainClients(Arducom* arducom) {
+	// accept a new connection
+	EthernetClient newClient = this->server.accept();
+	if (newClient) {
+		uint8_t i = 0;
+		while ((i < ARDUCOM_ETHERNET_MAX_CLIENTS) && this->clients[i])
+			i++;
+		if (i < ARDUCOM_ETHERNET_MAX_CLIENTS) {
+			#if ARDUCOM_DEBUG_SUPPORT == 1
+			if (arducom->debug) {
+				arducom->debug->print(F("Client connected: "));
+				arducom->debug->println((int)i);
+			}
+			#endif
+			this->clients[i] = newClient;
+			this->lastActivity[i] = millis();
+		} else {
+			// all slots are in use
+			newClient.stop();
+		}
+	}
+	// close disconnected and idle connections (except the one that is being served)
+	for (uint8_t i = 0; i < ARDUCOM_ETHERNET_MAX_CLIENTS; i++) {
+		if (!this->clients[i] || (i == this->current))
+			continue;
+		if (!this->clients[i].connected() || (millis() - this->lastActivity[i] > ARDUCOM_ETHERNET_IDLE_TIMEOUT_MS)) {
+			#if ARDUCOM_DEBUG_SUPPORT == 1
+			if (arducom->debug) {
+				arducom->debug->print(F("Client disconnected: "));
+				arducom->debug->println((int)i);
+			}
+			#endif
+			this->clients[i].stop();
+		}
+	}
+}
+
 int8_t ArducomTransportEthernet::doWork(Arducom* arducom) {
 	// initialize server on first call
 	if (!this->initOK) {
@@ -67,36 +126,83 @@ int8_t ArducomTransportEthernet::doWork(Arducom* arducom) {
 		#endif
 		this->server.begin();
  		this->initOK = true;
-	} else {
-		// get a connecting client
-		if (server.available())
-			this->client = server.available();
-		// get data from a connected client
-		if (this->client.available() > 0) {
-			if (this->status != HAS_DATA)
+		return ARDUCOM_OK;
+	}
+
+	if (this->status == SENDING) {
+		EthernetClient& client = this->clients[this->current];
+		if (!client.connected()) {
+			// the client has gone away; discard the reply
+			this->status = NO_DATA;
+			this->size = 0;
+			this->current = -1;
+			return ARDUCOM_NETWORK_ERROR;
+		}
+		this->writeQueued(&client);
+		this->lastActivity[this->current] = millis();
+		// do not accept new data before the reply has been sent
+		if (this->status == SENDING)
+			return ARDUCOM_OK;
+	}
+
+	this->maintainClients(arducom);
+
+	// the current command has been answered or discarded?
+	if ((this->current >= 0) && (this->status != HAS_DATA)) {
+		this->next = (this->current + 1) % ARDUCOM_ETHERNET_MAX_CLIENTS;
+		this->current = -1;
+	}
+
+	// select the next client that has data
+	if (this->current < 0) {
+		for (uint8_t i = 0; i < ARDUCOM_ETHERNET_MAX_CLIENTS; i++) {
+			uint8_t index = (this->next + i) % ARDUCOM_ETHERNET_MAX_CLIENTS;
+			if (this->clients[index] && (this->clients[index].available() > 0)) {
+				this->current = index;
+				this->status = NO_DATA;
 				this->size = 0;
-			// read incoming data
-			while (this->client.available()) {
-				this->data[this->size] = this->client.read();
-				#ifdef ARDUCOM_DEBUG_SUPPORT
-				if (arducom->debug) {
-					arducom->debug->print(F("Recv: "));
-					arducom->debug->print(this->data[this->size], HEX);
-					arducom->debug->println(F(" "));
-				}
-				#endif
-				this->size++;
-				if (this->size > ARDUCOM_BUFFERSIZE) {
-					this->status = TOO_MUCH_DATA;
-					return ARDUCOM_OVERFLOW;
-				}
-				this->status = HAS_DATA;
+				break;
 			}
-		} else if ((this->lastSendTime > 0) && (millis() - this->lastSendTime > 1000)) {
-			this->client.stop();		// disconnect
-			this->initOK = false;
-			this->lastSendTime = 0;
 		}
+		if (this->current < 0)
+			return ARDUCOM_OK;
+	}
+
+	// read the current client's data in bulk, but not beyond the end of the frame
+	// so that a following command stays in the socket buffer
+	EthernetClient& client = this->clients[this->current];
+	int available = client.available();
+	while (available > 0) {
+		// command and code byte first, then the rest of the frame as specified by the code byte
+		uint8_t frameSize = (this->size < 2 ? 2 : ARDUCOM_HEADER_SIZE(this->data[1]) + (this->data[1] & ARDUCOM_LENGTH_MASK));
+		if (this->size >= frameSize)
+			break;
+		if (frameSize > ARDUCOM_BUFFERSIZE) {
+			this->discardCurrent();
+			this->status = TOO_MUCH_DATA;
+			this->size = 0;
+			return ARDUCOM_OVERFLOW;
+		}
+		int count = frameSize - this->size;
+		if (count > available)
+			count = available;
+		count = client.read(&this->data[this->size], count);
+		if (count <= 0)
+			break;
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug) {
+			arducom->debug->print(F("Recv: "));
+			for (int i = 0; i < count; i++) {
+				arducom->debug->print(this->data[this->size + i], HEX);
+				arducom->debug->print(F(" "));
+			}
+			arducom->debug->println();
+		}
+		#endif
+		this->size += count;
+		available -= count;
+		this->status = HAS_DATA;
+		this->lastActivity[this->current] = millis();
 	}
 	return ARDUCOM_OK;
 }
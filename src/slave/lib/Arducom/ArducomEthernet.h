@@ -28,6 +28,18 @@
 
 #include <Arducom.h>
 
+// The maximum number of simultaneously connected clients. The server needs one socket
+// for listening, so this should be one less than the number of hardware sockets
+// (four on the W5100, eight on the W5200/W5500).
+#ifndef ARDUCOM_ETHERNET_MAX_CLIENTS
+#define ARDUCOM_ETHERNET_MAX_CLIENTS		3
+#endif
+
+// Clients that have not sent anything for this time are disconnected.
+#ifndef ARDUCOM_ETHERNET_IDLE_TIMEOUT_MS
+#define ARDUCOM_ETHERNET_IDLE_TIMEOUT_MS	10000
+#endif
+
 /** This class defines the transport mechanism for Arducom commands over 
  * an Ethernet LAN module.
  * Ethernet must be initialized before using this transport by calling
@@ -42,18 +54,23 @@
  *   digitalWrite(9, LOW);
  * Consequently those pins cannot be used for IO any more.
  *
- * This class starts a listening server on the given port. It accepts data
- * from connecting clients and turns it over to Arducom. Returned data
- * is sent back to the client.
- * This class does not close connections. It is the responsibility of the
- * client to do that.
+ * This class starts a listening server on the given port. It accepts up to
+ * ARDUCOM_ETHERNET_MAX_CLIENTS connections (requires Ethernet library 2.0 or newer).
+ * Clients are served round-robin, one command at a time: the transport reads
+ * exactly one frame from a client into the buffer, and the reply is sent back
+ * to this client. Data of the other clients waits in the module's socket buffers
+ * in the meantime, so several masters can use the device concurrently.
+ * Connections stay open until the client closes them or has been idle for
+ * ARDUCOM_ETHERNET_IDLE_TIMEOUT_MS. Further connection attempts are rejected.
+ * Note that the reply cache does not distinguish between clients; concurrent
+ * masters should not both use tagged commands.
  * Make sure to call Ethernet.maintain() in your loop if using dynamic
  * IP addresses. However, it may be more useful to use a static IP address.
 */
 class ArducomTransportEthernet: public ArducomTransport {
 
 public:
-	/** Sets up the transport as a WLAN device that registers with the given network. */
+	/** Sets up the transport to listen on the given TCP port. */
 	ArducomTransportEthernet(uint16_t port = ARDUCOM_TCP_DEFAULT_PORT);
 
 	virtual int8_t doWork(Arducom* arducom);
@@ -61,11 +78,24 @@ public:
 	/** Prepares the transport to send count bytes from the buffer; returns -1 in case of errors. */
 	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count);
 
+	/** Resets the transport; the rest of an incomplete frame is discarded. */
+	virtual void reset(void);
+
 protected:
 	EthernetServer server;
-	EthernetClient client;
+	EthernetClient clients[ARDUCOM_ETHERNET_MAX_CLIENTS];
+	uint32_t lastActivity[ARDUCOM_ETHERNET_MAX_CLIENTS];
+	// index of the client whose frame is being received or answered; -1 if none
+	int8_t current;
+	// index at which the search for the next client with data starts
+	uint8_t next;
 	bool initOK;
-	uint32_t lastSendTime;
+
+	/** Accepts new connections and closes disconnected and idle ones. */
+	void maintainClients(Arducom* arducom);
+
+	/** Discards the data that is available from the current client and releases it. */
+	void discardCurrent(void);
 };
 
 #endif
@@ -32,6 +32,7 @@ ArducomFTP* _arducomFTP;
 int8_t ArducomFTP::init(Arducom* arducom, SdFat* sdFat, uint8_t commandBase) {
 	_arducomFTP = 0;
 	this->sdFat = sdFat;
+	this->resetRead();
 
 	int8_t result = arducom->addCommand(new ArducomFTPInit(ARDUCOM_FTP_COMMAND_INIT + commandBase));
 	if (result != ARDUCOM_OK)
@@ -65,6 +66,18 @@ int8_t ArducomFTP::init(Arducom* arducom, SdFat* sdFat, uint8_t commandBase) {
 	if (result != ARDUCOM_OK)
 		return result;
 
+	result = arducom->addCommand(new ArducomFTPReadBlocks(ARDUCOM_FTP_COMMAND_READBLOCKS + commandBase));
+	if (result != ARDUCOM_OK)
+		return result;
+
+	result = arducom->addCommand(new ArducomFTPListDir(ARDUCOM_FTP_COMMAND_LISTDIR + commandBase));
+	if (result != ARDUCOM_OK)
+		return result;
+
+	result = arducom->addCommand(new ArducomFTPCRC(ARDUCOM_FTP_COMMAND_CRC + commandBase));
+	if (result != ARDUCOM_OK)
+		return result;
+
 	// store singleton instance
 	_arducomFTP = this;
 
@@ -72,6 +85,67 @@ int8_t ArducomFTP::init(Arducom* arducom, SdFat* sdFat, uint8_t commandBase) {
 }
 
 
+void ArducomFTP::resetRead(void) {
+	this->filePosition = ARDUCOM_FTP_POSITION_UNKNOWN;
+	#if ARDUCOM_FTP_READAHEAD_SIZE > 0
+	this->readAheadSize = 0;
+	#endif
+}
+
+int16_t ArducomFTP::readFile(uint32_t position, uint8_t* buffer, uint8_t count, uint8_t* errorInfo) {
+	#if ARDUCOM_FTP_READAHEAD_SIZE > 0
+	uint8_t total = 0;
+	while (total < count) {
+		// position outside of the read-ahead buffer?
+		if ((position < this->readAheadStart) || (position >= this->readAheadStart + this->readAheadSize)) {
+			// fill the buffer with the sector that contains the position
+			uint32_t start = position - (position % ARDUCOM_FTP_READAHEAD_SIZE);
+			// seek only if the file is not already there
+			if ((start != this->filePosition) && !this->openFile.seekSet(start)) {
+				this->resetRead();
+				*errorInfo = ARDUCOM_FTP_POSITION_INVALID;
+				return -1;
+			}
+			int readBytes = this->openFile.read(this->readAhead, ARDUCOM_FTP_READAHEAD_SIZE);
+			if (readBytes < 0) {
+				this->resetRead();
+				*errorInfo = ARDUCOM_FTP_READ_ERROR;
+				return -1;
+			}
+			this->readAheadStart = start;
+			this->readAheadSize = readBytes;
+			this->filePosition = start + readBytes;
+			// end of file?
+			if (position >= this->filePosition)
+				break;
+		}
+		uint16_t offset = position - this->readAheadStart;
+		uint8_t chunk = count - total;
+		if (chunk > this->readAheadSize - offset)
+			chunk = this->readAheadSize - offset;
+		memcpy(&buffer[total], &this->readAhead[offset], chunk);
+		total += chunk;
+		position += chunk;
+	}
+	return total;
+	#else
+	// seek only if the request does not continue the previous read
+	if ((position != this->filePosition) && !this->openFile.seekSet(position)) {
+		this->resetRead();
+		*errorInfo = ARDUCOM_FTP_POSITION_INVALID;
+		return -1;
+	}
+	int readBytes = this->openFile.read(buffer, count);
+	if (readBytes < 0) {
+		this->resetRead();
+		*errorInfo = ARDUCOM_FTP_READ_ERROR;
+		return -1;
+	}
+	this->filePosition = position + readBytes;
+	return readBytes;
+	#endif
+}
+
 ArducomFTPInit::ArducomFTPInit(uint8_t commandCode) : ArducomCommand(commandCode) {
 }
 
@@ -150,29 +224,14 @@ int8_t ArducomFTPInit::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dat
 	return ARDUCOM_OK;
 }
 
-ArducomFTPListFiles::ArducomFTPListFiles(uint8_t commandCode) : ArducomCommand(commandCode) {
-}
-
-int8_t ArducomFTPListFiles::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
-	if (!_arducomFTP) {
-		*errorInfo = ARDUCOM_FTP_NOT_INITIALIZED;
-		return ARDUCOM_FUNCTION_ERROR;
-	}
-	
-	// assume no files left to enumerate
-	*dataSize = 0;
-	
-	SdFile entry;
-	if (!entry.openNext(_arducomFTP->sdFat->vwd(), O_READ))
-		return ARDUCOM_OK;
-
+/** Places the information about the directory entry into the buffer (ARDUCOM_FTP_FILEINFO_SIZE bytes).
+* Returns false if the name cannot be determined. */
+static bool putFileInfo(SdFile* entry, uint8_t* destBuffer) {
 	// transfer name
 	char name[13];
 	memset(name, 0, 13);
-	if (!entry.getSFN(name)) {
-		*errorInfo = ARDUCOM_FTP_READ_ERROR;
-		return ARDUCOM_FUNCTION_ERROR;
-	}
+	if (!entry->getSFN(name))
+		return false;
 
 	uint8_t pos = 0;
 	for (uint8_t i = 0; i < 12; i++) {
@@ -181,28 +240,103 @@ int8_t ArducomFTPListFiles::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t
 	// pad with NUL
 	destBuffer[pos++] = '\0';
 	// directory flag (one byte)
-	destBuffer[pos++] = (entry.isDir() ? 1 : 0);
+	destBuffer[pos++] = (entry->isDir() ? 1 : 0);
 	// size (four bytes)
 	uint32_t* size = (uint32_t*)&destBuffer[pos];
-	*size = entry.fileSize();
+	*size = entry->fileSize();
 	pos += 4;
 	// modification date
 	dir_t dir;
-	entry.dirEntry(&dir);
+	entry->dirEntry(&dir);
 	uint16_t* lastWriteDate = (uint16_t*)&destBuffer[pos];
 	*lastWriteDate = dir.lastWriteDate;
 	pos += 2;
 	uint16_t* lastWriteTime = (uint16_t*)&destBuffer[pos];
 	*lastWriteTime = dir.lastWriteTime;
-	pos += 2;
+	return true;
+}
+
+ArducomFTPListFiles::ArducomFTPListFiles(uint8_t commandCode) : ArducomCommand(commandCode) {
+}
+
+int8_t ArducomFTPListFiles::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	if (!_arducomFTP) {
+		*errorInfo = ARDUCOM_FTP_NOT_INITIALIZED;
+		return ARDUCOM_FUNCTION_ERROR;
+	}
+	
+	// assume no files left to enumerate
+	*dataSize = 0;
+	
+	SdFile entry;
+	if (!entry.openNext(_arducomFTP->sdFat->vwd(), O_READ))
+		return ARDUCOM_OK;
+
+	if (!putFileInfo(&entry, destBuffer)) {
+		*errorInfo = ARDUCOM_FTP_READ_ERROR;
+		return ARDUCOM_FUNCTION_ERROR;
+	}
 	
 	entry.close();
 
-	*dataSize = pos;
+	*dataSize = ARDUCOM_FTP_FILEINFO_SIZE;
 
 	return ARDUCOM_OK;
 }
 
+ArducomFTPListDir::ArducomFTPListDir(uint8_t commandCode) : ArducomCommand(commandCode, 0) {
+}
+
+int8_t ArducomFTPListDir::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	if (!_arducomFTP) {
+		*errorInfo = ARDUCOM_FTP_NOT_INITIALIZED;
+		return ARDUCOM_FUNCTION_ERROR;
+	}
+
+	// the frame must hold the continuation marker and at least one entry
+	if (maxBufferSize < ARDUCOM_FTP_FILEINFO_SIZE + 1) {
+		*errorInfo = ARDUCOM_FTP_FILEINFO_SIZE + 1;
+		return ARDUCOM_BUFFER_OVERRUN;
+	}
+
+	// always list from the start
+	_arducomFTP->sdFat->vwd()->rewind();
+	return this->listEntries(destBuffer, dataSize, maxBufferSize, errorInfo);
+}
+
+int8_t ArducomFTPListDir::continueReply(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	return this->listEntries(destBuffer, dataSize, maxBufferSize, errorInfo);
+}
+
+bool ArducomFTPListDir::repliesInRuns(void) {
+	return true;
+}
+
+int8_t ArducomFTPListDir::listEntries(uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	// the first byte is the continuation marker
+	uint8_t pos = 1;
+	bool more = true;
+	while (pos + ARDUCOM_FTP_FILEINFO_SIZE <= maxBufferSize) {
+		SdFile entry;
+		if (!entry.openNext(_arducomFTP->sdFat->vwd(), O_READ)) {
+			// no entries left
+			more = false;
+			break;
+		}
+		bool ok = putFileInfo(&entry, &destBuffer[pos]);
+		entry.close();
+		if (!ok) {
+			*errorInfo = ARDUCOM_FTP_READ_ERROR;
+			return ARDUCOM_FUNCTION_ERROR;
+		}
+		pos += ARDUCOM_FTP_FILEINFO_SIZE;
+	}
+	destBuffer[0] = (more ? 1 : 0);
+	*dataSize = pos;
+
+	return (more ? ARDUCOM_COMMAND_CONTINUE : ARDUCOM_OK);
+}
+
 ArducomFTPRewind::ArducomFTPRewind(uint8_t commandCode) : ArducomCommand(commandCode) {
 }
 
@@ -300,6 +434,7 @@ int8_t ArducomFTPOpenRead::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t*
 		
 	if (_arducomFTP->openFile.isOpen())
 		_arducomFTP->openFile.close();
+	_arducomFTP->resetRead();
 		
 	if (!_arducomFTP->openFile.open(filename, O_READ)) {
 		*errorInfo = ARDUCOM_FTP_FILE_OPEN_ERROR;
@@ -344,18 +479,137 @@ int8_t ArducomFTPReadFile::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t*
 	}
 	#endif
 
-	if (!_arducomFTP->openFile.seekSet(position)) {
-		*errorInfo = ARDUCOM_FTP_POSITION_INVALID;
+	int16_t readBytes = _arducomFTP->readFile(position, destBuffer, maxBufferSize, errorInfo);
+	if (readBytes < 0)
+		return ARDUCOM_FUNCTION_ERROR;
+	
+	*dataSize = readBytes;
+	
+	return ARDUCOM_OK;
+}
+
+ArducomFTPReadBlocks::ArducomFTPReadBlocks(uint8_t commandCode) : ArducomCommand(commandCode, 5) {
+	this->position = 0;
+	this->remaining = 0;
+}
+
+int8_t ArducomFTPReadBlocks::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	if (!_arducomFTP) {
+		*errorInfo = ARDUCOM_FTP_NOT_INITIALIZED;
+		return ARDUCOM_FUNCTION_ERROR;
+	}
+
+	if (!_arducomFTP->openFile.isOpen()) {
+		*errorInfo = ARDUCOM_FTP_FILE_NOT_OPEN;
 		return ARDUCOM_FUNCTION_ERROR;
 	}
 	
-	int readBytes = _arducomFTP->openFile.read(destBuffer, maxBufferSize);
-	if (readBytes < 0) {
-		*errorInfo = ARDUCOM_FTP_READ_ERROR;
+	uint32_t position = *((uint32_t*)dataBuffer);
+	uint8_t count = dataBuffer[4];
+	
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	if (arducom->debug) {
+		arducom->debug->print(F("Read pos: "));
+		arducom->debug->print(position);
+		arducom->debug->print(F(" frames: "));
+		arducom->debug->println(count);
+	}
+	#endif
+
+	this->position = position;
+	this->remaining = (count > 0 ? count - 1 : 0);
+	return this->readBlock(destBuffer, dataSize, maxBufferSize, errorInfo);
+}
+
+int8_t ArducomFTPReadBlocks::continueReply(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	// the file may have been closed in the meantime
+	if (!_arducomFTP->openFile.isOpen()) {
+		*errorInfo = ARDUCOM_FTP_FILE_NOT_OPEN;
 		return ARDUCOM_FUNCTION_ERROR;
 	}
+
+	this->remaining--;
+	return this->readBlock(destBuffer, dataSize, maxBufferSize, errorInfo);
+}
+
+bool ArducomFTPReadBlocks::repliesInRuns(void) {
+	return true;
+}
+
+int8_t ArducomFTPReadBlocks::readBlock(uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	// the first byte of the frame is the number of frames that follow
+	int16_t readBytes = _arducomFTP->readFile(this->position, &destBuffer[1], maxBufferSize - 1, errorInfo);
+	if (readBytes < 0)
+		return ARDUCOM_FUNCTION_ERROR;
+	this->position += readBytes;
 	
-	*dataSize = readBytes;
+	// end of file reached?
+	if (readBytes < maxBufferSize - 1)
+		this->remaining = 0;
+	destBuffer[0] = this->remaining;
+	*dataSize = readBytes + 1;
+	
+	return (this->remaining > 0 ? ARDUCOM_COMMAND_CONTINUE : ARDUCOM_OK);
+}
+
+// CRC32 lookup table for four bits at a time (64 bytes of flash instead of 1 kB for a byte table)
+const uint32_t crcNibbleTable[16] PROGMEM = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+ArducomFTPCRC::ArducomFTPCRC(uint8_t commandCode) : ArducomCommand(commandCode, 12) {
+}
+
+int8_t ArducomFTPCRC::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo) {
+	if (!_arducomFTP) {
+		*errorInfo = ARDUCOM_FTP_NOT_INITIALIZED;
+		return ARDUCOM_FUNCTION_ERROR;
+	}
+
+	if (!_arducomFTP->openFile.isOpen()) {
+		*errorInfo = ARDUCOM_FTP_FILE_NOT_OPEN;
+		return ARDUCOM_FUNCTION_ERROR;
+	}
+	
+	uint32_t position = *((uint32_t*)dataBuffer);
+	uint32_t length = *((uint32_t*)&dataBuffer[4]);
+	uint32_t crc = ~*((uint32_t*)&dataBuffer[8]);
+	
+	#if ARDUCOM_DEBUG_SUPPORT == 1
+	if (arducom->debug) {
+		arducom->debug->print(F("CRC pos: "));
+		arducom->debug->print(position);
+		arducom->debug->print(F(" length: "));
+		arducom->debug->println(length);
+	}
+	#endif
+
+	if (length > ARDUCOM_FTP_CRC_LIMIT)
+		length = ARDUCOM_FTP_CRC_LIMIT;
+
+	// the reply buffer serves as read buffer
+	uint32_t processed = 0;
+	while (processed < length) {
+		uint8_t count = (length - processed > maxBufferSize ? maxBufferSize : length - processed);
+		int16_t readBytes = _arducomFTP->readFile(position + processed, destBuffer, count, errorInfo);
+		if (readBytes < 0)
+			return ARDUCOM_FUNCTION_ERROR;
+		for (int16_t i = 0; i < readBytes; i++) {
+			crc ^= destBuffer[i];
+			crc = (crc >> 4) ^ pgm_read_dword(&crcNibbleTable[crc & 0x0F]);
+			crc = (crc >> 4) ^ pgm_read_dword(&crcNibbleTable[crc & 0x0F]);
+		}
+		processed += readBytes;
+		// end of file reached?
+		if (readBytes < count)
+			break;
+	}
+	crc = ~crc;
+
+	*((uint32_t*)destBuffer) = crc;
+	*((uint32_t*)&destBuffer[4]) = processed;
+	*dataSize = 8;
 	
 	return ARDUCOM_OK;
 }
@@ -375,6 +629,7 @@ int8_t ArducomFTPCloseFile::handle(Arducom* arducom, uint8_t* dataBuffer, int8_t
 	}
 
 	_arducomFTP->openFile.close();
+	_arducomFTP->resetRead();
 	
 	return ARDUCOM_OK;
 }
@@ -49,11 +49,35 @@
 #define ARDUCOM_FTP_COMMAND_READFILE	5
 #define ARDUCOM_FTP_COMMAND_CLOSEFILE	6
 #define ARDUCOM_FTP_COMMAND_DELETE	7
+#define ARDUCOM_FTP_COMMAND_READBLOCKS	8
+#define ARDUCOM_FTP_COMMAND_LISTDIR	9
+#define ARDUCOM_FTP_COMMAND_CRC		10
+
+// size of a directory entry as returned by the list commands
+#define ARDUCOM_FTP_FILEINFO_SIZE		22
 
 #define ARDUCOM_FTP_DEFAULT_COMMANDBASE	60
 
+// Size of the read-ahead buffer for file reads (one SD sector). Consecutive reads are served from this buffer.
+// On AVR the RAM is too scarce; SdFat's own block cache holds the current sector there anyway.
+#ifndef ARDUCOM_FTP_READAHEAD_SIZE
+#if defined(__AVR__)
+#define ARDUCOM_FTP_READAHEAD_SIZE		0
+#else
+#define ARDUCOM_FTP_READAHEAD_SIZE		512
+#endif
+#endif
+
+// Maximum number of bytes of the open file that one CRC command processes. The command takes
+// some milliseconds per SD sector, so the limit keeps the reply within the master's timeout.
+#ifndef ARDUCOM_FTP_CRC_LIMIT
+#define ARDUCOM_FTP_CRC_LIMIT			16384
+#endif
+
 #ifdef ARDUINO
 
+#define ARDUCOM_FTP_POSITION_UNKNOWN	0xFFFFFFFF
+
 /** This class adds the ArducomFTP commands to the supplied Arducom instance.
 */
 class ArducomFTP {
@@ -62,6 +86,24 @@ public:
 	SdFile openFile;
  
 	int8_t init(Arducom* arducom, SdFat* sdFat, uint8_t commandBase = ARDUCOM_FTP_DEFAULT_COMMANDBASE);
+
+	/** Reads up to count bytes of the open file from the given position into the buffer.
+	* Sequential reads do not seek. Returns the number of bytes read (less than count at the end
+	* of the file), or -1 in case of an error with the FTP status code in errorInfo. */
+	int16_t readFile(uint32_t position, uint8_t* buffer, uint8_t count, uint8_t* errorInfo);
+
+	/** Must be called when the open file changes or is read by other means than readFile(). */
+	void resetRead(void);
+
+protected:
+	// position of the open file after the last read; ARDUCOM_FTP_POSITION_UNKNOWN after a change
+	uint32_t filePosition;
+	#if ARDUCOM_FTP_READAHEAD_SIZE > 0
+	// file data starting at readAheadStart
+	uint8_t readAhead[ARDUCOM_FTP_READAHEAD_SIZE];
+	uint32_t readAheadStart;
+	uint16_t readAheadSize;
+	#endif
 };
 
 // singleton for commands to access common information
@@ -86,6 +128,25 @@ public:
 	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo);
 };
 
+/** This class implements a command to read all file infos of the current directory with one request.
+* The reply is a run of frames. Each frame starts with a byte that is 1 if further frames follow and
+* 0 for the last frame, followed by as many file infos as fit into the frame.
+*/
+class ArducomFTPListDir: public ArducomCommand {
+public:
+	ArducomFTPListDir(uint8_t commandCode);
+	
+	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo);
+
+	int8_t continueReply(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo);
+
+	bool repliesInRuns(void);
+
+protected:
+	/** Places the file infos of the next directory entries into the frame. */
+	int8_t listEntries(uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo);
+};
+
 /** This class implements a command to rewind the current directory after listing files.
 */
 class ArducomFTPRewind: public ArducomCommand {
@@ -122,6 +183,44 @@ public:
 	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo);
 };
 
+/** This class implements a command to read consecutive sections of the currently open file.
+* It expects the start position (4 bytes, LSB first) and the maximum number of frames (1 byte).
+* The reply is a run of frames; each frame contains the number of frames that still follow,
+* followed by as much file data as fits into the frame. The run ends early at the end of the file.
+*/
+class ArducomFTPReadBlocks: public ArducomCommand {
+public:
+	ArducomFTPReadBlocks(uint8_t commandCode);
+	
+	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo);
+
+	int8_t continueReply(Arducom* arducom, uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo);
+
+	bool repliesInRuns(void);
+
+protected:
+	// file position of the next frame
+	uint32_t position;
+	// number of frames that follow the current one
+	uint8_t remaining;
+
+	/** Reads the next section of the file into the frame. */
+	int8_t readBlock(uint8_t* destBuffer, int8_t* dataSize, const uint8_t maxBufferSize, uint8_t* errorInfo);
+};
+
+/** This class implements a command to calculate the CRC32 (as used by zlib) of a section of the currently open file.
+* It expects the start position, the number of bytes and the CRC of the preceding data or 0 (4 bytes each, LSB first).
+* The reply contains the CRC and the number of bytes processed (4 bytes each, LSB first). This number is less than
+* requested at the end of the file or if the section exceeds ARDUCOM_FTP_CRC_LIMIT; the master passes the CRC
+* with the next request to continue.
+*/
+class ArducomFTPCRC: public ArducomCommand {
+public:
+	ArducomFTPCRC(uint8_t commandCode);
+	
+	int8_t handle(Arducom* arducom, uint8_t* dataBuffer, int8_t* dataSize, uint8_t* destBuffer, const uint8_t maxBufferSize, uint8_t* errorInfo);
+};
+
 /** This class implements a command to close the currently open file.
 */
 class ArducomFTPCloseFile: public ArducomCommand {
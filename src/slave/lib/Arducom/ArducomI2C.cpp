@@ -32,6 +32,9 @@ static ArducomHardwareI2C* hardwareI2C;
 
 ArducomHardwareI2C::ArducomHardwareI2C(uint8_t slaveAddress): ArducomTransport() {
 	hardwareI2C = this;
+	this->txSize = 0;
+	this->receiveTime = 0;
+	this->lastProcessingMs = 0;
 	// join i2c bus
 	Wire.begin(slaveAddress);
 	// register events
@@ -44,15 +47,22 @@ int8_t ArducomHardwareI2C::doWork(Arducom* arducom) {
 }
 
 int8_t ArducomHardwareI2C::send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
-	this->status = READY_TO_SEND;
+	// remember the processing time for estimates in premature requests
+	// (further frames of a reply run are not replies to a received command)
+	if (this->status == HAS_DATA) {
+		uint32_t processingMs = millis() - this->receiveTime;
+		this->lastProcessingMs = (processingMs > 0xFFFF ? 0xFFFF : processingMs);
+	}
 	if (count > ARDUCOM_BUFFERSIZE) {
-		this->data[0] = ARDUCOM_ERROR_CODE;
-		this->data[1] = ARDUCOM_TOO_MUCH_DATA;
-		this->data[2] = count;
-		this->size = 3;
+		this->txData[0] = ARDUCOM_ERROR_CODE;
+		this->txData[1] = ARDUCOM_TOO_MUCH_DATA;
+		this->txData[2] = count;
+		this->txSize = 3;
+		this->size = 0;
+		this->status = READY_TO_SEND;
 		return ARDUCOM_OVERFLOW;
 	} else {
-		#ifdef ARDUCOM_DEBUG_SUPPORT
+		#if ARDUCOM_DEBUG_SUPPORT == 1
 		if (arducom->debug) {
 			arducom->debug->print(F("Send: "));
 			for (uint8_t i = 0; i < count; i++) {
@@ -62,15 +72,32 @@ int8_t ArducomHardwareI2C::send(Arducom* arducom, uint8_t* buffer, uint8_t count
 			arducom->debug->println();
 		}
 		#endif
-		// copy buffer data
-		for (uint8_t i = 0; i < count; i++)
-			this->data[i] = buffer[i];
-		this->size = count;
+		// copy buffer data unless the reply has been composed in place
+		if (buffer != this->txData)
+			for (uint8_t i = 0; i < count; i++)
+				this->txData[i] = buffer[i];
+		this->txSize = count;
+		this->size = 0;
+		// set the status last; the request interrupt may occur at any time
+		this->status = READY_TO_SEND;
 	}
 	return ARDUCOM_OK;
 }
 
+bool ArducomHardwareI2C::isCommandComplete(void) {
+	if ((this->status != HAS_DATA) || (this->size < 2))
+		return false;
+	return this->size >= ARDUCOM_HEADER_SIZE(this->data[1]) + (this->data[1] & ARDUCOM_LENGTH_MASK);
+}
+
 void ArducomHardwareI2C::receiveEvent(int count) {
+	// Is a complete command being processed? Its data must not be overwritten.
+	// The master will send the command again after a timeout.
+	if (hardwareI2C->isCommandComplete()) {
+		while (Wire.available())
+			Wire.read();
+		return;
+	}
 	hardwareI2C->size = 0;
 	while (Wire.available()) {
 		// read byte
@@ -82,17 +109,33 @@ void ArducomHardwareI2C::receiveEvent(int count) {
 			return;
 		}
 	}
+	hardwareI2C->receiveTime = millis();
 	hardwareI2C->status = HAS_DATA;
 }
 
 void ArducomHardwareI2C::requestEvent(void) {
 	if (hardwareI2C->status == READY_TO_SEND) {
-		Wire.write((const uint8_t *)hardwareI2C->data, hardwareI2C->size);
+		Wire.write((const uint8_t *)hardwareI2C->txData, hardwareI2C->txSize);
 	
 		hardwareI2C->status = SENT;
-		hardwareI2C->size = 0;
+		hardwareI2C->txSize = 0;
+	} else
+	if (hardwareI2C->isCommandComplete()) {
+		// the command is being processed (premature request)
+		// estimate the remaining time from the previous command (in units of 10 ms, at least 1)
+		uint32_t elapsed = millis() - hardwareI2C->receiveTime;
+		uint32_t remaining = (hardwareI2C->lastProcessingMs > elapsed ? hardwareI2C->lastProcessingMs - elapsed : 0);
+		uint8_t hint = (remaining >= 2550 ? 255 : remaining / 10 + 1);
+		uint8_t code = hardwareI2C->data[1];
+		uint8_t notReadyResponse[] = { ARDUCOM_ERROR_CODE, ARDUCOM_NOT_READY, hint, 0 };
+		// error replies to tagged commands contain the tag
+		if ((code & ARDUCOM_TAG_FLAG) == ARDUCOM_TAG_FLAG) {
+			notReadyResponse[3] = hardwareI2C->data[ARDUCOM_HEADER_SIZE(code) - 1];
+			Wire.write(notReadyResponse, 4);
+		} else
+			Wire.write(notReadyResponse, 3);
 	} else {
-		// there is nothing to send (premature request)
+		// there is nothing to send
 		const uint8_t noDataResponse[] = { ARDUCOM_ERROR_CODE, ARDUCOM_NO_DATA, 0 };
 		Wire.write(noDataResponse, 3);
 	}
@@ -120,14 +163,23 @@ void ArducomSoftwareI2C::I2CReceive(uint8_t length) {
 	softwareI2C->status = HAS_DATA;
 }
 
-ArducomSoftwareI2C::ArducomSoftwareI2C(I2CSlaveInit i2cInit, I2CSlaveSend i2cSend, uint8_t *i2cBuffer): ArducomTransport() {
+ArducomSoftwareI2C::ArducomSoftwareI2C(I2CSlaveInit i2cInit, I2CSlaveSend i2cSend, uint8_t *i2cBuffer, I2CSlaveCheckTimeout i2cCheckTimeout,
+	I2CSlaveTxPending i2cTxPending): ArducomTransport() {
 	softwareI2C = this;
 	this->i2c_send = i2cSend;
 	this->i2c_buffer = i2cBuffer;
+	this->i2c_check_timeout = i2cCheckTimeout;
+	this->i2c_tx_pending = i2cTxPending;
 	i2cInit(&ArducomSoftwareI2C::I2CReceive);		
 }
 	
 int8_t ArducomSoftwareI2C::doWork(Arducom* arducom) {
+	// release the clock line if the master has been kept waiting too long
+	if (this->i2c_check_timeout)
+		this->i2c_check_timeout();
+	// the master has read the reply?
+	if ((this->status == READY_TO_SEND) && this->i2c_tx_pending && !this->i2c_tx_pending())
+		this->status = SENT;
 	return ARDUCOM_OK;
 }
 	
@@ -141,7 +193,7 @@ int8_t ArducomSoftwareI2C::send(Arducom* arducom, uint8_t* buffer, uint8_t count
 		this->i2c_send(this->data, (uint8_t)this->size);
 		return ARDUCOM_OVERFLOW;
 	} else {
-		#ifdef ARDUCOM_DEBUG_SUPPORT
+		#if ARDUCOM_DEBUG_SUPPORT == 1
 		if (arducom->debug) {
 			arducom->debug->print(F("Send: "));
 			for (uint8_t i = 0; i < count; i++) {
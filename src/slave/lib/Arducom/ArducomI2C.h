@@ -27,6 +27,11 @@
 
 /** This class defines the transport mechanism for Arducom commands over I2C.
 *   This implementation uses hardware I2C via the WSWire library.
+*   Replies are composed in a separate transmit buffer, so a new command does not
+*   overwrite a reply that has not been requested yet. While a command is being
+*   processed, new commands are ignored. If the master requests the reply before
+*   it is available it receives ARDUCOM_NOT_READY with an estimate of the remaining
+*   time, based on the processing time of the previous command.
 */
 class ArducomHardwareI2C: public ArducomTransport {
 
@@ -37,7 +42,22 @@ public:
 
 	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count);
 
+	virtual uint8_t* getSendBuffer(void) {
+		return this->txData;
+	};
+
 protected:
+	// the reply that is sent on the next request
+	uint8_t txData[ARDUCOM_BUFFERSIZE];
+	volatile uint8_t txSize;
+	// time at which the current command has been received
+	volatile uint32_t receiveTime;
+	// processing time of the previous command
+	uint16_t lastProcessingMs;
+
+	/** Returns true if a complete command has been received that has not been answered yet. */
+	bool isCommandComplete(void);
+
 	static void requestEvent(void);
 	static void receiveEvent(int count);
 };
@@ -52,11 +72,16 @@ protected:
 typedef void (*I2CSlaveOnReceive)(uint8_t length);
 typedef void (*I2CSlaveInit)(I2CSlaveOnReceive);
 typedef void (*I2CSlaveSend)(uint8_t* buffer, uint8_t length);
+typedef void (*I2CSlaveCheckTimeout)(void);
+typedef bool (*I2CSlaveTxPending)(void);
 
 class ArducomSoftwareI2C: public ArducomTransport {
 
 public:
-	ArducomSoftwareI2C(I2CSlaveInit i2cInit, I2CSlaveSend i2cSend, uint8_t *i2cBuffer);
+	/** i2cCheckTimeout is optional; pass i2c_slave_check_timeout if clock stretching is enabled.
+	* i2cTxPending is optional; pass i2c_slave_tx_pending to support commands that reply with a run of frames. */
+	ArducomSoftwareI2C(I2CSlaveInit i2cInit, I2CSlaveSend i2cSend, uint8_t *i2cBuffer, I2CSlaveCheckTimeout i2cCheckTimeout = NULL,
+		I2CSlaveTxPending i2cTxPending = NULL);
 
 	virtual int8_t doWork(Arducom* arducom);
 
@@ -67,6 +92,8 @@ public:
 protected:
 	I2CSlaveSend i2c_send;
 	uint8_t* i2c_buffer;	
+	I2CSlaveCheckTimeout i2c_check_timeout;
+	I2CSlaveTxPending i2c_tx_pending;
 };
 
 #endif
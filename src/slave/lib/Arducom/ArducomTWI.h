@@ -0,0 +1,323 @@
+// Arducom direct TWI (hardware I2C) transport
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+
+// *** License ***
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// *** Documentation ***
+//
+// ArducomHardwareI2C uses the Wire library. Wire receives into its own buffer
+// and calls the transport from within its interrupt routine, which copies the
+// data into the transport buffer; replies are copied into Wire's transmit buffer
+// again. Wire's buffers also limit frames to 32 bytes.
+// This transport drives the AVR TWI module directly. The interrupt routine
+// receives straight into the transport buffer, and replies are transmitted
+// straight from it (replies are composed in place). This saves the RAM for
+// Wire's buffers and shortens the time spent in the interrupt routine. Frames
+// are limited by ARDUCOM_BUFFERSIZE only (at most 64 bytes; the default is 32).
+//
+// While a received command is being processed, further writes from the master
+// are not acknowledged. If the master requests the reply before it is available,
+// the transport either answers with ARDUCOM_NOT_READY (as ArducomHardwareI2C does)
+// or, if ARDUCOM_TWI_CLOCK_STRETCHING is 1, holds the clock line low until the
+// reply is ready. Stretching ends after ARDUCOM_TWI_STRETCH_TIMEOUT_MS with an
+// ARDUCOM_NOT_READY reply. Clock stretching requires a master that supports it
+// (the I2C controller of the Raspberry Pi does not handle it reliably).
+//
+// Restrictions:
+// - AVR only.
+// - The transport takes over the TWI module including its interrupt, so the
+//   Wire library must not be used anywhere in the sketch (e. g. for an RTC);
+//   otherwise the linker reports a duplicate interrupt vector.
+// - The internal pullup resistors are not enabled.
+// - Interrupts must be enabled; while clock stretching, the TWI interrupt is
+//   disabled until the reply is ready or the timeout has elapsed, which requires
+//   Arducom::doWork() to be called regularly.
+//
+// How to use:
+// This code is provided as a header file rather than a separate library because
+// it defines an interrupt service routine which must only be linked if required.
+// Include it in exactly one source file of your sketch. Before including, you
+// may define the following configuration settings:
+
+// Set to 1 to hold the clock line low on premature requests until the reply is ready
+#ifndef ARDUCOM_TWI_CLOCK_STRETCHING
+#define ARDUCOM_TWI_CLOCK_STRETCHING	0
+#endif
+
+// Maximum time to stretch the clock (SMBus masters time out after 25 ms)
+#ifndef ARDUCOM_TWI_STRETCH_TIMEOUT_MS
+#define ARDUCOM_TWI_STRETCH_TIMEOUT_MS	25
+#endif
+
+// Example:
+//
+// #include <Arducom.h>
+// #include <ArducomTWI.h>
+//
+// ArducomTransportTWI arducomTransport(5);
+// Arducom arducom(&arducomTransport);
+
+#ifndef __ARDUCOMTWI_H
+#define __ARDUCOMTWI_H
+
+#include <Arducom.h>
+
+#if defined(__AVR__)
+
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+// TWI control register values: acknowledge the next byte or not
+#define ARDUCOM_TWI_ACK					(_BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA))
+#define ARDUCOM_TWI_NACK				(_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+/** This class defines the transport mechanism for Arducom commands over I2C
+*   using the AVR TWI module directly.
+*/
+class ArducomTransportTWI: public ArducomTransport {
+
+public:
+	/** Sets up the TWI module as a slave with the given address (1 - 127). */
+	ArducomTransportTWI(uint8_t slaveAddress): ArducomTransport() {
+		this->txBuffer = this->data;
+		this->txSize = 0;
+		this->txPos = 0;
+		this->rxOverflow = false;
+		this->stretching = false;
+		this->stretchStart = 0;
+		this->receiveTime = 0;
+		this->lastProcessingMs = 0;
+		ArducomTransportTWI::instance = this;
+		TWAR = slaveAddress << 1;
+		TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+	}
+
+	virtual int8_t doWork(Arducom* arducom) {
+		#if ARDUCOM_TWI_CLOCK_STRETCHING == 1
+		// the reply takes too long; release the clock line
+		if (this->stretching && (millis() - this->stretchStart > ARDUCOM_TWI_STRETCH_TIMEOUT_MS)) {
+			uint8_t oldSREG = SREG;
+			cli();
+			if (this->stretching) {
+				this->prepareNotReady();
+				this->release();
+			}
+			SREG = oldSREG;
+		}
+		#endif
+		return ARDUCOM_OK;
+	}
+
+	/** Prepares the reply for the next request from the master. */
+	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
+		// remember the processing time for estimates in premature requests
+		uint32_t processingMs = millis() - this->receiveTime;
+		this->lastProcessingMs = (processingMs > 0xFFFF ? 0xFFFF : processingMs);
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug) {
+			arducom->debug->print(F("Send: "));
+			for (uint8_t i = 0; i < count; i++) {
+				arducom->debug->print(buffer[i], HEX);
+				arducom->debug->print(F(" "));
+			}
+			arducom->debug->println();
+		}
+		#endif
+		// copy buffer data unless the reply has been composed in place
+		if (buffer != this->data)
+			for (uint8_t i = 0; i < count; i++)
+				this->data[i] = buffer[i];
+		uint8_t oldSREG = SREG;
+		cli();
+		this->txBuffer = this->data;
+		this->txSize = count;
+		this->txPos = 0;
+		this->size = 0;
+		this->status = READY_TO_SEND;
+		#if ARDUCOM_TWI_CLOCK_STRETCHING == 1
+		// the master is waiting for the reply
+		if (this->stretching)
+			this->release();
+		#endif
+		SREG = oldSREG;
+		return ARDUCOM_OK;
+	}
+
+	/** Handles the TWI interrupt; called by the interrupt routine only. */
+	inline void handleInterrupt(void) {
+		switch (TW_STATUS) {
+		// slave receiver
+		case TW_SR_SLA_ACK:
+		case TW_SR_ARB_LOST_SLA_ACK:
+			// a complete command is being processed; do not accept new data
+			if (this->isCommandComplete()) {
+				TWCR = ARDUCOM_TWI_NACK;
+				return;
+			}
+			// a new command discards an unrequested reply
+			this->status = NO_DATA;
+			this->size = 0;
+			this->rxOverflow = false;
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		case TW_SR_DATA_ACK:
+			if (this->status != NO_DATA) {
+				TWCR = ARDUCOM_TWI_NACK;
+				return;
+			}
+			this->data[this->size++] = TWDR;
+			// acknowledge only if there is room for another byte
+			TWCR = (this->size < ARDUCOM_BUFFERSIZE ? ARDUCOM_TWI_ACK : ARDUCOM_TWI_NACK);
+			return;
+		case TW_SR_DATA_NACK:
+			// the byte did not fit into the buffer
+			this->rxOverflow = true;
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		case TW_SR_STOP:
+			// stop or repeated start: the command is complete
+			if ((this->status == NO_DATA) && (this->size > 0)) {
+				this->receiveTime = millis();
+				if (this->rxOverflow) {
+					this->status = TOO_MUCH_DATA;
+					this->size = 0;
+				} else
+					this->status = HAS_DATA;
+			}
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		// slave transmitter
+		case TW_ST_SLA_ACK:
+		case TW_ST_ARB_LOST_SLA_ACK:
+			if (this->status == READY_TO_SEND) {
+				this->txPos = 0;
+			} else
+			if (this->isCommandComplete()) {
+				// premature request
+				#if ARDUCOM_TWI_CLOCK_STRETCHING == 1
+				// keep the clock line low (TWINT remains set) and disable the interrupt
+				// until send() or doWork() provides a reply
+				this->stretching = true;
+				this->stretchStart = millis();
+				TWCR = _BV(TWEN);
+				return;
+				#else
+				this->prepareNotReady();
+				#endif
+			} else {
+				// there is nothing to send
+				this->notReadyReply[0] = ARDUCOM_ERROR_CODE;
+				this->notReadyReply[1] = ARDUCOM_NO_DATA;
+				this->notReadyReply[2] = 0;
+				this->txBuffer = this->notReadyReply;
+				this->txSize = 3;
+				this->txPos = 0;
+			}
+			TWDR = this->txBuffer[this->txPos++];
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		case TW_ST_DATA_ACK:
+			// the master reads on; pad with 0xFF after the end of the reply
+			TWDR = (this->txPos < this->txSize ? this->txBuffer[this->txPos++] : 0xFF);
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		case TW_ST_DATA_NACK:
+		case TW_ST_LAST_DATA:
+			// the master has finished reading
+			if ((this->status == READY_TO_SEND) && (this->txBuffer == this->data) && (this->txPos > 0)) {
+				this->status = SENT;
+				this->txSize = 0;
+			}
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		case TW_BUS_ERROR:
+			// release the bus
+			TWCR = ARDUCOM_TWI_ACK | _BV(TWSTO);
+			return;
+		default:
+			TWCR = ARDUCOM_TWI_ACK;
+			return;
+		}
+	}
+
+	static ArducomTransportTWI* instance;
+
+protected:
+	// the reply that is being transmitted (the transport buffer or the not ready reply)
+	uint8_t* volatile txBuffer;
+	volatile uint8_t txSize;
+	volatile uint8_t txPos;
+	uint8_t notReadyReply[4];
+	volatile bool rxOverflow;
+	volatile bool stretching;
+	uint32_t stretchStart;
+	// time at which the current command has been received
+	volatile uint32_t receiveTime;
+	// processing time of the previous command
+	uint16_t lastProcessingMs;
+
+	/** Returns true if a complete command has been received that has not been answered yet. */
+	inline bool isCommandComplete(void) {
+		if ((this->status != HAS_DATA) || (this->size < 2))
+			return false;
+		return this->size >= ARDUCOM_HEADER_SIZE(this->data[1]) + (this->data[1] & ARDUCOM_LENGTH_MASK);
+	}
+
+	/** Prepares an ARDUCOM_NOT_READY reply to a premature request. The info byte estimates
+	*   the remaining time (in units of 10 ms, at least 1) from the previous command. */
+	void prepareNotReady(void) {
+		uint32_t elapsed = millis() - this->receiveTime;
+		uint32_t remaining = (this->lastProcessingMs > elapsed ? this->lastProcessingMs - elapsed : 0);
+		uint8_t code = this->data[1];
+		this->notReadyReply[0] = ARDUCOM_ERROR_CODE;
+		this->notReadyReply[1] = ARDUCOM_NOT_READY;
+		this->notReadyReply[2] = (remaining >= 2550 ? 255 : remaining / 10 + 1);
+		this->txSize = 3;
+		// error replies to tagged commands contain the tag
+		if ((code & ARDUCOM_TAG_FLAG) == ARDUCOM_TAG_FLAG) {
+			this->notReadyReply[3] = this->data[ARDUCOM_HEADER_SIZE(code) - 1];
+			this->txSize = 4;
+		}
+		this->txBuffer = this->notReadyReply;
+		this->txPos = 0;
+	}
+
+	#if ARDUCOM_TWI_CLOCK_STRETCHING == 1
+	/** Ends clock stretching by transmitting the first byte of the prepared reply.
+	*   Must be called with interrupts disabled. */
+	void release(void) {
+		this->stretching = false;
+		TWDR = this->txBuffer[this->txPos++];
+		TWCR = ARDUCOM_TWI_ACK;
+	}
+	#endif
+};
+
+ArducomTransportTWI* ArducomTransportTWI::instance = NULL;
+
+// TWI interrupt routine
+ISR(TWI_vect) {
+	ArducomTransportTWI::instance->handleInterrupt();
+}
+
+#endif	// __AVR__
+
+#endif
@@ -0,0 +1,212 @@
+// Arducom interrupt driven UART transport
+// Copyright (c) 2016 Leo Meyer, leo@leomeyer.de
+
+// *** License ***
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// *** Documentation ***
+//
+// ArducomTransportStream reads from its Stream only when the main loop calls
+// Arducom::doWork(). With HardwareSerial the receive buffer is 64 bytes, so
+// if the main loop is busy for a while (writing to an SD card, reading slow
+// sensors) at high baud rates incoming bytes are lost and the command
+// eventually fails with a receive timeout.
+// This transport drives an AVR USART directly. The receive interrupt places
+// incoming bytes into a ring buffer of configurable size, and doWork() moves
+// them into the transport buffer frame by frame: it stops at the end of a
+// complete command so that bytes of a following command remain in the ring
+// buffer until the current command has been answered.
+//
+// Restrictions:
+// - AVR only.
+// - The transport takes over the USART including its receive interrupt.
+//   The HardwareSerial object for the same port (e. g. Serial for USART 0)
+//   must not be used anywhere in the sketch; otherwise the linker reports
+//   a duplicate interrupt vector.
+// - Replies are transmitted from the transport buffer by polling the data
+//   register in doWork() whenever it is empty, so the main loop is never
+//   blocked by sending.
+//
+// How to use:
+// This code is provided as a header file rather than a separate library because
+// it defines an interrupt service routine which must only be linked if required.
+// Include it in exactly one source file of your sketch. Before including, you
+// may define the following configuration settings:
+
+// The number of the USART to use (0 - 3, depending on the microcontroller)
+#ifndef ARDUCOM_UART_NUMBER
+#define ARDUCOM_UART_NUMBER			0
+#endif
+
+// The size of the receive ring buffer; must be a power of two, 256 at most
+#ifndef ARDUCOM_UART_RX_BUFSIZE
+#define ARDUCOM_UART_RX_BUFSIZE		128
+#endif
+
+// Example:
+//
+// #include <Arducom.h>
+// #include <ArducomUART.h>
+//
+// ArducomTransportUART arducomTransport;
+// Arducom arducom(&arducomTransport);
+//
+// void setup() {
+//   arducomTransport.begin(115200);
+//   ...
+// }
+
+#ifndef __ARDUCOMUART_H
+#define __ARDUCOMUART_H
+
+#include <Arducom.h>
+
+#if defined(__AVR__)
+
+#include <avr/interrupt.h>
+
+#if (ARDUCOM_UART_RX_BUFSIZE & (ARDUCOM_UART_RX_BUFSIZE - 1)) != 0 || ARDUCOM_UART_RX_BUFSIZE > 256
+#error ARDUCOM_UART_RX_BUFSIZE must be a power of two and not larger than 256
+#endif
+
+// register name helper macros
+#define ARDUCOM_UART_CAT2_(a, b)		a ## b
+#define ARDUCOM_UART_CAT2(a, b)			ARDUCOM_UART_CAT2_(a, b)
+#define ARDUCOM_UART_CAT3_(a, b, c)		a ## b ## c
+#define ARDUCOM_UART_CAT3(a, b, c)		ARDUCOM_UART_CAT3_(a, b, c)
+
+#define ARDUCOM_UART_UDR				ARDUCOM_UART_CAT2(UDR, ARDUCOM_UART_NUMBER)
+#define ARDUCOM_UART_UBRR				ARDUCOM_UART_CAT2(UBRR, ARDUCOM_UART_NUMBER)
+#define ARDUCOM_UART_UCSRA				ARDUCOM_UART_CAT3(UCSR, ARDUCOM_UART_NUMBER, A)
+#define ARDUCOM_UART_UCSRB				ARDUCOM_UART_CAT3(UCSR, ARDUCOM_UART_NUMBER, B)
+#define ARDUCOM_UART_UCSRC				ARDUCOM_UART_CAT3(UCSR, ARDUCOM_UART_NUMBER, C)
+
+// ATmega328P and similar name the vector of their only USART without a number
+#if (ARDUCOM_UART_NUMBER == 0) && defined(USART_RX_vect)
+#define ARDUCOM_UART_RX_VECTOR			USART_RX_vect
+#else
+#define ARDUCOM_UART_RX_VECTOR			ARDUCOM_UART_CAT3(USART, ARDUCOM_UART_NUMBER, _RX_vect)
+#endif
+
+#define ARDUCOM_UART_RX_MASK			(ARDUCOM_UART_RX_BUFSIZE - 1)
+
+static volatile uint8_t arducom_uart_rx_buffer[ARDUCOM_UART_RX_BUFSIZE];
+static volatile uint8_t arducom_uart_rx_head = 0;
+static volatile uint8_t arducom_uart_rx_tail = 0;
+static volatile bool arducom_uart_rx_overflow = false;
+
+// USART receive interrupt routine; stores the received byte in the ring buffer
+ISR(ARDUCOM_UART_RX_VECTOR) {
+	uint8_t c = ARDUCOM_UART_UDR;
+	uint8_t next = (arducom_uart_rx_head + 1) & ARDUCOM_UART_RX_MASK;
+	if (next == arducom_uart_rx_tail) {
+		// buffer full, the byte is lost
+		arducom_uart_rx_overflow = true;
+		return;
+	}
+	arducom_uart_rx_buffer[arducom_uart_rx_head] = c;
+	arducom_uart_rx_head = next;
+}
+
+/** This class defines the transport mechanism for Arducom commands over an AVR USART
+*   using an interrupt driven receive buffer.
+*/
+class ArducomTransportUART: public ArducomTransport {
+
+public:
+	ArducomTransportUART(): ArducomTransport() {}
+
+	/** Initializes the USART with the given baud rate (8N1) and enables the receive interrupt.
+	*   Must be called in setup() because the Arduino core resets the USART on startup. */
+	void begin(unsigned long baudrate) {
+		// use double speed mode (same calculation as HardwareSerial)
+		uint16_t ubrr = (F_CPU / 4 / baudrate - 1) / 2;
+		ARDUCOM_UART_UCSRA = _BV(U2X0);
+		ARDUCOM_UART_UBRR = ubrr;
+		// 8 data bits, no parity, one stop bit
+		ARDUCOM_UART_UCSRC = _BV(UCSZ01) | _BV(UCSZ00);
+		ARDUCOM_UART_UCSRB = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+	}
+
+	virtual int8_t doWork(Arducom* arducom) {
+		if (this->status == SENDING) {
+			// transmit while the data register is empty
+			while ((this->status == SENDING) && (ARDUCOM_UART_UCSRA & _BV(UDRE0))) {
+				ARDUCOM_UART_UDR = this->data[this->sendPos++];
+				if (this->sendPos >= this->size) {
+					this->status = SENT;
+					this->size = 0;
+				}
+			}
+			// do not accept new data before the reply has been sent
+			if (this->status == SENDING)
+				return ARDUCOM_OK;
+		}
+		if (arducom_uart_rx_overflow) {
+			// input has been lost; discard everything and start over
+			uint8_t oldSREG = SREG;
+			cli();
+			arducom_uart_rx_tail = arducom_uart_rx_head;
+			arducom_uart_rx_overflow = false;
+			SREG = oldSREG;
+			this->status = TOO_MUCH_DATA;
+			this->size = 0;
+			return ARDUCOM_OVERFLOW;
+		}
+		if (this->status != HAS_DATA)
+			this->size = 0;
+		// move received bytes into the transport buffer until the frame is complete
+		while (arducom_uart_rx_tail != arducom_uart_rx_head) {
+			// frame complete? (requires at least command and code byte)
+			if ((this->size > 1) && (this->size >= ARDUCOM_HEADER_SIZE(this->data[1]) + (this->data[1] & ARDUCOM_LENGTH_MASK)))
+				break;
+			this->data[this->size] = arducom_uart_rx_buffer[arducom_uart_rx_tail];
+			arducom_uart_rx_tail = (arducom_uart_rx_tail + 1) & ARDUCOM_UART_RX_MASK;
+			this->size++;
+			if (this->size >= ARDUCOM_BUFFERSIZE) {
+				this->status = TOO_MUCH_DATA;
+				this->size = 0;
+				return ARDUCOM_OVERFLOW;
+			}
+			this->status = HAS_DATA;
+		}
+		return ARDUCOM_OK;
+	}
+
+	/** Queues count bytes from the buffer for sending by doWork(). */
+	virtual int8_t send(Arducom* arducom, uint8_t* buffer, uint8_t count) {
+		#if ARDUCOM_DEBUG_SUPPORT == 1
+		if (arducom->debug) {
+			arducom->debug->print(F("Send: "));
+			for (uint8_t i = 0; i < count; i++) {
+				arducom->debug->print(buffer[i], HEX);
+				arducom->debug->print(F(" "));
+			}
+			arducom->debug->println();
+		}
+		#endif
+		this->queueSend(buffer, count);
+		return ARDUCOM_OK;
+	}
+};
+
+#endif	// __AVR__
+
+#endif
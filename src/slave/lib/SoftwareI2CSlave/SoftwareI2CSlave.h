@@ -41,28 +41,35 @@
 // two pins other than the standard I2C hardware pins.
 // 
 // The following restrictions apply:
-// - This implementation may have trouble with repeated start conditions. In
-//   most cases this won't be a problem because those conditions are mostly
-//   used in multi-master setups and this library is specifically for single
-//   master setups.
 // - The SDA and SCL pin must be on the same ATMEGA port.
 // - Internal pullup resistors are not supported.
 // - The usage of pin change interrupts may render this library incompatible
 //   with other libraries that also use those interrupts (e. g. SoftwareSerial).
-// - Bandwith limitation: 40 kHz seems to work quite reliably on a 16 MHz Uno.
-//   With 50 kHz you can expect a failure rate of about 5 percent.
-//   Additional interrupt service routines increase the likelihood of I2C errors.
-//   In any case you should design your communications to account for failures.
+// - Bandwidth limitation: The interrupt service routine is entered on a start
+//   condition and handles the whole transfer by polling the bus lines. The start
+//   condition depends on the interrupt latency, which must stay below the start
+//   hold time plus one clock period (about 10 microseconds at 100 kHz).
+//   The recommended bus speed is 40 kHz. It is not known whether 100 kHz works:
+//   this has not been tested on hardware, and the timing model in
+//   src/master/swi2c-timing.cpp is not calibrated (with its default settings the
+//   previous routine already fails at 40 kHz, which it did not on hardware).
+//   Long running interrupt service routines of other libraries may cause I2C errors;
+//   in any case you should design your communications to account for failures.
 //   Try to lower the bandwidth if you experience problems.
+// - The routine keeps other interrupts disabled while a byte is transferred, which
+//   is about 100 microseconds per byte at 100 kHz and 250 at 40 kHz. Before the
+//   acknowledge bit of each byte one pending interrupt is serviced. Without clock
+//   stretching its service routine must return within about one clock period of the
+//   bus; with I2C_SLAVE_CLOCK_STRETCHING the slave holds SCL low meanwhile.
+//   After a bus error interrupts stay disabled for up to I2C_SLAVE_MAX_WAIT polling
+//   iterations, which is up to about 750 microseconds (753 in the timing model).
+//   Timers and serial receivers that need service more often lose events then.
 // - Single I2C address supported only. However, multiple slave addresses could be
 //   implemented without too much trouble if required.
-// - Single buffer for sending and receiving data. Data that is to be sent may
-//   be overwritten if the master sends data instead of requesting data. Also,
-//   there is no way of knowing whether data has actually been sent.
+// - Received data is only valid until the master writes again. Copy it in the
+//   callback function or process it before the next write.
 // - Disabling interrupts using cli() or similar also disables the I2C slave. If
 //   the master sends data while interrupts are disabled errors may occur.
-// - Known bug: Writing data from a Raspberry Pi for the first time after startup
-//   fails due to unknown reasons. Subsequent writes work ok.
 //
 // The plus side:
 // - This implementation does not enable pullup resistors by default.
@@ -72,6 +79,7 @@
 // - Wait loops use a timeout counter. In theory, this should prevent the device
 //   to hang in I2C service code in case of bus problems (the Arduino hardware
 //   I2C library does not prevent this).
+// - Repeated start conditions (e. g. combined write/read transfers) are recognized.
 // - Relatively low flash and RAM footprint.
 
 // How to use:
@@ -96,8 +104,17 @@
 // sends new data too fast.
 // To send data back to the master, use the following function:
 // i2c_slave_send(uint8_t *data, uint8_t length)
-// This function copies the specified data to the i2c_slave_buffer array and uses it
-// as send buffer when the master requests data from the slave.
+// This function copies the specified data to the separate send buffer which is used
+// when the master requests data from the slave. The data remains available until the
+// master has read it (i2c_slave_tx_ready becomes false) or until it is replaced by
+// the next call of i2c_slave_send. As the receive buffer is separate, the master may
+// write the next command before reading the reply to the previous one.
+// i2c_slave_tx_pending() returns true as long as the master has not read the data.
+// If I2C_SLAVE_CLOCK_STRETCHING is 1 and the master requests data after a write
+// before i2c_slave_send has been called, the slave holds SCL low until the data
+// is available. The master then does not have to wait a fixed time between writing
+// and reading. Call i2c_slave_check_timeout() regularly in the main loop; it
+// releases SCL after I2C_SLAVE_STRETCH_TIMEOUT_MS if no data has been supplied.
 // For a complete example see the end of this file, or SoftwareI2CSlave.ino.
 
 /* Example configuration settings (copy these to your sketch and adjust them before
@@ -111,6 +128,10 @@
 // The buffer size in bytes for the send and receive buffer
 #define I2C_SLAVE_BUFSIZE		24
 
+// Optional: different sizes for the receive and send buffer (default: I2C_SLAVE_BUFSIZE)
+#define I2C_SLAVE_RX_BUFSIZE	24
+#define I2C_SLAVE_TX_BUFSIZE	24
+
 // The numbers of the Arduino pins to use (in this example, A0 and A1)
 // Pins 0 - 7 are on PIND
 // Pins 8 - 13 are on PINB
@@ -155,210 +176,339 @@
 // For PINC, use PCMSK1
 // For PIND, use PCMSK2
 #define I2C_SLAVE_PINMASKREG	PCMSK1
+
+// Set to 1 to hold SCL low if the master requests data before it has been supplied
+// using i2c_slave_send (clock stretching). The master must support clock stretching.
+#define I2C_SLAVE_CLOCK_STRETCHING	0
+
+// The maximum time in milliseconds to hold SCL low (default: 25)
+#define I2C_SLAVE_STRETCH_TIMEOUT_MS	25
    
 */
 
+#ifndef I2C_SLAVE_RX_BUFSIZE
+#define I2C_SLAVE_RX_BUFSIZE	I2C_SLAVE_BUFSIZE
+#endif
+
+#ifndef I2C_SLAVE_TX_BUFSIZE
+#define I2C_SLAVE_TX_BUFSIZE	I2C_SLAVE_BUFSIZE
+#endif
+
+#ifndef I2C_SLAVE_STRETCH_TIMEOUT_MS
+#define I2C_SLAVE_STRETCH_TIMEOUT_MS	25
+#endif
+
+#ifndef I2C_SLAVE_MAX_WAIT
+#define I2C_SLAVE_MAX_WAIT	2000
+#endif
+
 // callback function that is called when the slave has received I2C data
 // this routine must be short as it is run in an interrupt context
 typedef void (*I2CSlaveOnReceive)(uint8_t length);
 
 // I2C state flags
-#define I2CSTATE_INIT	0
-#define I2CSTATE_RECV	0x80
-#define I2CSTATE_SEND	0x40
-
-#define I2C_SLAVE_PIN_MASK	(bit(I2C_SLAVE_SCL_BIT) | bit (I2C_SLAVE_SDA_BIT))
+#define I2CSTATE_INIT		0
+#define I2CSTATE_RECV		0x80
+// data has been received but not yet answered
+#define I2CSTATE_WAIT		0x20
+// SCL is being held low until the reply is available
+#define I2CSTATE_STRETCH	0x10
+// the reply has been supplied during clock stretching
+#define I2CSTATE_RESUME		0x08
+
+#define I2C_SLAVE_SCL		bit(I2C_SLAVE_SCL_BIT)
+#define I2C_SLAVE_SDA		bit(I2C_SLAVE_SDA_BIT)
+#define I2C_SLAVE_PIN_MASK	(I2C_SLAVE_SCL | I2C_SLAVE_SDA)
 
 static volatile uint8_t i2c_slave_pins = 0;
+static volatile bool i2c_slave_bus_free = false;
 static volatile uint8_t i2c_slave_state = I2CSTATE_INIT;
-static volatile uint8_t i2c_slave_data = 0;
 static volatile uint8_t i2c_slave_index = 0;
-static volatile uint8_t i2c_slave_length = 0;
-static uint8_t i2c_slave_buffer[I2C_SLAVE_BUFSIZE];
+static uint8_t i2c_slave_buffer[I2C_SLAVE_RX_BUFSIZE];
+// set by i2c_slave_send when the send buffer is complete, reset when the master has read it
+static volatile bool i2c_slave_tx_ready = false;
+static volatile uint8_t i2c_slave_tx_length = 0;
+static uint8_t i2c_slave_tx_buffer[I2C_SLAVE_TX_BUFSIZE];
 static I2CSlaveOnReceive i2c_onReceive;
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+static uint32_t i2c_slave_stretch_start;
+#endif
 
 // setup the I2C slave with the specified callback function
 // the callback function must be short as it is run in an interrupt context
 void i2c_slave_init(I2CSlaveOnReceive onReceive) {
 	i2c_onReceive = onReceive;
+	// a start condition requires SDA to have been high before
+	i2c_slave_pins = I2C_SLAVE_READ_PINS;
+	i2c_slave_bus_free = (i2c_slave_pins & I2C_SLAVE_PIN_MASK) == I2C_SLAVE_PIN_MASK;
 	// enable the pin change interrupt
 	PCICR |= bit(I2C_SLAVE_INTFLAG);
 	I2C_SLAVE_PINMASKREG = I2C_SLAVE_PIN_MASK;
 }
 
-// store data to send in internal buffer
+// store data to send in the send buffer
 // data will be sent when a read is requested by the master
-// if the master writes instead, the data is lost
+// it remains available until the master has read it, even if the master writes in between
 void i2c_slave_send(uint8_t *data, uint8_t length) {
+	// the interrupt routine must not send a partially copied buffer
+	i2c_slave_tx_ready = false;
 	uint8_t i = 0;
-	while ((i < length) && (i < I2C_SLAVE_BUFSIZE)) {
-		i2c_slave_buffer[i] = data[i];
+	while ((i < length) && (i < I2C_SLAVE_TX_BUFSIZE)) {
+		i2c_slave_tx_buffer[i] = data[i];
 		i++;
 	}
-	i2c_slave_index = 0;
-	i2c_slave_length = i;
-	i2c_slave_state = length > 0 ? I2CSTATE_SEND : I2CSTATE_INIT;
+	i2c_slave_tx_length = i;
+	uint8_t oldSREG = SREG;
+	cli();
+	i2c_slave_tx_ready = (i > 0);
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+	// is the master waiting for the data?
+	if (i2c_slave_state == I2CSTATE_STRETCH) {
+		// acknowledge the read request and release SCL; the interrupt routine sends the data
+		i2c_slave_state = I2CSTATE_RESUME;
+		I2C_SLAVE_DDR_PINS |= I2C_SLAVE_SDA;
+		I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SCL;
+	} else
+#endif
+	// the received data has been answered
+	if (i2c_slave_state == I2CSTATE_WAIT)
+		i2c_slave_state = I2CSTATE_INIT;
+	SREG = oldSREG;
+}
+
+// returns true while the send buffer holds data that the master has not read yet
+bool i2c_slave_tx_pending(void) {
+	return i2c_slave_tx_ready;
+}
+
+// release SCL if clock stretching takes longer than I2C_SLAVE_STRETCH_TIMEOUT_MS
+// the master's read request is not acknowledged in this case
+// call this function regularly from the main loop
+void i2c_slave_check_timeout(void) {
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+	if ((i2c_slave_state == I2CSTATE_STRETCH) && (millis() - i2c_slave_stretch_start > I2C_SLAVE_STRETCH_TIMEOUT_MS)) {
+		uint8_t oldSREG = SREG;
+		cli();
+		if (i2c_slave_state == I2CSTATE_STRETCH) {
+			i2c_slave_state = I2CSTATE_INIT;
+			I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SCL;
+		}
+		SREG = oldSREG;
+	}
+#endif
 }
 
 // pin change interrupt routine for SCL and SDA
-SIGNAL(I2C_SLAVE_INTVECTOR) {
+// The routine is entered on a start condition and handles the complete transfer
+// by polling the pins. Interrupt latency is therefore only critical at the start
+// condition, and other interrupts cannot make the slave lose track of the bits.
+ISR(I2C_SLAVE_INTVECTOR) {
 
-#define START_COND	(bit(I2C_SLAVE_SCL_BIT))
-#define STOP_COND	(bit(I2C_SLAVE_SCL_BIT) | bit(I2C_SLAVE_SDA_BIT))
+#define STOP_COND	(I2C_SLAVE_SCL | I2C_SLAVE_SDA)
 
 // the waitcounter logic avoids the interrupt routine hanging in an infinite loop
-// the value of MAX_WAIT may have to be increased if the bus speed is very slow (maximum: 32767)
-#define MAX_WAIT	10000
-int16_t waitcounter;
-#define WAIT_SCL_LOW()  waitcounter = MAX_WAIT; while (I2C_SLAVE_READ_PINS & bit(I2C_SLAVE_SCL_BIT)) { waitcounter--; if (waitcounter <= 0) goto timeout; }
-#define WAIT_SCL_HIGH() waitcounter = MAX_WAIT; while (!(I2C_SLAVE_READ_PINS & bit(I2C_SLAVE_SCL_BIT))) { waitcounter--; if (waitcounter <= 0) goto timeout; }
-
-// send acknowledge by pulling SDA low for one clock cycle
-#define SEND_ACK()	I2C_SLAVE_DDR_PINS |= bit(I2C_SLAVE_SDA_BIT); WAIT_SCL_HIGH(); WAIT_SCL_LOW(); I2C_SLAVE_DDR_PINS &= ~bit(I2C_SLAVE_SDA_BIT)
+// with interrupts disabled; one iteration takes about 0.4 microseconds at 16 MHz
+// the value of I2C_SLAVE_MAX_WAIT must be increased if the bus speed is below 1 kHz (maximum: 65535)
+#define MAX_WAIT	I2C_SLAVE_MAX_WAIT
+uint16_t waitcounter;
+#define WAIT_SCL_LOW()  waitcounter = MAX_WAIT; while (I2C_SLAVE_READ_PINS & I2C_SLAVE_SCL) { if (--waitcounter == 0) goto timeout; }
+#define WAIT_SCL_HIGH() waitcounter = MAX_WAIT; while (!(I2C_SLAVE_READ_PINS & I2C_SLAVE_SCL)) { if (--waitcounter == 0) goto timeout; }
+
+// pull SDA low for a zero bit, release it for a one bit (MSB of the data byte)
+#define PUT_BIT(d)	if ((d) & 0x80) I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SDA; else I2C_SLAVE_DDR_PINS |= I2C_SLAVE_SDA
+
+// let one pending interrupt of another source run between two bytes
+// (the instruction after sei() is always executed before an interrupt is serviced)
+#define ALLOW_INTERRUPTS()	sei(); __asm__ __volatile__ ("nop"); cli()
+
+// with clock stretching SCL is held low meanwhile, otherwise the other interrupt
+// service routine must return within one clock period
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+#define HOLD_SCL()		I2C_SLAVE_DDR_PINS |= I2C_SLAVE_SCL
+#define RELEASE_SCL()	I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SCL
+#else
+#define HOLD_SCL()
+#define RELEASE_SCL()
+#endif
+
+// send acknowledge by pulling SDA low for one clock cycle; other interrupts are served
+// before the acknowledge clock because the master does not change SDA until its end
+#define SEND_ACK()	I2C_SLAVE_DDR_PINS |= I2C_SLAVE_SDA; HOLD_SCL(); ALLOW_INTERRUPTS(); RELEASE_SCL(); WAIT_SCL_HIGH(); WAIT_SCL_LOW(); I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SDA
+
+	uint8_t pins;
+	uint8_t current;
+	uint8_t data;
+	uint8_t index;
+	uint8_t i;
+
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+	// data supplied after clock stretching?
+	if (i2c_slave_state == I2CSTATE_RESUME)
+		goto transmit;
+#endif
 
 	// get current state of I2C pins
-	uint8_t pins = I2C_SLAVE_READ_PINS;
-	
+	pins = I2C_SLAVE_READ_PINS;
+
+	// start condition (falling SDA, SCL high)?
+	// If the interrupt has been delayed SCL may already be low; after a stop condition
+	// (bus free) any falling SDA is a start condition
+	if (!(pins & I2C_SLAVE_SDA) && (i2c_slave_pins & I2C_SLAVE_SDA)
+		&& ((pins & I2C_SLAVE_SCL) || i2c_slave_bus_free)) {
+		i2c_slave_bus_free = false;
+		goto start;
+	}
 	// stop condition (rising SDA, SCL high)?
 	if (((pins & I2C_SLAVE_PIN_MASK) == STOP_COND)
 		// SDA must have been previously low
-		&& !(i2c_slave_pins & bit(I2C_SLAVE_SDA_BIT))) {
-		// stop condition after receive?
-		if (i2c_slave_state & I2CSTATE_RECV) {
-			// trigger callback
-			i2c_onReceive(i2c_slave_index);
-		}
-		// reset I2C state
-		i2c_slave_state = I2CSTATE_INIT;
-	} else
-	// start condition (falling SDA, SCL high)?
-	if (((pins & I2C_SLAVE_PIN_MASK) == START_COND)
-		// SDA must have been previously high (bit changed)
-		&& ((pins ^ i2c_slave_pins) & bit(I2C_SLAVE_SDA_BIT))) {
-		// read address
-		uint8_t adr = 0;
-		for (uint8_t i = 0; i < 7; i++) {
-			WAIT_SCL_LOW();
-			WAIT_SCL_HIGH();
-			adr <<= 1;
-			// read address bit
-			adr |= (I2C_SLAVE_READ_PINS >> I2C_SLAVE_SDA_BIT) & 1;
-		}
+		&& !(i2c_slave_pins & I2C_SLAVE_SDA))
+		i2c_slave_bus_free = true;
+	goto done;
+
+start:
+	// edges during the transfer must not re-enter this routine between two bytes
+	PCICR &= ~bit(I2C_SLAVE_INTFLAG);
+	// read address and r/w bit
+	data = 0;
+	for (i = 0; i < 8; i++) {
 		WAIT_SCL_LOW();
 		WAIT_SCL_HIGH();
-		// read r/w bit
-		uint8_t r_w = (I2C_SLAVE_READ_PINS >> I2C_SLAVE_SDA_BIT) & 1;
-		WAIT_SCL_LOW();
-		// has this slave been addressed?
-		if (adr == I2C_SLAVE_ADDRESS) {
-			// master read?
-			if (r_w) {
-				if (i2c_slave_state == I2CSTATE_SEND) {
-					SEND_ACK();
-					i2c_slave_index = 0;
-					i2c_slave_data = i2c_slave_buffer[i2c_slave_index];
-					// send data (MSB first), byte per byte (to not block in the ISR too long)
-					for (int i = 0; i < 8; i++) {
-						if (!(i2c_slave_data & 0x80))
-							// pull SDA low
-							I2C_SLAVE_DDR_PINS |= bit(I2C_SLAVE_SDA_BIT);
-						WAIT_SCL_HIGH();
-						WAIT_SCL_LOW();
-						if (!(i2c_slave_data & 0x80))
-							// reset SDA to input
-							I2C_SLAVE_DDR_PINS &= ~bit(I2C_SLAVE_SDA_BIT);
-						i2c_slave_data <<= 1;
-					}
-					// expect ACK or NACK
-					WAIT_SCL_HIGH();
-					// NACK?
-					if ((I2C_SLAVE_READ_PINS >> I2C_SLAVE_SDA_BIT) & 1) {
-						// master does not request any more data
-						i2c_slave_state = I2CSTATE_INIT;
-					} else {
-						i2c_slave_index++;
-					}
-				} else {
-					// read requested but not ready to send - NACK
-					WAIT_SCL_HIGH();
-					WAIT_SCL_LOW();					
-				}
-			} else {
-				// master writes
-				SEND_ACK();
-				// receive data
-				i2c_slave_state = I2CSTATE_RECV;
-				i2c_slave_data = 0;
-				i2c_slave_index = 0;
+		data = (data << 1) | ((I2C_SLAVE_READ_PINS >> I2C_SLAVE_SDA_BIT) & 1);
+	}
+	WAIT_SCL_LOW();
+	// has this slave been addressed?
+	if ((data >> 1) != I2C_SLAVE_ADDRESS)
+		goto done;
+
+	// master read?
+	if (data & 1) {
+		if (!i2c_slave_tx_ready) {
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+			// received data not answered yet?
+			if (i2c_slave_state == I2CSTATE_WAIT) {
+				// hold SCL low until i2c_slave_send supplies the data
+				I2C_SLAVE_DDR_PINS |= I2C_SLAVE_SCL;
+				i2c_slave_stretch_start = millis();
+				i2c_slave_state = I2CSTATE_STRETCH;
+				goto done;
 			}
+#endif
+			// read requested but not ready to send - NACK
+			WAIT_SCL_HIGH();
+			WAIT_SCL_LOW();
+			goto end;
 		}
-	} else
-	// falling edge of clock?
-	if (!(pins & bit(I2C_SLAVE_SCL_BIT)) && (i2c_slave_pins & bit(I2C_SLAVE_SCL_BIT))) {
-		// sending data?
-		if (i2c_slave_state & I2CSTATE_SEND) {
-			i2c_slave_data = i2c_slave_index >= i2c_slave_length ? 0xff : i2c_slave_buffer[i2c_slave_index];
-			// send data (MSB first), byte per byte (to not block in the ISR too long)
-			for (int i = 0; i < 8; i++) {
-				if (!(i2c_slave_data & 0x80))
-					// pull SDA low
-					I2C_SLAVE_DDR_PINS |= bit(I2C_SLAVE_SDA_BIT);
+		// acknowledge
+		I2C_SLAVE_DDR_PINS |= I2C_SLAVE_SDA;
+#if I2C_SLAVE_CLOCK_STRETCHING == 1
+transmit:
+#endif
+		WAIT_SCL_HIGH();
+		index = 0;
+		data = i2c_slave_tx_length > 0 ? i2c_slave_tx_buffer[0] : 0xff;
+		while (true) {
+			// send data (MSB first); each bit is put on the bus as soon as SCL is low
+			WAIT_SCL_LOW();
+			HOLD_SCL();
+			PUT_BIT(data);
+			// serve other interrupts once per byte
+			ALLOW_INTERRUPTS();
+			RELEASE_SCL();
+			for (i = 0; i < 7; i++) {
 				WAIT_SCL_HIGH();
 				WAIT_SCL_LOW();
-				if (!(i2c_slave_data & 0x80))
-					// reset SDA to input
-					I2C_SLAVE_DDR_PINS &= ~bit(I2C_SLAVE_SDA_BIT);
-				i2c_slave_data <<= 1;
+				data <<= 1;
+				PUT_BIT(data);
 			}
-			// expect ACK or NACK
+			WAIT_SCL_HIGH();
+			WAIT_SCL_LOW();
+			// release SDA for the acknowledge bit
+			I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SDA;
 			WAIT_SCL_HIGH();
 			// NACK?
-			if ((I2C_SLAVE_READ_PINS >> I2C_SLAVE_SDA_BIT) & 1) {
+			if (I2C_SLAVE_READ_PINS & I2C_SLAVE_SDA) {
 				// master does not request any more data
-				i2c_slave_state = I2CSTATE_INIT;
-			} else {
-				i2c_slave_index++;
+				i2c_slave_tx_ready = false;
+				if (i2c_slave_state == I2CSTATE_RESUME)
+					i2c_slave_state = I2CSTATE_INIT;
+				WAIT_SCL_LOW();
+				goto end;
 			}
+			index++;
+			data = index >= i2c_slave_tx_length ? 0xff : i2c_slave_tx_buffer[index];
 		}
-	} else
-	// rising edge of clock?
-	if ((pins & bit(I2C_SLAVE_SCL_BIT)) && !(i2c_slave_pins & bit(I2C_SLAVE_SCL_BIT))) {
-		// receiving data?
-		if (i2c_slave_state & I2CSTATE_RECV) {
-			// read next data bit
-			i2c_slave_data |= (pins >> I2C_SLAVE_SDA_BIT) & 1;
-			// increase counter
-			i2c_slave_state++;
-			// eight bits received?
-			if (i2c_slave_state & 0x08) {
-				if (i2c_slave_index < I2C_SLAVE_BUFSIZE) {
-					i2c_slave_buffer[i2c_slave_index] = i2c_slave_data;
-					i2c_slave_index++;
-					// reset counter
-					i2c_slave_state &= ~0x07;
-					WAIT_SCL_LOW();
-					SEND_ACK();
-					// stay in receive mode
-					i2c_slave_state = I2CSTATE_RECV;
-					i2c_slave_data = 0;
-				} else {
-					// receive buffer overflow, send NACK
-					WAIT_SCL_LOW();
-					WAIT_SCL_HIGH();
-					i2c_slave_state = I2CSTATE_INIT;
-				}
-			} else
-				i2c_slave_data <<= 1;		
+	}
+
+	// master writes
+	SEND_ACK();
+	// receive data
+	i2c_slave_state = I2CSTATE_RECV;
+	i2c_slave_index = 0;
+	while (true) {
+		data = 0;
+		for (i = 0; i < 8; i++) {
+			WAIT_SCL_HIGH();
+			// read data bit (MSB first)
+			pins = I2C_SLAVE_READ_PINS;
+			data = (data << 1) | ((pins >> I2C_SLAVE_SDA_BIT) & 1);
+			// an SDA change while SCL is high is a stop or a repeated start condition
+			waitcounter = MAX_WAIT;
+			while ((current = I2C_SLAVE_READ_PINS) & I2C_SLAVE_SCL) {
+				if ((current ^ pins) & I2C_SLAVE_SDA)
+					goto condition;
+				if (--waitcounter == 0)
+					goto timeout;
+			}
+		}
+		if (i2c_slave_index >= I2C_SLAVE_RX_BUFSIZE) {
+			// receive buffer overflow, send NACK
+			WAIT_SCL_HIGH();
+			WAIT_SCL_LOW();
+			i2c_slave_state = I2CSTATE_INIT;
+			goto end;
 		}
+		i2c_slave_buffer[i2c_slave_index] = data;
+		i2c_slave_index++;
+		SEND_ACK();
 	}
 
+end:
+	// after a NACK the master sends a stop or a repeated start condition
+	WAIT_SCL_HIGH();
+	pins = I2C_SLAVE_READ_PINS;
+	waitcounter = MAX_WAIT;
+	while ((current = I2C_SLAVE_READ_PINS) & I2C_SLAVE_SCL) {
+		if ((current ^ pins) & I2C_SLAVE_SDA)
+			goto condition;
+		if (--waitcounter == 0)
+			goto timeout;
+	}
+	goto done;
+
+condition:
+	// received data is complete?
+	if (i2c_slave_state == I2CSTATE_RECV) {
+		i2c_slave_state = I2CSTATE_WAIT;
+		i2c_onReceive(i2c_slave_index);
+	}
+	// repeated start condition (falling SDA)?
+	if (!(current & I2C_SLAVE_SDA))
+		goto start;
+	i2c_slave_bus_free = true;
+	goto done;
+
 timeout:
+	// switch SDA pin to input and abort the transfer (a pending reply is kept)
+	I2C_SLAVE_DDR_PINS &= ~I2C_SLAVE_SDA;
+	if ((i2c_slave_state == I2CSTATE_RECV) || (i2c_slave_state == I2CSTATE_RESUME))
+		i2c_slave_state = I2CSTATE_INIT;
+
+done:
 	// remember last pin state
 	i2c_slave_pins = I2C_SLAVE_READ_PINS;
-	// clear outstanding interrupts
-	PCIFR |= bit(I2C_SLAVE_CLEARFLAG);
-	// switch SDA pin to input (may be necessary after timeouts)
-	I2C_SLAVE_DDR_PINS &= ~bit(I2C_SLAVE_SDA_BIT);
+	// clear outstanding interrupts (writing the flag clears it)
+	PCIFR = bit(I2C_SLAVE_CLEARFLAG);
+	PCICR |= bit(I2C_SLAVE_INTFLAG);
 }
 
 /* 